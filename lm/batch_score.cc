@@ -0,0 +1,93 @@
+#include "batch_score.hh"
+
+#include "virtual_interface.hh"
+#include "../util/exception.hh"
+#include "../util/tokenize_piece.hh"
+
+#include <algorithm>
+#include <utility>
+
+namespace lm {
+namespace base {
+
+SentenceBatch::SentenceBatch()
+  : sentences(NULL), lengths(NULL), ids(NULL), offsets(NULL), count(0), begin_sentence(true), end_sentence(true), totals(NULL), words(NULL), block_words(NULL), tokens(NULL) {}
+
+void CheckBatchIds(const Model &model, const WordIndex *ids, const std::size_t *offsets, std::size_t count) {
+  WordIndex bound = model.BaseVocabulary().Bound();
+  for (std::size_t i = 0; i < count; ++i) {
+    UTIL_THROW_IF(offsets[i] > offsets[i + 1], util::Exception, "Offsets must not decrease but offset " << i << " is " << offsets[i] << " and the next is " << offsets[i + 1]);
+  }
+  if (!count) return;
+  for (const WordIndex *id = ids + offsets[0]; id != ids + offsets[count]; ++id) {
+    UTIL_THROW_IF(*id >= bound, util::Exception, "Word id " << *id << " at position " << (id - ids) << " is not in the vocabulary of " << bound << " words.");
+  }
+}
+
+namespace {
+
+// Left-to-right scoring of one sentence.
+class SentenceScan {
+  public:
+    SentenceScan(const Model &model, bool begin_sentence, std::vector<char> &states)
+      : model_(model), in_(&states[0]), out_(&states[model.StateSize()]), total_(0.0) {
+      if (begin_sentence) {
+        model_.BeginSentenceWrite(in_);
+      } else {
+        model_.NullContextWrite(in_);
+      }
+    }
+
+    float Add(WordIndex word) {
+      float score = model_.BaseScore(in_, word, out_);
+      std::swap(in_, out_);
+      total_ += score;
+      return score;
+    }
+
+    float Total() const { return total_; }
+
+  private:
+    const Model &model_;
+    void *in_, *out_;
+    float total_;
+};
+
+} // namespace
+
+void ScoreBatchBlock(const Model &model, const SentenceBatch &batch, std::size_t block, std::vector<char> &states) {
+  states.resize(2 * model.StateSize());
+  const Vocabulary &vocab = model.BaseVocabulary();
+  for (std::size_t i = block * kBatchBlock; i < std::min(batch.count, (block + 1) * kBatchBlock); ++i) {
+    SentenceScan scan(model, batch.begin_sentence, states);
+    if (batch.sentences) {
+      std::vector<float> *out = batch.block_words ? &batch.block_words[block] : NULL;
+      std::size_t tokens = 0;
+      for (util::TokenIter<util::BoolCharacter, true> word(StringPiece(batch.sentences[i], batch.lengths[i]), util::kSpaces); word; ++word, ++tokens) {
+        float score = scan.Add(vocab.Index(*word));
+        if (out) out->push_back(score);
+      }
+      if (batch.end_sentence) {
+        float score = scan.Add(vocab.EndSentence());
+        if (out) out->push_back(score);
+        ++tokens;
+      }
+      if (batch.tokens) batch.tokens[i] = tokens;
+    } else {
+      // Sentence i's scores start after its predecessors' ids and </s>.
+      float *out = batch.words ? batch.words + (batch.offsets[i] - batch.offsets[0]) + (batch.end_sentence ? i : 0) : NULL;
+      for (const WordIndex *id = batch.ids + batch.offsets[i]; id != batch.ids + batch.offsets[i + 1]; ++id) {
+        float score = scan.Add(*id);
+        if (out) *out++ = score;
+      }
+      if (batch.end_sentence) {
+        float score = scan.Add(vocab.EndSentence());
+        if (out) *out = score;
+      }
+    }
+    batch.totals[i] = scan.Total();
+  }
+}
+
+} // namespace base
+} // namespace lm
@@ -0,0 +1,63 @@
+#ifndef LM_BATCH_SCORE_H
+#define LM_BATCH_SCORE_H
+
+#include "word_index.hh"
+
+#include <cstddef>
+#include <vector>
+
+namespace lm {
+namespace base {
+
+class Model;
+
+/* Whole sentences to score left to right with a virtual model.  A batch is
+ * split into blocks of kBatchBlock sentences that can be scored independently,
+ * so callers can spread blocks over threads, each with its own states.
+ */
+const std::size_t kBatchBlock = 64;
+
+struct SentenceBatch {
+  SentenceBatch();
+
+  // Either sentences and lengths or ids and offsets.  Sentence i is
+  // [sentences[i], sentences[i] + lengths[i]) split on whitespace, or
+  // ids[offsets[i]] through ids[offsets[i+1]-1].
+  const char *const *sentences;
+  const std::size_t *lengths;
+
+  const WordIndex *ids;
+  const std::size_t *offsets;
+
+  std::size_t count;
+  bool begin_sentence, end_sentence;
+
+  // totals[i] gets sentence i's log10 probability.
+  float *totals;
+
+  // Optional scores of each token, with </s> if end_sentence.  For ids,
+  // words is flat: sentence i starts after the tokens and </s> of the
+  // sentences before it.  For sentences, where the number of tokens is not
+  // known in advance, block_words has Blocks() vectors and block b's scores
+  // are appended to block_words[b], while tokens[i] gets sentence i's count.
+  float *words;
+  std::vector<float> *block_words;
+  std::size_t *tokens;
+
+  std::size_t Blocks() const {
+    return (count + kBatchBlock - 1) / kBatchBlock;
+  }
+};
+
+// Throws util::Exception if offsets decrease or an id is not in model's
+// vocabulary.
+void CheckBatchIds(const Model &model, const WordIndex *ids, const std::size_t *offsets, std::size_t count);
+
+// Score the sentences in block of batch.  states is scratch space that is
+// resized for two of model's states, so reuse one per thread.
+void ScoreBatchBlock(const Model &model, const SentenceBatch &batch, std::size_t block, std::vector<char> &states);
+
+} // namespace base
+} // namespace lm
+
+#endif // LM_BATCH_SCORE_H
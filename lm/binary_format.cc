@@ -1,12 +1,15 @@
 #include "binary_format.hh"
 
 #include "lm_exception.hh"
+#include "word_table.hh"
 #include "../util/file.hh"
 #include "../util/file_piece.hh"
+#include "../util/prefetch.hh"
 
 #include <cstddef>
 #include <cstring>
 #include <limits>
+#include <sstream>
 #include <string>
 #include <cstdlib>
 
@@ -137,8 +140,11 @@ const std::size_t kInvalidSize = static_cast<std::size_t>(-1);
 
 BinaryFormat::BinaryFormat(const Config &config)
   : write_method_(config.write_method), write_mmap_(config.write_mmap), load_method_(config.load_method),
+    build_word_table_(config.word_table), prefetch_threads_(config.prefetch_threads),
     header_size_(kInvalidSize), vocab_size_(kInvalidSize), vocab_string_offset_(kInvalidOffset) {}
 
+BinaryFormat::~BinaryFormat() {}
+
 void BinaryFormat::InitializeBinary(int fd, ModelType model_type, unsigned int search_version, Parameters &params) {
   file_.reset(fd);
   write_mmap_ = NULL; // Ignore write requests; this is already in binary format.
@@ -159,12 +165,62 @@ void *BinaryFormat::LoadBinary(std::size_t size) {
   uint64_t total_map = static_cast<uint64_t>(header_size_) + static_cast<uint64_t>(size);
   UTIL_THROW_IF(file_size != util::kBadSize && file_size < total_map, FormatLoadException, "Binary file has size " << file_size << " but the headers say it should be at least " << total_map);
 
-  util::MapRead(load_method_, file_.get(), 0, util::CheckOverflow(total_map), mapping_);
+  if (load_method_ == util::SHARED) {
+    UTIL_THROW_IF(file_size == util::kBadSize, FormatLoadException, "Shared memory needs a regular binary file.");
+    shared_.Attach(util::SharedSegment::NameFor(file_.get(), "/kenlm-"), file_.get(), file_size);
+    // Another process may have copied a different file with the same name.
+    std::string header(header_size_, 0);
+    util::ErsatzPRead(file_.get(), &header[0], header_size_, 0);
+    UTIL_THROW_IF(memcmp(header.data(), shared_.begin(), header_size_), FormatLoadException, "Shared memory segment " << shared_.Name() << " does not match the binary file's header.  Remove it from /dev/shm if it is stale.");
+    mapping_.reset(const_cast<char*>(shared_.begin()), util::CheckOverflow(total_map), util::scoped_memory::NONE_ALLOCATED);
+  } else {
+    util::MapRead(load_method_, file_.get(), 0, util::CheckOverflow(total_map), mapping_);
+  }
 
   vocab_string_offset_ = total_map;
   return reinterpret_cast<uint8_t*>(mapping_.get()) + header_size_;
 }
 
+void BinaryFormat::LoadWordTable() {
+  assert(vocab_string_offset_ != kInvalidOffset);
+  // The last 8 bytes of the file point to the beginning of the table.
+  const uint64_t file_size = util::SizeOrThrow(file_.get());
+  UTIL_THROW_IF(file_size < vocab_string_offset_ + sizeof(uint64_t), FormatLoadException, "Binary file claims to have a word table but it is too short.  Is it truncated?");
+  const uint64_t table_end = file_size - sizeof(uint64_t);
+  uint64_t table_begin;
+  util::ErsatzPRead(file_.get(), &table_begin, sizeof(uint64_t), table_end);
+  UTIL_THROW_IF(table_begin < vocab_string_offset_ || table_begin > table_end, FormatLoadException, "Word table offset " << table_begin << " is out of range.");
+  if (load_method_ == util::SHARED) {
+    word_table_.reset(const_cast<char*>(shared_.begin()) + table_begin, util::CheckOverflow(table_end - table_begin), util::scoped_memory::NONE_ALLOCATED);
+    return;
+  }
+  // mmap requires page alignment.
+  const uint64_t map_begin = table_begin - table_begin % util::SizePage();
+  util::MapRead(load_method_, file_.get(), map_begin, util::CheckOverflow(table_end - map_begin), word_table_mapping_);
+  word_table_.reset(word_table_mapping_.begin() + (table_begin - map_begin), util::CheckOverflow(table_end - table_begin), util::scoped_memory::NONE_ALLOCATED);
+}
+
+void BinaryFormat::StartPrefetch(std::size_t vocab_size, const std::vector<uint64_t> &order_ends, std::ostream *messages) {
+  if (load_method_ != util::LAZY_PREFETCH) return;
+  // The search lays out unigrams, then the middle orders, then the highest
+  // order, so prefetching in address order is also priority order.
+  const std::size_t vocab_end = header_size_ + vocab_size;
+  std::vector<util::PrefetchRange> ranges;
+  ranges.push_back(util::PrefetchRange(mapping_.begin(), vocab_end, "vocabulary"));
+  std::size_t begin = vocab_end;
+  for (std::size_t i = 0; i < order_ends.size(); ++i) {
+    // Anything after the highest order goes with it.
+    std::size_t end = (i + 1 == order_ends.size()) ? mapping_.size() : vocab_end + util::CheckOverflow(order_ends[i]);
+    assert(begin <= end && end <= mapping_.size());
+    std::ostringstream name;
+    name << (i + 1) << "-grams";
+    ranges.push_back(util::PrefetchRange(mapping_.begin() + begin, end - begin, name.str()));
+    begin = end;
+  }
+  if (word_table_.size()) ranges.push_back(util::PrefetchRange(word_table_.begin(), word_table_.size(), "word table"));
+  prefetch_.reset(new util::Prefetcher(ranges, prefetch_threads_, util::Prefetcher::kDefaultChunk, messages));
+}
+
 void *BinaryFormat::SetupJustVocab(std::size_t memory_size, uint8_t order) {
   vocab_size_ = memory_size;
   if (!write_mmap_) {
@@ -223,6 +279,12 @@ void *BinaryFormat::GrowForSearch(std::size_t memory_size, std::size_t vocab_pad
 void BinaryFormat::WriteVocabWords(const std::string &buffer, void *&vocab_base, void *&search_base) {
   // Checking Config's include_vocab is the responsibility of the caller.
   assert(header_size_ != kInvalidSize && vocab_size_ != kInvalidSize);
+  std::string table;
+  if (build_word_table_) {
+    WordTable::Build(buffer.data(), buffer.data() + buffer.size(), table);
+    util::HugeMalloc(table.size(), false, word_table_);
+    std::memcpy(word_table_.get(), table.data(), table.size());
+  }
   if (!write_mmap_) {
     // Unchanged base.
     vocab_base = reinterpret_cast<uint8_t*>(memory_vocab_.get());
@@ -234,6 +296,14 @@ void BinaryFormat::WriteVocabWords(const std::string &buffer, void *&vocab_base,
   }
   util::SeekOrThrow(file_.get(), VocabStringReadingOffset());
   util::WriteOrThrow(file_.get(), &buffer[0], buffer.size());
+  if (build_word_table_) {
+    // Align the table then point to it from the end of the file.
+    uint64_t table_begin = ALIGN8(VocabStringReadingOffset() + buffer.size());
+    const char zeros[8] = {0};
+    util::WriteOrThrow(file_.get(), zeros, table_begin - VocabStringReadingOffset() - buffer.size());
+    util::WriteOrThrow(file_.get(), table.data(), table.size());
+    util::WriteOrThrow(file_.get(), &table_begin, sizeof(uint64_t));
+  }
   if (write_method_ == Config::WRITE_MMAP) {
     MapFile(vocab_base, search_base);
   } else {
@@ -263,7 +333,8 @@ void BinaryFormat::FinishFile(const Config &config, ModelType model_type, unsign
   params.fixed.order = counts.size();
   params.fixed.probing_multiplier = config.probing_multiplier;
   params.fixed.model_type = model_type;
-  params.fixed.has_vocabulary = config.include_vocab;
+  params.fixed.has_vocabulary = config.include_vocab || build_word_table_;
+  params.fixed.has_word_table = build_word_table_;
   params.fixed.search_version = search_version;
   switch (write_method_) {
     case Config::WRITE_MMAP:
@@ -288,6 +359,11 @@ void BinaryFormat::MapFile(void *&vocab_base, void *&search_base) {
 }
 
 bool RecognizeBinary(const char *file, ModelType &recognized) {
+  unsigned char ignored;
+  return RecognizeBinary(file, recognized, ignored);
+}
+
+bool RecognizeBinary(const char *file, ModelType &recognized, unsigned char &order) {
   util::scoped_fd fd(util::OpenReadOrThrow(file));
   if (!IsBinaryFormat(fd.get())) {
     return false;
@@ -295,6 +371,7 @@ bool RecognizeBinary(const char *file, ModelType &recognized) {
   Parameters params;
   ReadHeader(fd.get(), params);
   recognized = params.fixed.model_type;
+  order = params.fixed.order;
   return true;
 }
 
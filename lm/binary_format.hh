@@ -8,12 +8,15 @@
 #include "../util/file_piece.hh"
 #include "../util/mmap.hh"
 #include "../util/scoped.hh"
+#include "../util/shared_segment.hh"
 
 #include <cstddef>
 #include <vector>
 
 #include <stdint.h>
 
+namespace util { class Prefetcher; }
+
 namespace lm {
 namespace ngram {
 
@@ -25,6 +28,9 @@ extern const char *kModelNames[6];
  */
 bool RecognizeBinary(const char *file, ModelType &recognized);
 
+// Also report the order of the model.
+bool RecognizeBinary(const char *file, ModelType &recognized, unsigned char &order);
+
 struct FixedWidthParameters {
   unsigned char order;
   float probing_multiplier;
@@ -32,6 +38,9 @@ struct FixedWidthParameters {
   ModelType model_type;
   // Does the end of the file have the actual strings in the vocabulary?
   bool has_vocabulary;
+  // Is there a word table after the strings?  This fits in what used to be
+  // zeroed padding, so older files read as false.
+  bool has_word_table;
   unsigned int search_version;
 };
 
@@ -48,6 +57,8 @@ class BinaryFormat {
   public:
     explicit BinaryFormat(const Config &config);
 
+    ~BinaryFormat();
+
     // Reading a binary file:
     // Takes ownership of fd
     void InitializeBinary(int fd, ModelType model_type, unsigned int search_version, Parameters &params);
@@ -61,16 +72,38 @@ class BinaryFormat {
       return vocab_string_offset_;
     }
 
+    // Map the word table from the end of the file.  Only call if the header
+    // says has_word_table.
+    void LoadWordTable();
+
+    // With util::LAZY_PREFETCH, start faulting in the loaded file from
+    // background threads.  Otherwise, do nothing.  Call after the word table,
+    // if any, is loaded.  order_ends are offsets from the start of the search
+    // to the end of each order, as from Search::OrderEnds.  Each range is
+    // logged to messages, if not NULL, when done.
+    void StartPrefetch(std::size_t vocab_size, const std::vector<uint64_t> &order_ends, std::ostream *messages);
+
+    // Progress of StartPrefetch or NULL if the file is not being prefetched.
+    // Range 0 is the header and vocabulary, then there is one range for each
+    // order, and the word table comes last if there is one.  The highest order
+    // range extends to the end of the search.
+    const util::Prefetcher *Prefetching() const { return prefetch_.get(); }
+    util::Prefetcher *Prefetching() { return prefetch_.get(); }
+
     // Writing a binary file or initializing in RAM from ARPA:
     // Size for vocabulary.
     void *SetupJustVocab(std::size_t memory_size, uint8_t order);
     // Warning: can change the vocaulary base pointer.
     void *GrowForSearch(std::size_t memory_size, std::size_t vocab_pad, void *&vocab_base);
     // Warning: can change vocabulary and search base addresses.
+    // Also builds the word table if configured.
     void WriteVocabWords(const std::string &buffer, void *&vocab_base, void *&search_base);
     // Write the header at the beginning of the file.
     void FinishFile(const Config &config, ModelType model_type, unsigned int search_version, const std::vector<uint64_t> &counts);
 
+    // Word table memory, if any, after WriteVocabWords or LoadWordTable.
+    const util::scoped_memory &WordTableMemory() const { return word_table_; }
+
   private:
     void MapFile(void *&vocab_base, void *&search_base);
 
@@ -78,10 +111,16 @@ class BinaryFormat {
     const Config::WriteMethod write_method_;
     const char *write_mmap_;
     util::LoadMethod load_method_;
+    const bool build_word_table_;
+    const unsigned int prefetch_threads_;
 
     // File behind memory, if any.
     util::scoped_fd file_;
 
+    // With util::SHARED, the whole file.  mapping_ and word_table_ point
+    // into it.
+    util::SharedSegment shared_;
+
     // If there is a file involved, a single mapping.
     util::scoped_memory mapping_;
 
@@ -90,6 +129,10 @@ class BinaryFormat {
     // have pruned).
     util::scoped_memory memory_vocab_, memory_search_;
 
+    // Front-coded word table.  Mapped separately because it follows the
+    // variable-length strings.
+    util::scoped_memory word_table_mapping_, word_table_;
+
     // Memory ranges.  Note that these may not be contiguous and may not all
     // exist.
     std::size_t header_size_, vocab_size_, vocab_pad_;
@@ -97,6 +140,9 @@ class BinaryFormat {
     uint64_t vocab_string_offset_;
 
     static const uint64_t kInvalidOffset = (uint64_t)-1;
+
+    // Declared last so the threads stop before the memory is unmapped.
+    util::scoped_ptr<util::Prefetcher> prefetch_;
 };
 
 bool IsBinaryFormat(int fd);
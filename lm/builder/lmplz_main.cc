@@ -4,6 +4,7 @@
 #include "../lm_exception.hh"
 #include "../../util/file.hh"
 #include "../../util/file_piece.hh"
+#include "../../util/float_to_string.hh"
 #include "../../util/usage.hh"
 
 #include <iostream>
@@ -72,7 +73,7 @@ int main(int argc, char *argv[]) {
     po::options_description options("Language model building options");
     lm::builder::PipelineConfig pipeline;
 
-    std::string text, intermediate, arpa;
+    std::string text, intermediate, arpa, arpa_compress;
     std::vector<std::string> pruning;
     std::vector<std::string> discount_fallback;
     std::vector<std::string> discount_fallback_default;
@@ -80,6 +81,8 @@ int main(int argc, char *argv[]) {
     discount_fallback_default.push_back("1");
     discount_fallback_default.push_back("1.5");
     bool verbose_header;
+    unsigned int arpa_precision;
+    std::size_t arpa_threads, compress_threads;
 
     options.add_options()
       ("help,h", po::bool_switch(), "Show this help message")
@@ -99,7 +102,12 @@ int main(int argc, char *argv[]) {
       ("vocab_pad", po::value<uint64_t>(&pipeline.vocab_size_for_unk)->default_value(0), "If the vocabulary is smaller than this value, pad with <unk> to reach this size. Requires --interpolate_unigrams")
       ("verbose_header", po::bool_switch(&verbose_header), "Add a verbose header to the ARPA file that includes information such as token count, smoothing type, etc.")
       ("text", po::value<std::string>(&text), "Read text from a file instead of stdin")
+      ("decompress_threads", po::value<std::size_t>(&pipeline.decompress_threads)->default_value(1), "Threads that decompress the text when it is zstd or lz4 with multiple frames")
       ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("arpa_precision", po::value<unsigned int>(&arpa_precision)->default_value(0), "Round probabilities and backoffs in the ARPA file to this many digits after the decimal point, at most 9.  This is much faster to write than the default, which is the shortest representation that reads back exactly")
+      ("arpa_threads", po::value<std::size_t>(&arpa_threads)->default_value(1), "Threads that format the ARPA file")
+      ("arpa_compress", po::value<std::string>(&arpa_compress), "Compress the ARPA file with none, gzip, or zstd.  The default is gzip if --arpa ends with .gz, zstd if it ends with .zst, and none otherwise")
+      ("compress_threads", po::value<std::size_t>(&compress_threads)->default_value(1), "Threads that compress the ARPA file")
       ("intermediate", po::value<std::string>(&intermediate), "Write ngrams to intermediate files.  Turns off ARPA output (which can be reactivated by --arpa file).  Forces --renumber on.")
       ("renumber", po::bool_switch(&pipeline.renumber_vocabulary), "Renumber the vocabulary identifiers so that they are monotone with the hash of each string.  This is consistent with the ordering used by the trie data structure.")
       ("collapse_values", po::bool_switch(&pipeline.output_q), "Collapse probability and backoff into a single value, q that yields the same sentence-level probabilities.  See http://kheafield.com/professional/edinburgh/rest_paper.pdf for more details, including a proof.")
@@ -148,6 +156,16 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    if (arpa_precision > util::kToStringFixedMaxPrecision) {
+      std::cerr << "--arpa_precision is at most " << util::kToStringFixedMaxPrecision << std::endl;
+      return 1;
+    }
+    if (!arpa_threads) {
+      std::cerr << "--arpa_threads must be positive" << std::endl;
+      return 1;
+    }
+    util::WriteCompressed::Format compress = vm.count("arpa_compress") ? util::WriteCompressed::ParseFormat(arpa_compress) : util::WriteCompressed::FormatFromName(arpa);
+
     if (pipeline.vocab_size_for_unk && !pipeline.initial_probs.interpolate_unigrams) {
       std::cerr << "--vocab_pad requires --interpolate_unigrams be on" << std::endl;
       return 1;
@@ -204,7 +222,7 @@ int main(int argc, char *argv[]) {
       }
       lm::builder::Output output(writing_intermediate ? intermediate : pipeline.sort.temp_prefix, writing_intermediate, pipeline.output_q);
       if (!writing_intermediate || vm.count("arpa")) {
-        output.Add(new lm::builder::PrintHook(out.release(), verbose_header));
+        output.Add(new lm::builder::PrintHook(out.release(), verbose_header, arpa_precision, arpa_threads, compress, compress_threads));
       }
       lm::builder::Pipeline(pipeline, in.release(), output);
     } catch (const util::MallocException &e) {
@@ -41,12 +41,12 @@ void Output::Apply(HookType hook_type, util::stream::Chains &chains) {
 
 void PrintHook::Sink(const HeaderInfo &info, int vocab_file, util::stream::Chains &chains) {
   if (verbose_header_) {
-    util::FileStream out(file_.get(), 50);
+    util::FileStream out(out_, 50);
     out << "# Input file: " << info.input_file << '\n';
     out << "# Token count: " << info.token_count << '\n';
     out << "# Smoothing: Modified Kneser-Ney" << '\n';
   }
-  chains >> PrintARPA(vocab_file, file_.get(), info.counts_pruned);
+  chains >> PrintARPA(vocab_file, out_, info.counts_pruned, precision_, threads_);
 }
 
 }} // namespaces
@@ -4,6 +4,7 @@
 #include "header_info.hh"
 #include "../common/model_buffer.hh"
 #include "../../util/file.hh"
+#include "../../util/write_compressed.hh"
 
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/utility.hpp>
@@ -69,15 +70,18 @@ class Output : boost::noncopyable {
 
 class PrintHook : public OutputHook {
   public:
-    // Takes ownership
-    PrintHook(int write_fd, bool verbose_header)
-      : OutputHook(PROB_SEQUENTIAL_HOOK), file_(write_fd), verbose_header_(verbose_header) {}
+    // Takes ownership.  See PrintARPA for precision and threads and
+    // WriteCompressed for compress and compress_threads.
+    PrintHook(int write_fd, bool verbose_header, unsigned int precision = 0, std::size_t threads = 1, util::WriteCompressed::Format compress = util::WriteCompressed::NONE, std::size_t compress_threads = 1)
+      : OutputHook(PROB_SEQUENTIAL_HOOK), out_(write_fd, compress, compress_threads), verbose_header_(verbose_header), precision_(precision), threads_(threads) {}
 
     void Sink(const HeaderInfo &info, int vocab_file, util::stream::Chains &chains);
 
   private:
-    util::scoped_fd file_;
+    util::WriteCompressed out_;
     bool verbose_header_;
+    unsigned int precision_;
+    std::size_t threads_;
 };
 
 }} // namespaces
@@ -225,7 +225,7 @@ util::stream::Sort<SuffixOrder, CombineCounts> *CountText(int text_file /* input
   util::stream::Chain chain(util::stream::ChainConfig(NGram<BuildingPayload>::TotalSize(config.order), config.block_count, memory_for_chain));
 
   type_count = config.vocab_estimate;
-  util::FilePiece text(text_file, NULL, &std::cerr);
+  util::FilePiece text(text_file, NULL, &std::cerr, 1048576, config.decompress_threads);
   text_file_name = text.FileName();
   CorpusCount counter(text, vocab_file, true, token_count, type_count, prune_words, config.prune_vocab_file, chain.BlockSize() / chain.EntrySize(), config.disallowed_symbol_action);
   chain >> boost::ref(counter);
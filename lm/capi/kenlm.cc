@@ -0,0 +1,164 @@
+#include "kenlm.h"
+
+#include "../batch_score.hh"
+#include "../model.hh"
+#include "../virtual_interface.hh"
+#include "../../util/exception.hh"
+#include "../../util/pcqueue.hh"
+#include "../../util/scoped.hh"
+#include "../../util/thread_pool.hh"
+
+#include <boost/utility/in_place_factory.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace lm {
+namespace capi {
+namespace {
+
+// One call's batch and how many of its blocks are left.
+struct Batch {
+  Batch() : remaining(0), done(0) {}
+
+  base::SentenceBatch sentences;
+
+  // Blocks not yet scored.  The thread that finishes the last posts done.
+  std::atomic<std::size_t> remaining;
+  util::Semaphore done;
+};
+
+class BatchWorker {
+  public:
+    // Block of a batch.  (NULL, 0) stops the thread.
+    typedef std::pair<Batch*, std::size_t> Request;
+
+    explicit BatchWorker(const base::Model &model) : model_(model) {}
+
+    void operator()(const Request &request) {
+      base::ScoreBatchBlock(model_, request.first->sentences, request.second, states_);
+      if (--request.first->remaining == 0) request.first->done.post();
+    }
+
+  private:
+    const base::Model &model_;
+    std::vector<char> states_;
+};
+
+void SetError(char **error, const char *message) {
+  if (!error) return;
+  std::size_t length = std::strlen(message);
+  *error = static_cast<char*>(std::malloc(length + 1));
+  if (*error) std::memcpy(*error, message, length + 1);
+}
+
+} // namespace
+} // namespace capi
+} // namespace lm
+
+struct kenlm_model {
+  kenlm_model(const char *file, std::size_t threads) : model(lm::ngram::LoadVirtual(file)) {
+    if (threads) {
+      pool.reset(new util::ThreadPool<lm::capi::BatchWorker>(threads * 4, threads, boost::in_place(boost::cref(*model)), lm::capi::BatchWorker::Request(NULL, 0)));
+    }
+  }
+
+  // Score on the pool, or on this thread if there is no pool or only one
+  // block.
+  void Run(lm::capi::Batch &batch) {
+    std::size_t blocks = batch.sentences.Blocks();
+    if (!pool.get() || blocks <= 1) {
+      std::vector<char> states;
+      for (std::size_t b = 0; b < blocks; ++b) {
+        lm::base::ScoreBatchBlock(*model, batch.sentences, b, states);
+      }
+      return;
+    }
+    batch.remaining = blocks;
+    for (std::size_t b = 0; b < blocks; ++b) {
+      pool->Produce(lm::capi::BatchWorker::Request(&batch, b));
+    }
+    util::WaitSemaphore(batch.done);
+  }
+
+  util::scoped_ptr<lm::base::Model> model;
+  // Declared after model so threads stop first.
+  util::scoped_ptr<util::ThreadPool<lm::capi::BatchWorker> > pool;
+};
+
+extern "C" {
+
+kenlm_model *kenlm_load(const char *file, size_t threads, char **error) {
+  try {
+    return new kenlm_model(file, threads);
+  } catch (const std::exception &e) {
+    lm::capi::SetError(error, e.what());
+    return NULL;
+  }
+}
+
+void kenlm_free(kenlm_model *model) {
+  delete model;
+}
+
+void kenlm_free_error(char *error) {
+  std::free(error);
+}
+
+unsigned int kenlm_order(const kenlm_model *model) {
+  return model->model->Order();
+}
+
+uint32_t kenlm_vocab_size(const kenlm_model *model) {
+  return model->model->BaseVocabulary().Bound();
+}
+
+void kenlm_index(const kenlm_model *model, const char *const *words, const size_t *lengths, size_t count, uint32_t *ids) {
+  const lm::base::Vocabulary &vocab = model->model->BaseVocabulary();
+  for (size_t i = 0; i < count; ++i) {
+    ids[i] = vocab.Index(StringPiece(words[i], lengths[i]));
+  }
+}
+
+int kenlm_score_sentences(kenlm_model *model, const char *const *sentences, const size_t *lengths, size_t count, int flags, float *totals, char **error) {
+  try {
+    lm::capi::Batch batch;
+    batch.sentences.sentences = sentences;
+    batch.sentences.lengths = lengths;
+    batch.sentences.count = count;
+    batch.sentences.begin_sentence = flags & KENLM_BEGIN_SENTENCE;
+    batch.sentences.end_sentence = flags & KENLM_END_SENTENCE;
+    batch.sentences.totals = totals;
+    model->Run(batch);
+    return 0;
+  } catch (const std::exception &e) {
+    lm::capi::SetError(error, e.what());
+    return -1;
+  }
+}
+
+int kenlm_score_ids(kenlm_model *model, const uint32_t *ids, const size_t *offsets, size_t count, int flags, float *totals, float *words, char **error) {
+  try {
+    lm::base::CheckBatchIds(*model->model, ids, offsets, count);
+    lm::capi::Batch batch;
+    batch.sentences.ids = ids;
+    batch.sentences.offsets = offsets;
+    batch.sentences.count = count;
+    batch.sentences.begin_sentence = flags & KENLM_BEGIN_SENTENCE;
+    batch.sentences.end_sentence = flags & KENLM_END_SENTENCE;
+    batch.sentences.totals = totals;
+    batch.sentences.words = words;
+    model->Run(batch);
+    return 0;
+  } catch (const std::exception &e) {
+    lm::capi::SetError(error, e.what());
+    return -1;
+  }
+}
+
+} // extern "C"
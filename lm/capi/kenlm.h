@@ -0,0 +1,69 @@
+#ifndef LM_CAPI_KENLM_H
+#define LM_CAPI_KENLM_H
+
+/* A C interface to scoring for languages that call KenLM through a foreign
+ * function interface.  Each call scores a whole batch, so the cost of crossing
+ * into C and of virtual dispatch is paid per batch rather than per word.  A
+ * model owns a pool of threads that split batches between them, each with its
+ * own states.
+ *
+ * Types are opaque and functions are only ever added, so programs built
+ * against this header keep working with newer libraries.  Functions do not
+ * throw.  Those that can fail return 0 on success; on failure they return -1
+ * and, if error is not NULL, set *error to a message to release with
+ * kenlm_free_error.  A model may be used by several threads at once.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kenlm_model kenlm_model;
+
+/* Flags for scoring. */
+#define KENLM_BEGIN_SENTENCE 1 /* Condition on <s>.  Otherwise use null context. */
+#define KENLM_END_SENTENCE 2   /* Predict </s> after each sentence. */
+
+/* Load an ARPA or binary file.  threads is the number of threads that score
+ * batches; 0 scores on the calling thread.  Returns NULL on failure.
+ */
+kenlm_model *kenlm_load(const char *file, size_t threads, char **error);
+
+/* Stop the threads and release the model.  NULL is ignored. */
+void kenlm_free(kenlm_model *model);
+
+void kenlm_free_error(char *error);
+
+unsigned int kenlm_order(const kenlm_model *model);
+
+/* Ids are [0, kenlm_vocab_size(model)).  0 is <unk>. */
+uint32_t kenlm_vocab_size(const kenlm_model *model);
+
+/* Look up count words.  Word i is words[i] with lengths[i] bytes, without a
+ * terminating null.  ids gets count entries.
+ */
+void kenlm_index(const kenlm_model *model, const char *const *words, const size_t *lengths, size_t count, uint32_t *ids);
+
+/* Score count sentences, each split on spaces, tabs, and newlines.  Sentence i
+ * is sentences[i] with lengths[i] bytes.  totals[i] gets its log10
+ * probability.
+ */
+int kenlm_score_sentences(kenlm_model *model, const char *const *sentences, const size_t *lengths, size_t count, int flags, float *totals, char **error);
+
+/* Score count sentences of ids.  Sentence i is ids[offsets[i]] through
+ * ids[offsets[i+1]-1], so offsets has count + 1 entries.  totals[i] gets its
+ * log10 probability.  If words is not NULL, it gets the log10 probability of
+ * each id, followed by </s> after each sentence with KENLM_END_SENTENCE, for
+ * offsets[count] - offsets[0] entries plus count with KENLM_END_SENTENCE.
+ * Fails if offsets decrease or an id is out of range.
+ */
+int kenlm_score_ids(kenlm_model *model, const uint32_t *ids, const size_t *offsets, size_t count, int flags, float *totals, float *words, char **error);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* LM_CAPI_KENLM_H */
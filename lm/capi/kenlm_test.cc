@@ -0,0 +1,161 @@
+#include "kenlm.h"
+
+#include "../model.hh"
+#include "../../util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE KenLMCTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace lm {
+namespace capi {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "../test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+const char *kSentences[] = {
+  "looking on a little more loin",
+  "also would consider higher to look good",
+  "biarritz unknownword",
+  "",
+  " on  a\tlittle ",
+};
+
+// Score directly to compare with the C interface.
+float Direct(const ngram::ProbingModel &model, const char *sentence, bool begin, bool end, std::vector<float> *words) {
+  ngram::State state(begin ? model.BeginSentenceState() : model.NullContextState()), out;
+  float ret = 0.0;
+  for (util::TokenIter<util::BoolCharacter, true> word(sentence, util::kSpaces); word; ++word) {
+    float score = model.FullScore(state, model.GetVocabulary().Index(*word), out).prob;
+    if (words) words->push_back(score);
+    ret += score;
+    state = out;
+  }
+  if (end) {
+    float score = model.FullScore(state, model.GetVocabulary().EndSentence(), out).prob;
+    if (words) words->push_back(score);
+    ret += score;
+  }
+  return ret;
+}
+
+class Loaded {
+  public:
+    explicit Loaded(std::size_t threads) {
+      char *error = NULL;
+      model_ = kenlm_load(TestLocation(), threads, &error);
+      BOOST_REQUIRE_MESSAGE(model_, error);
+    }
+
+    ~Loaded() { kenlm_free(model_); }
+
+    kenlm_model *Get() { return model_; }
+
+  private:
+    kenlm_model *model_;
+};
+
+// Enough copies of kSentences to need several blocks.
+void MakeBatch(std::vector<const char*> &sentences, std::vector<std::size_t> &lengths) {
+  for (std::size_t i = 0; i < 500; ++i) {
+    const char *sentence = kSentences[i % (sizeof(kSentences) / sizeof(const char*))];
+    sentences.push_back(sentence);
+    lengths.push_back(std::strlen(sentence));
+  }
+}
+
+void CheckSentences(std::size_t threads) {
+  ngram::ProbingModel direct(TestLocation());
+  Loaded loaded(threads);
+  std::vector<const char*> sentences;
+  std::vector<std::size_t> lengths;
+  MakeBatch(sentences, lengths);
+  for (int flags = 0; flags < 4; ++flags) {
+    std::vector<float> totals(sentences.size());
+    BOOST_REQUIRE_EQUAL(0, kenlm_score_sentences(loaded.Get(), &sentences[0], &lengths[0], sentences.size(), flags, &totals[0], NULL));
+    for (std::size_t i = 0; i < sentences.size(); ++i) {
+      BOOST_CHECK_CLOSE(Direct(direct, sentences[i], flags & KENLM_BEGIN_SENTENCE, flags & KENLM_END_SENTENCE, NULL), totals[i], 0.001);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SentencesInline) {
+  CheckSentences(0);
+}
+
+BOOST_AUTO_TEST_CASE(SentencesThreads) {
+  CheckSentences(3);
+}
+
+BOOST_AUTO_TEST_CASE(Ids) {
+  ngram::ProbingModel direct(TestLocation());
+  Loaded loaded(2);
+  BOOST_CHECK_EQUAL(5U, kenlm_order(loaded.Get()));
+  std::vector<const char*> sentences;
+  std::vector<std::size_t> lengths;
+  MakeBatch(sentences, lengths);
+
+  // Split into words and look them up.
+  std::vector<std::string> words;
+  std::vector<std::size_t> offsets(1, 0);
+  for (std::size_t i = 0; i < sentences.size(); ++i) {
+    for (util::TokenIter<util::BoolCharacter, true> word(sentences[i], util::kSpaces); word; ++word) {
+      words.push_back(word->as_string());
+    }
+    offsets.push_back(words.size());
+  }
+  std::vector<const char*> word_pointers;
+  std::vector<std::size_t> word_lengths;
+  for (std::size_t i = 0; i < words.size(); ++i) {
+    word_pointers.push_back(words[i].data());
+    word_lengths.push_back(words[i].size());
+  }
+  std::vector<uint32_t> ids(words.size());
+  kenlm_index(loaded.Get(), &word_pointers[0], &word_lengths[0], words.size(), &ids[0]);
+  BOOST_CHECK_EQUAL(0U, ids[std::find(words.begin(), words.end(), "unknownword") - words.begin()]);
+
+  int flags = KENLM_BEGIN_SENTENCE | KENLM_END_SENTENCE;
+  std::vector<float> totals(sentences.size()), scores(words.size() + sentences.size());
+  BOOST_REQUIRE_EQUAL(0, kenlm_score_ids(loaded.Get(), &ids[0], &offsets[0], sentences.size(), flags, &totals[0], &scores[0], NULL));
+  std::vector<float> expected;
+  for (std::size_t i = 0; i < sentences.size(); ++i) {
+    BOOST_CHECK_CLOSE(Direct(direct, sentences[i], true, true, &expected), totals[i], 0.001);
+  }
+  BOOST_REQUIRE_EQUAL(expected.size(), scores.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    BOOST_CHECK_CLOSE(expected[i], scores[i], 0.001);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Errors) {
+  char *error = NULL;
+  BOOST_CHECK(!kenlm_load("/nonexistent/model.arpa", 1, &error));
+  BOOST_REQUIRE(error);
+  kenlm_free_error(error);
+
+  Loaded loaded(1);
+  uint32_t ids[2] = {1, kenlm_vocab_size(loaded.Get())};
+  std::size_t offsets[3] = {0, 1, 2};
+  float totals[2];
+  error = NULL;
+  BOOST_CHECK_EQUAL(-1, kenlm_score_ids(loaded.Get(), ids, offsets, 2, 0, totals, NULL, &error));
+  BOOST_REQUIRE(error);
+  BOOST_CHECK(std::strstr(error, "not in the vocabulary"));
+  kenlm_free_error(error);
+
+  std::size_t decreasing[3] = {0, 1, 0};
+  BOOST_CHECK_EQUAL(-1, kenlm_score_ids(loaded.Get(), ids, decreasing, 2, 0, totals, NULL, NULL));
+}
+
+} // namespace
+} // namespace capi
+} // namespace lm
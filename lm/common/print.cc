@@ -3,10 +3,19 @@
 #include "ngram_stream.hh"
 #include "../../util/file_stream.hh"
 #include "../../util/file.hh"
+#include "../../util/float_to_string.hh"
+#include "../../util/integer_to_string.hh"
 #include "../../util/mmap.hh"
 #include "../../util/scoped.hh"
+#include "../../util/string_stream.hh"
+#include "../../util/thread_pool.hh"
+#include "../../util/write_compressed.hh"
 
+#include <boost/utility/in_place_factory.hpp>
+
+#include <deque>
 #include <sstream>
+#include <string>
 #include <cstring>
 
 namespace lm {
@@ -24,39 +33,197 @@ VocabReconstitute::VocabReconstitute(int fd) {
 }
 
 namespace {
-template <class Payload> void PrintLead(const VocabReconstitute &vocab, ProxyStream<Payload> &stream, util::FileStream &out) {
-  out << stream->Value().prob << '\t' << vocab.Lookup(*stream->begin());
-  for (const WordIndex *i = stream->begin() + 1; i != stream->end(); ++i) {
-    out << ' ' << vocab.Lookup(*i);
+template <class Stream> void PrintValue(float value, unsigned int precision, Stream &out) {
+  if (precision) {
+    char buf[util::kToStringFixedBytes];
+    out << StringPiece(buf, util::ToStringFixed(value, precision, buf) - buf);
+  } else {
+    out << value;
+  }
+}
+
+template <class Stream> void PrintLead(const VocabReconstitute &vocab, const WordIndex *begin, const WordIndex *end, float prob, unsigned int precision, Stream &out) {
+  PrintValue(prob, precision, out);
+  out << '\t' << vocab.LookupPiece(*begin);
+  for (const WordIndex *i = begin + 1; i != end; ++i) {
+    out << ' ' << vocab.LookupPiece(*i);
   }
 }
+
+template <class Stream> void PrintLine(const VocabReconstitute &vocab, const NGram<ProbBackoff> &gram, unsigned int precision, Stream &out) {
+  PrintLead(vocab, gram.begin(), gram.end(), gram.Value().prob, precision, out);
+  out << '\t';
+  PrintValue(gram.Value().backoff, precision, out);
+  out << '\n';
+}
+
+template <class Stream> void PrintLine(const VocabReconstitute &vocab, const NGram<Prob> &gram, unsigned int precision, Stream &out) {
+  PrintLead(vocab, gram.begin(), gram.end(), gram.Value().prob, precision, out);
+  out << '\n';
+}
+
+void PrintHeader(const std::vector<uint64_t> &counts, util::FileStream &out) {
+  out << "\\data\\\n";
+  for (size_t i = 0; i < counts.size(); ++i) {
+    out << "ngram " << (i+1) << '=' << counts[i] << '\n';
+  }
+  out << '\n';
+}
+
+// Copies of n-grams from one order, formatted by a worker.
+struct PrintBatch {
+  uint64_t sequence;
+  std::size_t order;
+  std::size_t entry_size;
+  bool highest;
+  std::string records;
+  // Section headers go here before the batch is formatted.
+  std::string text;
+};
+
+class PrintWorker {
+  public:
+    typedef PrintBatch *Request;
+
+    PrintWorker(const VocabReconstitute &vocab, unsigned int precision, util::PCQueue<Request> &done)
+      : vocab_(vocab), precision_(precision), done_(done) {}
+
+    void operator()(Request batch) {
+      out_.swap(batch->text);
+      if (batch->highest) {
+        Format<Prob>(*batch);
+      } else {
+        Format<ProbBackoff>(*batch);
+      }
+      out_.swap(batch->text);
+      done_.Produce(batch);
+    }
+
+  private:
+    template <class Payload> void Format(PrintBatch &batch) {
+      char *begin = &batch.records[0];
+      for (char *i = begin; i != begin + batch.records.size(); i += batch.entry_size) {
+        PrintLine(vocab_, NGram<Payload>(i, batch.order), precision_, out_);
+      }
+    }
+
+    const VocabReconstitute &vocab_;
+    unsigned int precision_;
+    util::StringStream out_;
+    util::PCQueue<Request> &done_;
+};
+
+// There should only be one PrintOutput.
+class PrintOutput {
+  public:
+    typedef PrintBatch *Request;
+
+    PrintOutput(util::WriteCompressed &out, util::PCQueue<Request> &done) : out_(out), done_(done), base_sequence_(0) {}
+
+    void operator()(Request batch) {
+      uint64_t pos = batch->sequence - base_sequence_;
+      if (pos >= ordering_.size()) {
+        ordering_.resize(pos + 1, NULL);
+      }
+      ordering_[pos] = batch;
+      while (!ordering_.empty() && ordering_.front()) {
+        out_.write(ordering_.front()->text.data(), ordering_.front()->text.size());
+        done_.Produce(ordering_.front());
+        ordering_.pop_front();
+        ++base_sequence_;
+      }
+    }
+
+  private:
+    util::WriteCompressed &out_;
+    util::PCQueue<Request> &done_;
+    std::deque<Request> ordering_;
+    uint64_t base_sequence_;
+};
+
+// Bytes of n-gram records in each batch.
+const std::size_t kPrintBatchBytes = 1 << 20;
 } // namespace
 
 void PrintARPA::Run(const util::stream::ChainPositions &positions) {
   VocabReconstitute vocab(vocab_fd_);
-  util::FileStream out(out_fd_);
-  out << "\\data\\\n";
-  for (size_t i = 0; i < positions.size(); ++i) {
-    out << "ngram " << (i+1) << '=' << counts_[i] << '\n';
+  if (threads_ > 1) {
+    {
+      util::FileStream out(*out_);
+      PrintHeader(counts_, out);
+    }
+    RunThreaded(vocab, positions);
+    out_->Flush();
+    return;
   }
-  out << '\n';
+  util::FileStream out(*out_);
+  PrintHeader(counts_, out);
 
   for (unsigned order = 1; order < positions.size(); ++order) {
     out << "\\" << order << "-grams:" << '\n';
     for (ProxyStream<NGram<ProbBackoff> > stream(positions[order - 1], NGram<ProbBackoff>(NULL, order)); stream; ++stream) {
-      PrintLead(vocab, stream, out);
-      out << '\t' << stream->Value().backoff << '\n';
+      PrintLine(vocab, *stream, precision_, out);
     }
     out << '\n';
   }
 
   out << "\\" << positions.size() << "-grams:" << '\n';
   for (ProxyStream<NGram<Prob> > stream(positions.back(), NGram<Prob>(NULL, positions.size())); stream; ++stream) {
-    PrintLead(vocab, stream, out);
-    out << '\n';
+    PrintLine(vocab, *stream, precision_, out);
   }
   out << '\n';
   out << "\\end\\\n";
+  out.flush();
+  out_->Flush();
+}
+
+namespace {
+PrintBatch *NextBatch(util::PCQueue<PrintBatch*> &recycle, uint64_t &sequence, std::size_t order, std::size_t entry_size, bool highest) {
+  PrintBatch *batch = recycle.Consume();
+  batch->sequence = sequence++;
+  batch->order = order;
+  batch->entry_size = entry_size;
+  batch->highest = highest;
+  batch->records.clear();
+  batch->text.clear();
+  return batch;
+}
+} // namespace
+
+void PrintARPA::RunThreaded(const VocabReconstitute &vocab, const util::stream::ChainPositions &positions) {
+  // Enough batches that workers do not wait on reading or writing.
+  const std::size_t queue = 2 * threads_ + 2;
+  std::vector<PrintBatch> batches(queue);
+  util::PCQueue<PrintBatch*> recycle(queue);
+  for (std::size_t i = 0; i < queue; ++i) {
+    recycle.Produce(&batches[i]);
+  }
+  util::ThreadPool<PrintOutput> output(queue, 1, boost::in_place(boost::ref(*out_), boost::ref(recycle)), NULL);
+  // Destroyed first, so workers finish before the output thread does.
+  util::ThreadPool<PrintWorker> workers(queue, threads_, boost::in_place(boost::cref(vocab), precision_, boost::ref(output.In())), NULL);
+  uint64_t sequence = 0;
+  for (std::size_t order = 1; order <= positions.size(); ++order) {
+    const bool highest = (order == positions.size());
+    // Entries may be larger than the payload, e.g. when the highest order has backoffs.
+    const std::size_t size = positions[order - 1].GetChain().EntrySize();
+    PrintBatch *batch = NextBatch(recycle, sequence, order, size, highest);
+    if (order != 1) batch->text += '\n';
+    batch->text += '\\';
+    char buf[util::ToStringBuf<uint64_t>::kBytes];
+    batch->text.append(buf, util::ToString(static_cast<uint64_t>(order), buf));
+    batch->text += "-grams:\n";
+    for (util::stream::Stream stream(positions[order - 1]); stream; ++stream) {
+      batch->records.append(static_cast<const char*>(stream.Get()), size);
+      if (batch->records.size() >= kPrintBatchBytes) {
+        workers.Produce(batch);
+        batch = NextBatch(recycle, sequence, order, size, highest);
+      }
+    }
+    workers.Produce(batch);
+  }
+  PrintBatch *end = NextBatch(recycle, sequence, positions.size(), 0, true);
+  end->text = "\n\\end\\\n";
+  workers.Produce(end);
 }
 
 } // namespace lm
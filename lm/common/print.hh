@@ -8,7 +8,10 @@
 #include <cassert>
 #include <vector>
 
-namespace util { namespace stream { class ChainPositions; }}
+namespace util {
+class WriteCompressed;
+namespace stream { class ChainPositions; }
+} // namespace util
 
 // Warning: PrintARPA routines read all unigrams before all bigrams before all
 // trigrams etc.  So if other parts of the chain move jointly, you'll have to
@@ -42,16 +45,29 @@ class VocabReconstitute {
 
 class PrintARPA {
   public:
-    // Does not take ownership of vocab_fd or out_fd.
-    explicit PrintARPA(int vocab_fd, int out_fd, const std::vector<uint64_t> &counts)
-      : vocab_fd_(vocab_fd), out_fd_(out_fd), counts_(counts) {}
+    /* Does not take ownership of vocab_fd or out, which is flushed at the end.
+     *
+     * If precision is positive, values are rounded to that many digits after
+     * the decimal point (at most util::kToStringFixedMaxPrecision), which
+     * formats much faster than the default shortest representation.
+     *
+     * With more than one thread, worker threads format blocks of n-grams while
+     * this thread reads the chains, and an output thread writes the blocks in
+     * order.  The file is the same as with one thread.
+     */
+    explicit PrintARPA(int vocab_fd, util::WriteCompressed &out, const std::vector<uint64_t> &counts, unsigned int precision = 0, std::size_t threads = 1)
+      : vocab_fd_(vocab_fd), out_(&out), counts_(counts), precision_(precision), threads_(threads) {}
 
     void Run(const util::stream::ChainPositions &positions);
 
   private:
+    void RunThreaded(const VocabReconstitute &vocab, const util::stream::ChainPositions &positions);
+
     int vocab_fd_;
-    int out_fd_;
+    util::WriteCompressed *out_;
     std::vector<uint64_t> counts_;
+    unsigned int precision_;
+    std::size_t threads_;
 };
 
 } // namespace lm
@@ -0,0 +1,70 @@
+#include "print.hh"
+
+#include "model_buffer.hh"
+#include "ngram.hh"
+#include "../../util/file.hh"
+#include "../../util/stream/chain.hh"
+#include "../../util/stream/multi_stream.hh"
+#include "../../util/write_compressed.hh"
+
+#define BOOST_TEST_MODULE PrintTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+namespace lm { namespace {
+
+std::string Dir() {
+  if (boost::unit_test::framework::master_test_suite().argc == 2) {
+    return boost::unit_test::framework::master_test_suite().argv[1];
+  }
+  return "test_data";
+}
+
+std::string Print(unsigned int precision, std::size_t threads) {
+#if BYTE_ORDER == LITTLE_ENDIAN
+  ModelBuffer buffer(Dir() + "/littleendian/toy0");
+#elif BYTE_ORDER == BIG_ENDIAN
+  ModelBuffer buffer(Dir() + "/bigendian/toy0");
+#else
+#error "Unsupported byte order."
+#endif
+  util::scoped_fd out(util::MakeTemp("print_test_temp"));
+  {
+    util::stream::Chains chains(buffer.Order());
+    // The buffer has backoffs for the highest order too, which PrintARPA skips.
+    for (std::size_t i = 0; i < buffer.Order(); ++i) {
+      std::size_t size = NGram<ProbBackoff>::TotalSize(i + 1);
+      chains.push_back(util::stream::ChainConfig(size, 2, size * 4));
+    }
+    buffer.Source(chains);
+    util::WriteCompressed write(util::DupOrThrow(out.get()), util::WriteCompressed::NONE);
+    chains >> PrintARPA(buffer.VocabFile(), write, buffer.Counts(), precision, threads);
+    chains >> util::stream::kRecycle;
+    chains.Wait(true);
+  }
+  std::string ret(util::SizeOrThrow(out.get()), 0);
+  util::ErsatzPRead(out.get(), &ret[0], ret.size(), 0);
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(Shortest) {
+  std::string sequential(Print(0, 1));
+  BOOST_CHECK_EQUAL(0U, sequential.find("\\data\\\nngram 1="));
+  BOOST_CHECK(sequential.find("\\3-grams:\n") != std::string::npos);
+  BOOST_CHECK_EQUAL(sequential.size() - 6, sequential.rfind("\\end\\\n"));
+  BOOST_CHECK_EQUAL(sequential, Print(0, 3));
+}
+
+BOOST_AUTO_TEST_CASE(Fixed) {
+  std::string sequential(Print(2, 1));
+  // Nothing has more than two digits after the decimal point.
+  for (std::size_t dot = sequential.find('.'); dot != std::string::npos; dot = sequential.find('.', dot + 1)) {
+    std::size_t digits = sequential.find_first_not_of("0123456789", dot + 1) - dot - 1;
+    BOOST_CHECK(digits <= 2);
+  }
+  BOOST_CHECK(sequential.size() < Print(0, 1).size());
+  BOOST_CHECK_EQUAL(sequential, Print(2, 3));
+}
+
+}} // namespaces
@@ -88,6 +88,11 @@ struct Config {
   // Include the vocab in the binary file?  Only effective if write_mmap != NULL.
   bool include_vocab;
 
+  // Also store a front-coded word table so the vocabulary supports Word(index)
+  // lookups.  Implies include_vocab.  Loading from ARPA with this set builds the
+  // table in memory.
+  bool word_table;
+
 
   // Left rest options.  Only used when the model includes rest costs.
   enum RestFunction {
@@ -114,6 +119,9 @@ struct Config {
   // See util/mmap.hh for details of MapMethod.
   util::LoadMethod load_method;
 
+  // Background threads that fault in the model with util::LAZY_PREFETCH.
+  unsigned int prefetch_threads;
+
 
   // Set defaults.
   Config();
@@ -3,8 +3,10 @@
 #include "pipeline.hh"
 #include "tune_instances.hh"
 #include "tune_weights.hh"
+#include "../../util/file.hh"
 #include "../../util/fixed_array.hh"
 #include "../../util/usage.hh"
+#include "../../util/write_compressed.hh"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wpragmas" // Older gcc doesn't have "-Wunused-local-typedefs" and complains.
@@ -49,7 +51,8 @@ int main(int argc, char *argv[]) {
     lm::interpolate::Config pipe_config;
     lm::interpolate::InstancesConfig instances_config;
     std::vector<std::string> input_models;
-    std::string tuning_file;
+    std::string tuning_file, arpa, arpa_compress;
+    std::size_t compress_threads;
 
     namespace po = boost::program_options;
     po::options_description options("Log-linear interpolation options");
@@ -61,7 +64,10 @@ int main(int argc, char *argv[]) {
       ("just_tune", po::bool_switch(), "Tune and print weights then quit")
       ("temp_prefix,T", po::value<std::string>(&pipe_config.sort.temp_prefix)->default_value("/tmp/lm"), "Temporary file prefix")
       ("memory,S", lm::SizeOption(pipe_config.sort.total_memory, util::GuessPhysicalMemory() ? "50%" : "1G"), "Sorting memory: this is a very rough guide")
-      ("sort_block", lm::SizeOption(pipe_config.sort.buffer_size, "64M"), "Block size");
+      ("sort_block", lm::SizeOption(pipe_config.sort.buffer_size, "64M"), "Block size")
+      ("arpa", po::value<std::string>(&arpa), "Write ARPA to a file instead of stdout")
+      ("arpa_compress", po::value<std::string>(&arpa_compress), "Compress the ARPA file with none, gzip, or zstd.  The default is gzip if --arpa ends with .gz, zstd if it ends with .zst, and none otherwise")
+      ("compress_threads", po::value<std::size_t>(&compress_threads)->default_value(1), "Threads that compress the ARPA file");
     po::variables_map vm;
 
     std::vector<const char *> munged_args;
@@ -86,6 +92,7 @@ int main(int argc, char *argv[]) {
       std::cerr << "Provide weights xor a tuning file, not both." << std::endl;
       return 1;
     }
+    util::WriteCompressed::Format compress = vm.count("arpa_compress") ? util::WriteCompressed::ParseFormat(arpa_compress) : util::WriteCompressed::FormatFromName(arpa);
 
     if (!tuning_file.empty()) {
       // Tune weights
@@ -115,7 +122,8 @@ int main(int argc, char *argv[]) {
     for (std::size_t i = 0; i < input_models.size(); ++i) {
       models.push_back(input_models[i]);
     }
-    lm::interpolate::Pipeline(models, pipe_config, 1);
+    util::WriteCompressed out(arpa.empty() ? 1 : util::CreateOrThrow(arpa.c_str()), compress, compress_threads);
+    lm::interpolate::Pipeline(models, pipe_config, out);
   } catch (const std::exception &e) {
     std::cerr << e.what() <<std::endl;
     return 1;
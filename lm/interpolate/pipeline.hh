@@ -8,6 +8,8 @@
 #include <cstddef>
 #include <string>
 
+namespace util { class WriteCompressed; }
+
 namespace lm { namespace interpolate {
 
 struct Config {
@@ -16,7 +18,8 @@ struct Config {
   std::size_t BufferSize() const { return sort.buffer_size; }
 };
 
-void Pipeline(util::FixedArray<ModelBuffer> &models, const Config &config, int write_file);
+// Does not take ownership of out.
+void Pipeline(util::FixedArray<ModelBuffer> &models, const Config &config, util::WriteCompressed &out);
 
 }} // namespaces
 #endif // LM_INTERPOLATE_PIPELINE_H
@@ -2,11 +2,14 @@
 #include "../util/file_stream.hh"
 #include "../util/file.hh"
 #include "../util/file_piece.hh"
+#include "../util/latency_histogram.hh"
+#include "../util/perf_counters.hh"
 #include "../util/usage.hh"
 #include "../util/thread_pool.hh"
 
 #include <boost/range/iterator_range.hpp>
 #include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <iostream>
 
@@ -30,16 +33,67 @@ template <class Model, class Width> void ConvertToBytes(const Model &model, int
   }
 }
 
+// Hardware counters from one thread.
+struct ThreadCounts {
+  uint64_t queries;
+  uint64_t values[util::PerfCounters::EVENT_COUNT];
+  bool available[util::PerfCounters::EVENT_COUNT];
+  // Was any counter available?
+  bool any;
+  std::string error;
+};
+
+// Scoring latency from one thread.
+struct ThreadLatency {
+  util::LatencyHistogram words;
+  util::LatencyHistogram sentences;
+};
+
 template <class Model, class Width> class Worker {
   public:
-    explicit Worker(const Model &model, double &add_total) : model_(model), total_(0.0), add_total_(add_total) {}
+    // If add_counts is not NULL, count hardware events and append them there.
+    // If add_latency is not NULL, time each query and append histograms there.
+    Worker(const Model &model, double &add_total, std::vector<ThreadCounts> *add_counts, std::vector<ThreadLatency> *add_latency)
+      : model_(model), total_(0.0), add_total_(add_total), queries_(0), add_counts_(add_counts), add_latency_(add_latency) {}
 
-    // Destructors happen in the main thread, so there's no race for add_total_.
-    ~Worker() { add_total_ += total_; }
+    // Destructors happen in the main thread, so there's no race for add_total_, add_counts_, or add_latency_.
+    ~Worker() {
+      add_total_ += total_;
+      if (add_latency_ && latency_.words.Count()) add_latency_->push_back(latency_);
+      if (!counters_ || !queries_) return;
+      ThreadCounts counts;
+      counts.queries = queries_;
+      for (unsigned int i = 0; i < util::PerfCounters::EVENT_COUNT; ++i) {
+        util::PerfCounters::Event event = static_cast<util::PerfCounters::Event>(i);
+        counts.values[i] = counters_->Value(event);
+        counts.available[i] = counters_->Available(event);
+      }
+      counts.any = counters_->Any();
+      counts.error = counters_->Error();
+      add_counts_->push_back(counts);
+    }
 
     typedef boost::iterator_range<Width *> Request;
 
     void operator()(Request request) {
+      if (add_counts_) {
+        // Counters belong to the thread that opens them, so open them here rather than in the constructor.
+        if (!counters_) counters_.reset(new util::PerfCounters());
+        counters_->Start();
+      }
+      if (add_latency_) {
+        Timed(request);
+      } else {
+        Fast(request);
+      }
+      if (counters_) {
+        counters_->Stop();
+        queries_ += request.size();
+      }
+    }
+
+  private:
+    void Fast(Request request) {
       const lm::ngram::State *const begin_state = &model_.BeginSentenceState();
       const lm::ngram::State *next_state = begin_state;
       const Width kEOS = model_.GetVocabulary().EndSentence();
@@ -62,11 +116,42 @@ template <class Model, class Width> class Worker {
       total_ += sum;
     }
 
-  private:
+    // Time each query.  A sentence's latency is the sum of its queries, which excludes the clock overhead between them.
+    void Timed(Request request) {
+      const lm::ngram::State *const begin_state = &model_.BeginSentenceState();
+      const lm::ngram::State *next_state = begin_state;
+      const Width kEOS = model_.GetVocabulary().EndSentence();
+      float sum = 0.0;
+      uint64_t sentence = 0;
+      unsigned int out = 0;
+      for (const Width *i = request.begin(); i != request.end(); ++i, out ^= 1) {
+        uint64_t before = util::LatencyClock();
+        sum += model_.FullScore(*next_state, *i, state_[out]).prob;
+        uint64_t took = util::LatencyClock() - before;
+        latency_.words.Add(took);
+        sentence += took;
+        if (*i == kEOS) {
+          latency_.sentences.Add(sentence);
+          sentence = 0;
+          next_state = begin_state;
+        } else {
+          next_state = &state_[out];
+        }
+      }
+      total_ += sum;
+    }
+
     const Model &model_;
     double total_;
     double &add_total_;
 
+    uint64_t queries_;
+    std::vector<ThreadCounts> *add_counts_;
+    boost::shared_ptr<util::PerfCounters> counters_;
+
+    std::vector<ThreadLatency> *add_latency_;
+    ThreadLatency latency_;
+
     lm::ngram::State state_[3];
 };
 
@@ -75,13 +160,70 @@ struct Config {
   std::size_t threads;
   std::size_t buf_per_thread;
   bool query;
+  bool counters;
+  bool latency;
 };
 
+void PrintCounts(util::FileStream &out, const char *name, const ThreadCounts &counts) {
+  out << name << " queries: " << counts.queries;
+  for (unsigned int i = 0; i < util::PerfCounters::EVENT_COUNT; ++i) {
+    out << ' ' << util::PerfCounters::Name(static_cast<util::PerfCounters::Event>(i)) << "/query: ";
+    if (counts.available[i]) {
+      out << (static_cast<double>(counts.values[i]) / static_cast<double>(counts.queries));
+    } else {
+      out << "unavailable";
+    }
+  }
+  out << '\n';
+}
+
+// Per-thread and aggregate hardware counters.
+void PrintCounters(util::FileStream &out, const std::vector<ThreadCounts> &threads) {
+  if (threads.empty()) return;
+  ThreadCounts sum = threads.front();
+  for (std::vector<ThreadCounts>::const_iterator i = threads.begin() + 1; i != threads.end(); ++i) {
+    sum.any = sum.any || i->any;
+    sum.queries += i->queries;
+    for (unsigned int e = 0; e < util::PerfCounters::EVENT_COUNT; ++e) {
+      sum.values[e] += i->values[e];
+      sum.available[e] = sum.available[e] && i->available[e];
+    }
+  }
+  // A table of "unavailable" says nothing, e.g. in a VM without a PMU.
+  if (!sum.any) {
+    out << "No hardware counters are available: " << sum.error << '\n';
+    return;
+  }
+  if (!sum.error.empty()) out << "Some hardware counters are unavailable: " << sum.error << '\n';
+  for (std::size_t i = 0; i < threads.size(); ++i) {
+    std::string name("Thread " + std::to_string(i));
+    PrintCounts(out, name.c_str(), threads[i]);
+  }
+  PrintCounts(out, "All threads", sum);
+}
+
+// Per-thread and aggregate latency percentiles.
+void PrintLatency(util::FileStream &out, const std::vector<ThreadLatency> &threads) {
+  ThreadLatency sum;
+  for (std::size_t i = 0; i < threads.size(); ++i) {
+    std::string name("Thread " + std::to_string(i));
+    threads[i].words.Print((name + " word latency").c_str(), out);
+    threads[i].sentences.Print((name + " sentence latency").c_str(), out);
+    sum.words.Merge(threads[i].words);
+    sum.sentences.Merge(threads[i].sentences);
+  }
+  if (threads.empty()) return;
+  sum.words.Print("All threads word latency", out);
+  sum.sentences.Print("All threads sentence latency", out);
+}
+
 template <class Model, class Width> void QueryFromBytes(const Model &model, const Config &config) {
   util::FileStream out(1);
   out << "Threads: " << config.threads << '\n';
   const Width kEOS = model.GetVocabulary().EndSentence();
   double total = 0.0;
+  std::vector<ThreadCounts> counts;
+  std::vector<ThreadLatency> latency;
   // Number of items to have in queue in addition to everything in flight.
   const std::size_t kInQueue = 3;
   std::size_t total_queue = config.threads + kInQueue;
@@ -90,7 +232,7 @@ template <class Model, class Width> void QueryFromBytes(const Model &model, cons
   double loaded_wall;
   uint64_t queries = 0;
   {
-    util::RecyclingThreadPool<Worker<Model, Width> > pool(total_queue, config.threads, Worker<Model, Width>(model, total), boost::iterator_range<Width *>((Width*)0, (Width*)0));
+    util::RecyclingThreadPool<Worker<Model, Width> > pool(total_queue, config.threads, Worker<Model, Width>(model, total, config.counters ? &counts : NULL, config.latency ? &latency : NULL), boost::iterator_range<Width *>((Width*)0, (Width*)0));
 
     for (std::size_t i = 0; i < total_queue; ++i) {
       pool.PopulateRecycling(boost::iterator_range<Width *>(&backing[i * config.buf_per_thread], &backing[i * config.buf_per_thread]));
@@ -129,6 +271,8 @@ template <class Model, class Width> void QueryFromBytes(const Model &model, cons
   out << "Seconds per query excluding load, CPU: " << cpu_per_entry << " Wall: " << wall_per_entry << '\n';
   out << "Queries per second excluding load, CPU: " << (1.0/cpu_per_entry) << " Wall: " << (1.0/wall_per_entry) << '\n';
   out << "RSSMax: " << util::RSSMax() << '\n';
+  PrintCounters(out, counts);
+  PrintLatency(out, latency);
 }
 
 template <class Model, class Width> void DispatchFunction(const Model &model, const Config &config) {
@@ -201,7 +345,9 @@ int main(int argc, char *argv[]) {
       ("threads,t", po::value<std::size_t>(&config.threads)->default_value(boost::thread::hardware_concurrency()), "Threads to use (querying only; TODO vocab conversion)")
       ("buffer,b", po::value<std::size_t>(&config.buf_per_thread)->default_value(4096), "Number of words to buffer per task.")
       ("vocab,v", po::bool_switch(), "Convert strings to vocab ids")
-      ("query,q", po::bool_switch(), "Query from vocab ids");
+      ("query,q", po::bool_switch(), "Query from vocab ids")
+      ("counters,c", po::bool_switch(&config.counters), "With -q, report hardware counters per query for each thread using perf_event_open")
+      ("latency,l", po::bool_switch(&config.latency), "With -q, time every query and report word and sentence latency percentiles for each thread.  Timing adds clock overhead to throughput");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, options), vm);
     if (argc == 1 || vm["help"].as<bool>()) {
@@ -0,0 +1,208 @@
+#include "model.hh"
+#include "../util/file.hh"
+#include "../util/file_piece.hh"
+#include "../util/file_stream.hh"
+#include "../util/prefetch.hh"
+#include "../util/usage.hh"
+
+#include <boost/program_options.hpp>
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace {
+
+using namespace lm::ngram;
+
+const char *kTypeNames[] = {"probing", "rest_probing", "trie", "quant_trie", "array_trie", "quant_array_trie"};
+
+struct Options {
+  std::string arpa;
+  std::string binary;
+  util::LoadMethod load_method;
+  unsigned int passes;
+  bool keep;
+};
+
+// Words of the corpus in order with an empty string at the end of each sentence.
+void ReadCorpus(const char *file, std::vector<std::string> &words) {
+  util::FilePiece in(file);
+  StringPiece word;
+  while (true) {
+    while (in.ReadWordSameLine(word)) {
+      words.push_back(std::string(word.data(), word.size()));
+    }
+    if (!in.ReadLineOrEOF(word)) break;
+    words.push_back(std::string());
+  }
+}
+
+template <class Model> void Run(ModelType type, const Options &options, const std::vector<std::string> &corpus, util::FileStream &out) {
+  // Build a binary as build_binary would, including its choice of write method.
+  Config build_config;
+  build_config.write_mmap = options.binary.c_str();
+  build_config.write_method = (type == PROBING || type == REST_PROBING) ? Config::WRITE_AFTER : Config::WRITE_MMAP;
+  build_config.messages = NULL;
+  build_config.arpa_complain = Config::NONE;
+  double build_wall = util::WallTime();
+  {
+    Model model(options.arpa.c_str(), build_config);
+  }
+  build_wall = util::WallTime() - build_wall;
+  uint64_t binary_bytes;
+  {
+    util::scoped_fd binary(util::OpenReadOrThrow(options.binary.c_str()));
+    binary_bytes = util::SizeFile(binary.get());
+  }
+
+  Config load_config;
+  load_config.load_method = options.load_method;
+  double load_wall = util::WallTime();
+  Model model(options.binary.c_str(), load_config);
+  load_wall = util::WallTime() - load_wall;
+  // Time for background prefetching to finish after the constructor returned.
+  double prefetch_wall = 0.0;
+  if (model.Prefetching()) {
+    prefetch_wall = util::WallTime();
+    model.Prefetching()->Wait();
+    prefetch_wall = util::WallTime() - prefetch_wall;
+  }
+
+  // Vocabulary lookup is not timed.
+  const lm::WordIndex kEOS = model.GetVocabulary().EndSentence();
+  std::vector<lm::WordIndex> ids;
+  ids.reserve(corpus.size());
+  for (std::vector<std::string>::const_iterator i = corpus.begin(); i != corpus.end(); ++i) {
+    ids.push_back(i->empty() ? kEOS : model.GetVocabulary().Index(*i));
+  }
+
+  double total = 0.0;
+  double query_wall = util::WallTime();
+  typename Model::State state[2];
+  for (unsigned int pass = 0; pass < options.passes; ++pass) {
+    const typename Model::State *in = &model.BeginSentenceState();
+    unsigned int next = 0;
+    for (std::vector<lm::WordIndex>::const_iterator i = ids.begin(); i != ids.end(); ++i, next ^= 1) {
+      total += model.FullScore(*in, *i, state[next]).prob;
+      in = (*i == kEOS) ? &model.BeginSentenceState() : &state[next];
+    }
+  }
+  query_wall = util::WallTime() - query_wall;
+  uint64_t queries = static_cast<uint64_t>(ids.size()) * options.passes;
+
+  out << "{\"type\": \"" << kTypeNames[type] << "\""
+    << ", \"order\": " << static_cast<unsigned int>(model.Order())
+    << ", \"build_seconds\": " << build_wall
+    << ", \"binary_bytes\": " << binary_bytes
+    << ", \"load_seconds\": " << load_wall
+    << ", \"prefetch_seconds\": " << prefetch_wall
+    << ", \"queries\": " << queries
+    << ", \"query_seconds\": " << query_wall
+    << ", \"ns_per_query\": " << (query_wall * 1e9 / static_cast<double>(queries))
+    << ", \"probability_sum\": " << total
+    << "}\n";
+  out.flush();
+  if (!options.keep) {
+    UTIL_THROW_IF(std::remove(options.binary.c_str()), util::ErrnoException, "Could not delete " << options.binary);
+  }
+}
+
+void Dispatch(ModelType type, const Options &options, const std::vector<std::string> &corpus, util::FileStream &out) {
+  switch (type) {
+    case PROBING:
+      Run<ProbingModel>(type, options, corpus, out);
+      break;
+    case REST_PROBING:
+      Run<RestProbingModel>(type, options, corpus, out);
+      break;
+    case TRIE:
+      Run<TrieModel>(type, options, corpus, out);
+      break;
+    case QUANT_TRIE:
+      Run<QuantTrieModel>(type, options, corpus, out);
+      break;
+    case ARRAY_TRIE:
+      Run<ArrayTrieModel>(type, options, corpus, out);
+      break;
+    case QUANT_ARRAY_TRIE:
+      Run<QuantArrayTrieModel>(type, options, corpus, out);
+      break;
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    Options options;
+    std::string corpus_file, load;
+    std::vector<std::string> types;
+    namespace po = boost::program_options;
+    po::options_description description("Model benchmark options");
+    description.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("arpa,a", po::value<std::string>(&options.arpa)->required(), "ARPA model, for example from kenlm_synth")
+      ("corpus,c", po::value<std::string>(&corpus_file)->required(), "Text to score, one sentence per line")
+      ("types,T", po::value<std::vector<std::string> >(&types)->multitoken(), "Model types to run.  Default: all")
+      ("binary,b", po::value<std::string>(&options.binary)->default_value("kenlm_model_benchmark.binary"), "Where to write each binary")
+      ("load,l", po::value<std::string>(&load)->default_value("read"), "How to load binaries: lazy, populate, read, prefetch, or shared")
+      ("passes,p", po::value<unsigned int>(&options.passes)->default_value(1), "Times to score the corpus")
+      ("keep,k", po::bool_switch(&options.keep), "Keep the last binary instead of deleting it");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, description), vm);
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr << "Time building, loading, and querying every model type.  Prints one JSON object per type.\n"
+        << argv[0] << " -a model.arpa -c corpus.txt\n"
+        << description << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+    if (load == "lazy") {
+      options.load_method = util::LAZY;
+    } else if (load == "populate") {
+      options.load_method = util::POPULATE_OR_READ;
+    } else if (load == "read") {
+      options.load_method = util::READ;
+    } else if (load == "prefetch") {
+      options.load_method = util::LAZY_PREFETCH;
+    } else if (load == "shared") {
+      options.load_method = util::SHARED;
+    } else {
+      std::cerr << "Unknown load method " << load << std::endl;
+      return 1;
+    }
+    const std::size_t kTypes = sizeof(kTypeNames) / sizeof(const char*);
+    std::vector<ModelType> run;
+    if (types.empty()) {
+      for (std::size_t i = 0; i < kTypes; ++i) run.push_back(static_cast<ModelType>(i));
+    }
+    for (std::vector<std::string>::const_iterator i = types.begin(); i != types.end(); ++i) {
+      std::size_t t;
+      for (t = 0; t < kTypes && *i != kTypeNames[t]; ++t) {}
+      if (t == kTypes) {
+        std::cerr << "Unknown model type " << *i << std::endl;
+        return 1;
+      }
+      run.push_back(static_cast<ModelType>(t));
+    }
+    if (!options.passes) {
+      std::cerr << "Specify a positive number of passes." << std::endl;
+      return 1;
+    }
+
+    std::vector<std::string> corpus;
+    ReadCorpus(corpus_file.c_str(), corpus);
+    util::FileStream out(1);
+    for (std::vector<ModelType>::const_iterator i = run.begin(); i != run.end(); ++i) {
+      Dispatch(*i, options, corpus, out);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
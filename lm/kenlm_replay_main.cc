@@ -0,0 +1,195 @@
+#include "model.hh"
+#include "trace.hh"
+#include "../util/file.hh"
+#include "../util/file_stream.hh"
+#include "../util/latency_histogram.hh"
+#include "../util/usage.hh"
+
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace {
+
+struct Config {
+  std::size_t threads;
+  unsigned int passes;
+  bool latency;
+};
+
+template <class Model> struct Prepared {
+  typename Model::State state;
+  lm::WordIndex word;
+};
+
+struct ThreadResult {
+  ThreadResult() : total(0.0) {}
+  double total;
+  util::LatencyHistogram latency;
+};
+
+template <class Model> class Replayer {
+  public:
+    Replayer(const Model &model, const std::vector<Prepared<Model> > &queries, std::size_t begin, std::size_t end, const Config &config, ThreadResult &result)
+      : model_(model), queries_(queries), begin_(begin), end_(end), config_(config), result_(result) {}
+
+    void operator()() {
+      typename Model::State out;
+      double total = 0.0;
+      for (unsigned int pass = 0; pass < config_.passes; ++pass) {
+        if (config_.latency) {
+          for (std::size_t i = begin_; i < end_; ++i) {
+            uint64_t before = util::LatencyClock();
+            total += model_.FullScore(queries_[i].state, queries_[i].word, out).prob;
+            result_.latency.Add(util::LatencyClock() - before);
+          }
+        } else {
+          for (std::size_t i = begin_; i < end_; ++i) {
+            total += model_.FullScore(queries_[i].state, queries_[i].word, out).prob;
+          }
+        }
+      }
+      result_.total = total;
+    }
+
+  private:
+    const Model &model_;
+    const std::vector<Prepared<Model> > &queries_;
+    const std::size_t begin_, end_;
+    const Config &config_;
+    ThreadResult &result_;
+};
+
+template <class Model> void Replay(const char *file, const lm::ngram::Trace &trace, const Config &config) {
+  util::FileStream out(1);
+  lm::ngram::Config model_config;
+  model_config.load_method = util::READ;
+  Model model(file, model_config);
+
+  // Rebuild each query's state in this model so that replay times only FullScore.
+  std::vector<lm::WordIndex> ids;
+  trace.MapWords(model.GetVocabulary(), ids);
+  std::vector<Prepared<Model> > queries(trace.Queries().size());
+  lm::WordIndex context[KENLM_MAX_ORDER];
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    const lm::ngram::TraceQuery &query = trace.Queries()[i];
+    for (unsigned char j = 0; j < query.length; ++j) {
+      context[j] = ids[query.context[j]];
+    }
+    model.GetState(context, context + query.length, queries[i].state);
+    queries[i].word = ids[query.word];
+  }
+
+  std::vector<ThreadResult> results(config.threads);
+  double before_cpu = util::CPUTime();
+  double before_wall = util::WallTime();
+  {
+    boost::thread_group threads;
+    for (std::size_t t = 0; t < config.threads; ++t) {
+      std::size_t begin = queries.size() * t / config.threads, end = queries.size() * (t + 1) / config.threads;
+      threads.create_thread(Replayer<Model>(model, queries, begin, end, config, results[t]));
+    }
+    threads.join_all();
+  }
+  double after_cpu = util::CPUTime();
+  double after_wall = util::WallTime();
+
+  double total = 0.0;
+  util::LatencyHistogram latency;
+  for (std::size_t t = 0; t < results.size(); ++t) {
+    total += results[t].total;
+    latency.Merge(results[t].latency);
+  }
+  util::FileStream(2, 70) << "Probability sum: " << total << '\n';
+  uint64_t count = static_cast<uint64_t>(queries.size()) * config.passes;
+  out << "Threads: " << config.threads << '\n';
+  out << "Queries: " << count << '\n';
+  out << "Replay, CPU: " << (after_cpu - before_cpu) << " Wall: " << (after_wall - before_wall) << '\n';
+  double wall_per_query = (after_wall - before_wall) / static_cast<double>(count);
+  out << "Seconds per query, Wall: " << wall_per_query << '\n';
+  out << "Queries per second, Wall: " << (1.0 / wall_per_query) << '\n';
+  out << "RSSMax: " << util::RSSMax() << '\n';
+  if (config.latency) {
+    for (std::size_t t = 0; t < results.size(); ++t) {
+      std::string name("Thread " + std::to_string(t) + " query latency");
+      results[t].latency.Print(name.c_str(), out);
+    }
+    latency.Print("All threads query latency", out);
+  }
+}
+
+void Dispatch(const char *file, const lm::ngram::Trace &trace, const Config &config) {
+  using namespace lm::ngram;
+  ModelType model_type;
+  if (!RecognizeBinary(file, model_type)) {
+    Replay<ProbingModel>(file, trace, config);
+    return;
+  }
+  switch(model_type) {
+    case PROBING:
+      Replay<ProbingModel>(file, trace, config);
+      break;
+    case REST_PROBING:
+      Replay<RestProbingModel>(file, trace, config);
+      break;
+    case TRIE:
+      Replay<TrieModel>(file, trace, config);
+      break;
+    case QUANT_TRIE:
+      Replay<QuantTrieModel>(file, trace, config);
+      break;
+    case ARRAY_TRIE:
+      Replay<ArrayTrieModel>(file, trace, config);
+      break;
+    case QUANT_ARRAY_TRIE:
+      Replay<QuantArrayTrieModel>(file, trace, config);
+      break;
+    default:
+      UTIL_THROW(util::Exception, "Unrecognized kenlm model type " << model_type);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    Config config;
+    std::string model, trace_file;
+    namespace po = boost::program_options;
+    po::options_description options("Replay options");
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("model,m", po::value<std::string>(&model)->required(), "Model to query.  It need not be the model the trace was recorded with")
+      ("trace,i", po::value<std::string>(&trace_file)->default_value("-"), "Trace to replay, - for stdin")
+      ("threads,t", po::value<std::size_t>(&config.threads)->default_value(1), "Threads.  Each replays a contiguous part of the trace")
+      ("passes,p", po::value<unsigned int>(&config.passes)->default_value(1), "Number of times to replay the trace")
+      ("latency,l", po::bool_switch(&config.latency), "Time every query and report latency percentiles for each thread");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr << "Replay a query trace against a model.  Record traces with query -T or lm::ngram::TracingModel.\n"
+        << argv[0] << " -m $model -i $trace\n"
+        << options << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+    if (!config.threads || !config.passes) {
+      std::cerr << "Threads and passes must be positive." << std::endl;
+      return 1;
+    }
+    util::scoped_fd trace_fd(trace_file == "-" ? 0 : util::OpenReadOrThrow(trace_file.c_str()));
+    lm::ngram::Trace trace(trace_fd.get());
+    if (trace_file == "-") trace_fd.release();
+    std::cerr << "Trace has " << trace.Queries().size() << " queries of " << trace.Words().size() << " distinct words." << std::endl;
+    Dispatch(model.c_str(), trace, config);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+#include "synthetic.hh"
+#include "../util/file.hh"
+
+#include <boost/program_options.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  try {
+    lm::SyntheticConfig config;
+    std::string text, arpa;
+    unsigned int order;
+    namespace po = boost::program_options;
+    po::options_description options("Synthetic corpus and model options");
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("text,T", po::value<std::string>(&text), "Write the corpus here, one sentence per line")
+      ("arpa,a", po::value<std::string>(&arpa), "Write an ARPA model estimated from the corpus here")
+      ("vocab,V", po::value<uint64_t>(&config.vocab)->default_value(config.vocab), "Vocabulary size excluding <s>, </s>, and <unk>")
+      ("sentences,s", po::value<uint64_t>(&config.sentences)->default_value(config.sentences), "Number of sentences")
+      ("length,l", po::value<unsigned int>(&config.mean_length)->default_value(config.mean_length), "Mean sentence length")
+      ("zipf,z", po::value<double>(&config.zipf)->default_value(config.zipf), "Zipf exponent")
+      ("mix,x", po::value<double>(&config.mix)->default_value(config.mix), "Probability that a word depends on the previous word")
+      ("seed,S", po::value<uint64_t>(&config.seed)->default_value(config.seed), "Random seed")
+      ("order,o", po::value<unsigned int>(&order)->default_value(config.order), "Order of the ARPA model")
+      ("counts,c", po::value<std::vector<uint64_t> >(&config.counts)->multitoken(), "Maximum number of n-grams to keep for each order, starting with unigrams.  0 keeps all");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr << "Generate a reproducible Zipf-distributed corpus and an ARPA model of it.\n"
+        << argv[0] << " -T corpus.txt -a model.arpa -o 5 -V 100000 -s 1000000 -c 0 1000000 2000000 2000000 2000000\n"
+        << options << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+    if (text.empty() && arpa.empty()) {
+      std::cerr << "Specify at least one of --text or --arpa." << std::endl;
+      return 1;
+    }
+    config.order = static_cast<unsigned char>(order);
+    lm::SyntheticCorpus corpus(config);
+    if (!text.empty()) {
+      util::scoped_fd out(util::CreateOrThrow(text.c_str()));
+      corpus.WriteText(out.get());
+    }
+    if (!arpa.empty()) {
+      util::scoped_fd out(util::CreateOrThrow(arpa.c_str()));
+      corpus.WriteARPA(config, out.get());
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
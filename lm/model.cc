@@ -5,6 +5,7 @@
 #include "search_hashed.hh"
 #include "search_trie.hh"
 #include "read_arpa.hh"
+#include "../util/file_piece.hh"
 #include "../util/have.hh"
 #include "../util/murmur_hash.hh"
 
@@ -18,13 +19,13 @@ namespace lm {
 namespace ngram {
 namespace detail {
 
-template <class Search, class VocabularyT> const ModelType GenericModel<Search, VocabularyT>::kModelType = Search::kModelType;
+template <class Search, class VocabularyT, unsigned char FixedOrder> const ModelType GenericModel<Search, VocabularyT, FixedOrder>::kModelType = Search::kModelType;
 
-template <class Search, class VocabularyT> uint64_t GenericModel<Search, VocabularyT>::Size(const std::vector<uint64_t> &counts, const Config &config) {
+template <class Search, class VocabularyT, unsigned char FixedOrder> uint64_t GenericModel<Search, VocabularyT, FixedOrder>::Size(const std::vector<uint64_t> &counts, const Config &config) {
   return VocabularyT::Size(counts[0], config) + Search::Size(counts, config);
 }
 
-template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::SetupMemory(void *base, const std::vector<uint64_t> &counts, const Config &config) {
+template <class Search, class VocabularyT, unsigned char FixedOrder> void GenericModel<Search, VocabularyT, FixedOrder>::SetupMemory(void *base, const std::vector<uint64_t> &counts, const Config &config) {
   size_t goal_size = util::CheckOverflow(Size(counts, config));
   uint8_t *start = static_cast<uint8_t*>(base);
   size_t allocated = VocabularyT::Size(counts[0], config);
@@ -45,8 +46,9 @@ void ComplainAboutARPA(const Config &config, ModelType model_type) {
   }
 }
 
-void CheckCounts(const std::vector<uint64_t> &counts) {
+void CheckCounts(const std::vector<uint64_t> &counts, unsigned char fixed_order) {
   UTIL_THROW_IF(counts.size() > KENLM_MAX_ORDER, FormatLoadException, "This model has order " << counts.size() << " but KenLM was compiled to support up to " << KENLM_MAX_ORDER << ".  " << KENLM_ORDER_MESSAGE);
+  UTIL_THROW_IF(fixed_order && counts.size() != fixed_order, FormatLoadException, "This model has order " << counts.size() << " but the code loading it was specialized for order " << static_cast<unsigned int>(fixed_order) << ".");
   if (sizeof(uint64_t) > sizeof(std::size_t)) {
     for (std::vector<uint64_t>::const_iterator i = counts.begin(); i != counts.end(); ++i) {
       UTIL_THROW_IF(*i > static_cast<uint64_t>(std::numeric_limits<size_t>::max()), util::OverflowException, "This model has " << *i << " " << (i - counts.begin() + 1) << "-grams which is too many for 32-bit machines.");
@@ -56,13 +58,13 @@ void CheckCounts(const std::vector<uint64_t> &counts) {
 
 } // namespace
 
-template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::GenericModel(const char *file, const Config &init_config) : backing_(init_config) {
+template <class Search, class VocabularyT, unsigned char FixedOrder> GenericModel<Search, VocabularyT, FixedOrder>::GenericModel(const char *file, const Config &init_config) : backing_(init_config) {
   util::scoped_fd fd(util::OpenReadOrThrow(file));
   if (IsBinaryFormat(fd.get())) {
     Parameters parameters;
     int fd_shallow = fd.release();
     backing_.InitializeBinary(fd_shallow, kModelType, kVersion, parameters);
-    CheckCounts(parameters.counts);
+    CheckCounts(parameters.counts, FixedOrder);
 
     Config new_config(init_config);
     new_config.probing_multiplier = parameters.fixed.probing_multiplier;
@@ -71,6 +73,13 @@ template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::Ge
 
     SetupMemory(backing_.LoadBinary(Size(parameters.counts, new_config)), parameters.counts, new_config);
     vocab_.LoadedBinary(parameters.fixed.has_vocabulary, fd_shallow, new_config.enumerate_vocab, backing_.VocabStringReadingOffset());
+    if (parameters.fixed.has_word_table) {
+      backing_.LoadWordTable();
+      InitWords();
+    }
+    std::vector<uint64_t> order_ends;
+    Search::OrderEnds(parameters.counts, new_config, order_ends);
+    backing_.StartPrefetch(VocabularyT::Size(parameters.counts[0], new_config), order_ends, new_config.ProgressMessages());
   } else {
     ComplainAboutARPA(init_config, kModelType);
     InitializeFromARPA(fd.release(), file, init_config);
@@ -89,14 +98,14 @@ template <class Search, class VocabularyT> GenericModel<Search, VocabularyT>::Ge
   P::Init(begin_sentence, null_context, vocab_, search_.Order());
 }
 
-template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::InitializeFromARPA(int fd, const char *file, const Config &config) {
+template <class Search, class VocabularyT, unsigned char FixedOrder> void GenericModel<Search, VocabularyT, FixedOrder>::InitializeFromARPA(int fd, const char *file, const Config &config) {
   // Backing file is the ARPA.
   util::FilePiece f(fd, file, config.ProgressMessages());
   try {
     std::vector<uint64_t> counts;
     // File counts do not include pruned trigrams that extend to quadgrams etc.   These will be fixed by search_.
     ReadARPACounts(f, counts);
-    CheckCounts(counts);
+    CheckCounts(counts, FixedOrder);
     if (counts.size() < 2) UTIL_THROW(FormatLoadException, "This ngram implementation assumes at least a bigram model.");
     if (config.probing_multiplier <= 1.0) UTIL_THROW(ConfigException, "probing multiplier must be > 1.0");
 
@@ -104,7 +113,7 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
     // Setup the binary file for writing the vocab lookup table.  The search_ is responsible for growing the binary file to its needs.
     vocab_.SetupMemory(backing_.SetupJustVocab(vocab_size, counts.size()), vocab_size, counts[0], config);
 
-    if (config.write_mmap && config.include_vocab) {
+    if ((config.write_mmap && config.include_vocab) || config.word_table) {
       WriteWordsWrapper wrap(config.enumerate_vocab);
       vocab_.ConfigureEnumerate(&wrap, counts[0]);
       search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
@@ -113,6 +122,7 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
       // Due to writing at the end of file, mmap may have relocated data.  So remap.
       vocab_.Relocate(vocab_rebase);
       search_.SetupMemory(reinterpret_cast<uint8_t*>(search_rebase), counts, config);
+      if (config.word_table) InitWords();
     } else {
       vocab_.ConfigureEnumerate(config.enumerate_vocab, counts[0]);
       search_.InitializeFromARPA(file, f, counts, config, vocab_, backing_);
@@ -131,7 +141,13 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
   }
 }
 
-template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search, VocabularyT>::FullScore(const State &in_state, const WordIndex new_word, State &out_state) const {
+template <class Search, class VocabularyT, unsigned char FixedOrder> void GenericModel<Search, VocabularyT, FixedOrder>::InitWords() {
+  const util::scoped_memory &table = backing_.WordTableMemory();
+  vocab_.InitWords(table.get(), table.size());
+  UTIL_THROW_IF(vocab_.Words().Size() != vocab_.Bound(), FormatLoadException, "The word table has " << vocab_.Words().Size() << " words but the vocabulary has " << vocab_.Bound());
+}
+
+template <class Search, class VocabularyT, unsigned char FixedOrder> FullScoreReturn GenericModel<Search, VocabularyT, FixedOrder>::FullScore(const State &in_state, const WordIndex new_word, State &out_state) const {
   FullScoreReturn ret = ScoreExceptBackoff(in_state.words, in_state.words + in_state.length, new_word, out_state);
   for (const float *i = in_state.backoff + ret.ngram_length - 1; i < in_state.backoff + in_state.length; ++i) {
     ret.prob += *i;
@@ -139,8 +155,8 @@ template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search,
   return ret;
 }
 
-template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search, VocabularyT>::FullScoreForgotState(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word, State &out_state) const {
-  context_rend = std::min(context_rend, context_rbegin + P::Order() - 1);
+template <class Search, class VocabularyT, unsigned char FixedOrder> FullScoreReturn GenericModel<Search, VocabularyT, FixedOrder>::FullScoreForgotState(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word, State &out_state) const {
+  context_rend = std::min(context_rend, context_rbegin + ModelOrder() - 1);
   FullScoreReturn ret = ScoreExceptBackoff(context_rbegin, context_rend, new_word, out_state);
 
   // Add the backoff weights for n-grams of order start to (context_rend - context_rbegin).
@@ -166,9 +182,9 @@ template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search,
   return ret;
 }
 
-template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::GetState(const WordIndex *context_rbegin, const WordIndex *context_rend, State &out_state) const {
+template <class Search, class VocabularyT, unsigned char FixedOrder> void GenericModel<Search, VocabularyT, FixedOrder>::GetState(const WordIndex *context_rbegin, const WordIndex *context_rend, State &out_state) const {
   // Generate a state from context.
-  context_rend = std::min(context_rend, context_rbegin + P::Order() - 1);
+  context_rend = std::min(context_rend, context_rbegin + ModelOrder() - 1);
   if (context_rend == context_rbegin) {
     out_state.length = 0;
     return;
@@ -192,7 +208,7 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
   std::copy(context_rbegin, context_rbegin + out_state.length, out_state.words);
 }
 
-template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search, VocabularyT>::ExtendLeft(
+template <class Search, class VocabularyT, unsigned char FixedOrder> FullScoreReturn GenericModel<Search, VocabularyT, FixedOrder>::ExtendLeft(
     const WordIndex *add_rbegin, const WordIndex *add_rend,
     const float *backoff_in,
     uint64_t extend_pointer,
@@ -230,7 +246,7 @@ namespace {
 // Do a paraonoid copy of history, assuming new_word has already been copied
 // (hence the -1).  out_state.length could be zero so I avoided using
 // std::copy.
-void CopyRemainingHistory(const WordIndex *from, State &out_state) {
+template <class StateT> void CopyRemainingHistory(const WordIndex *from, StateT &out_state) {
   WordIndex *out = out_state.words + 1;
   const WordIndex *in_end = from + static_cast<ptrdiff_t>(out_state.length) - 1;
   for (const WordIndex *in = from; in < in_end; ++in, ++out) *out = *in;
@@ -242,7 +258,7 @@ void CopyRemainingHistory(const WordIndex *from, State &out_state) {
  * Context goes backward, so context_begin is the word immediately preceeding
  * new_word.
  */
-template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search, VocabularyT>::ScoreExceptBackoff(
+template <class Search, class VocabularyT, unsigned char FixedOrder> FullScoreReturn GenericModel<Search, VocabularyT, FixedOrder>::ScoreExceptBackoff(
     const WordIndex *const context_rbegin,
     const WordIndex *const context_rend,
     const WordIndex new_word,
@@ -269,11 +285,11 @@ template <class Search, class VocabularyT> FullScoreReturn GenericModel<Search,
   return ret;
 }
 
-template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT>::ResumeScore(const WordIndex *hist_iter, const WordIndex *const context_rend, unsigned char order_minus_2, typename Search::Node &node, float *backoff_out, unsigned char &next_use, FullScoreReturn &ret) const {
+template <class Search, class VocabularyT, unsigned char FixedOrder> void GenericModel<Search, VocabularyT, FixedOrder>::ResumeScore(const WordIndex *hist_iter, const WordIndex *const context_rend, unsigned char order_minus_2, typename Search::Node &node, float *backoff_out, unsigned char &next_use, FullScoreReturn &ret) const {
   for (; ; ++order_minus_2, ++hist_iter, ++backoff_out) {
     if (hist_iter == context_rend) return;
     if (ret.independent_left) return;
-    if (order_minus_2 == P::Order() - 2) break;
+    if (order_minus_2 == ModelOrder() - 2) break;
 
     typename Search::MiddlePointer pointer(search_.LookupMiddle(order_minus_2, *hist_iter, node, ret.independent_left, ret.extend_left));
     if (!pointer.Found()) return;
@@ -291,11 +307,11 @@ template <class Search, class VocabularyT> void GenericModel<Search, VocabularyT
     ret.prob = longest.Prob();
     ret.rest = ret.prob;
     // There is no blank in longest_.
-    ret.ngram_length = P::Order();
+    ret.ngram_length = ModelOrder();
   }
 }
 
-template <class Search, class VocabularyT> float GenericModel<Search, VocabularyT>::InternalUnRest(const uint64_t *pointers_begin, const uint64_t *pointers_end, unsigned char first_length) const {
+template <class Search, class VocabularyT, unsigned char FixedOrder> float GenericModel<Search, VocabularyT, FixedOrder>::InternalUnRest(const uint64_t *pointers_begin, const uint64_t *pointers_end, unsigned char first_length) const {
   float ret;
   typename Search::Node node;
   if (first_length == 1) {
@@ -325,6 +341,29 @@ template class GenericModel<trie::TrieSearch<SeparatelyQuantize, trie::ArrayBhik
 
 } // namespace detail
 
+namespace {
+
+// Each instantiation is a full copy of the model code, so only the default
+// probing and trie types are specialized.  Others return NULL.
+template <unsigned char Order> base::Model *LoadFixedOrder(unsigned char order, const char *file_name, const Config &config, ModelType model_type) {
+  if (order != Order) return LoadFixedOrder<Order - 1>(order, file_name, config, model_type);
+  switch (model_type) {
+    case PROBING:
+      return new detail::GenericModel<detail::HashedSearch<BackoffValue>, ProbingVocabulary, Order>(file_name, config);
+    case TRIE:
+      return new detail::GenericModel<trie::TrieSearch<DontQuantize, trie::DontBhiksha>, SortedVocabulary, Order>(file_name, config);
+    default:
+      return NULL;
+  }
+}
+
+// Models need at least bigrams.
+template <> base::Model *LoadFixedOrder<1>(unsigned char, const char *, const Config &, ModelType) {
+  return NULL;
+}
+
+} // namespace
+
 base::Model *LoadVirtual(const char *file_name, const Config &config, ModelType model_type) {
   RecognizeBinary(file_name, model_type);
   switch (model_type) {
@@ -345,5 +384,17 @@ base::Model *LoadVirtual(const char *file_name, const Config &config, ModelType
   }
 }
 
+base::Model *LoadVirtualSpecialized(const char *file_name, const Config &config, ModelType model_type) {
+  unsigned char order;
+  if (!RecognizeBinary(file_name, model_type, order)) {
+    util::FilePiece f(file_name);
+    std::vector<uint64_t> counts;
+    ReadARPACounts(f, counts);
+    order = counts.size();
+  }
+  base::Model *ret = LoadFixedOrder<KENLM_MAX_ORDER>(order, file_name, config, model_type);
+  return ret ? ret : LoadVirtual(file_name, config, model_type);
+}
+
 } // namespace ngram
 } // namespace lm
@@ -25,12 +25,28 @@ namespace lm {
 namespace ngram {
 namespace detail {
 
+// State type for models of a fixed order.  0 means any order up to KENLM_MAX_ORDER.
+template <unsigned char FixedOrder> struct FixedOrderState {
+  typedef OrderState<FixedOrder> T;
+  typedef CompactOrderState<FixedOrder> Compact;
+};
+template <> struct FixedOrderState<0> {
+  typedef State T;
+  typedef CompactState Compact;
+};
+
 // Should return the same results as SRI.
 // ModelFacade typedefs Vocabulary so we use VocabularyT to avoid naming conflicts.
-template <class Search, class VocabularyT> class GenericModel : public base::ModelFacade<GenericModel<Search, VocabularyT>, State, VocabularyT> {
+// If FixedOrder is not 0, the model must have exactly that order.  The state
+// is then sized for it and loops over orders have a compile-time bound.  These
+// are instantiated for LoadVirtualSpecialized.
+template <class Search, class VocabularyT, unsigned char FixedOrder = 0> class GenericModel : public base::ModelFacade<GenericModel<Search, VocabularyT, FixedOrder>, typename FixedOrderState<FixedOrder>::T, VocabularyT> {
   private:
-    typedef base::ModelFacade<GenericModel<Search, VocabularyT>, State, VocabularyT> P;
+    typedef base::ModelFacade<GenericModel<Search, VocabularyT, FixedOrder>, typename FixedOrderState<FixedOrder>::T, VocabularyT> P;
   public:
+    typedef typename P::State State;
+    typedef typename FixedOrderState<FixedOrder>::Compact CompactState;
+
     // This is the model type returned by RecognizeBinary.
     static const ModelType kModelType;
 
@@ -50,6 +66,13 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
      */
     explicit GenericModel(const char *file, const Config &config = Config());
 
+    /* With Config::load_method = util::LAZY_PREFETCH, the constructor returns
+     * while background threads are still faulting in the binary file.  Use
+     * this to report progress or Wait().  NULL if nothing is being prefetched.
+     */
+    const util::Prefetcher *Prefetching() const { return backing_.Prefetching(); }
+    util::Prefetcher *Prefetching() { return backing_.Prefetching(); }
+
     /* Score p(new_word | in_state) and incorporate new_word into out_state.
      * Note that in_state and out_state must be different references:
      * &in_state != &out_state.
@@ -65,6 +88,18 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
      */
     FullScoreReturn FullScoreForgotState(const WordIndex *context_rbegin, const WordIndex *context_rend, const WordIndex new_word, State &out_state) const;
 
+    /* Score from a compact state, which stores the context words without
+     * their backoffs.  The backoffs are looked up again, so this costs more
+     * lookups than FullScore with a full state, but the result is the same.
+     * Use it when memory for states matters more than time.
+     */
+    FullScoreReturn FullScore(const CompactState &in_state, const WordIndex new_word, CompactState &out_state) const {
+      State full;
+      FullScoreReturn ret(FullScoreForgotState(in_state.words, in_state.words + in_state.length, new_word, full));
+      out_state.Set(full);
+      return ret;
+    }
+
     /* Get the state for a context.  Don't use this if you can avoid it.  Use
      * BeginSentenceState or NullContextState and extend from those.  If
      * you're only going to use this state to call FullScore once, use
@@ -103,6 +138,8 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
     }
 
   private:
+    unsigned char ModelOrder() const { return FixedOrder ? FixedOrder : P::Order(); }
+
     FullScoreReturn ScoreExceptBackoff(const WordIndex *const context_rbegin, const WordIndex *const context_rend, const WordIndex new_word, State &out_state) const;
 
     // Score bigrams and above.  Do not include backoff.
@@ -113,6 +150,9 @@ template <class Search, class VocabularyT> class GenericModel : public base::Mod
 
     void InitializeFromARPA(int fd, const char *file, const Config &config);
 
+    // Point the vocabulary at the word table in backing_.
+    void InitWords();
+
     float InternalUnRest(const uint64_t *pointers_begin, const uint64_t *pointers_end, unsigned char first_length) const;
 
     BinaryFormat backing_;
@@ -149,6 +189,14 @@ typedef ProbingModel Model;
  * classes as template arguments to your own virtual feature function.*/
 base::Model *LoadVirtual(const char *file_name, const Config &config = Config(), ModelType if_arpa = PROBING);
 
+/* Like LoadVirtual, but PROBING and TRIE models are instantiated for their
+ * exact order when that is at most KENLM_MAX_ORDER.  States are then smaller
+ * than State and have a different layout, so only allocate StateSize() bytes
+ * per state and only access them through the virtual interface.  Other model
+ * types load as LoadVirtual would.
+ */
+base::Model *LoadVirtualSpecialized(const char *file_name, const Config &config = Config(), ModelType if_arpa = PROBING);
+
 } // namespace ngram
 } // namespace lm
 
@@ -0,0 +1,114 @@
+#include "model_handle.hh"
+
+#ifdef WITH_THREADS
+#include "lm_exception.hh"
+#include "model.hh"
+
+#include <new>
+
+namespace lm {
+namespace ngram {
+
+ModelHandle::ModelHandle(base::Model *model, std::size_t max_readers)
+  : max_readers_(max_readers), epoch_(1) {
+  InitSlots();
+  Published *published = new Published();
+  published->model.reset(model);
+  published->generation = 0;
+  current_.store(published);
+}
+
+ModelHandle::ModelHandle(const char *file, std::size_t max_readers, const Config &config, ModelType if_arpa)
+  : max_readers_(max_readers), epoch_(1) {
+  InitSlots();
+  Published *published = new Published();
+  published->model.reset(LoadVirtual(file, config, if_arpa));
+  published->generation = 0;
+  current_.store(published);
+}
+
+ModelHandle::~ModelHandle() {
+  if (background_.joinable()) background_.join();
+  delete current_.load();
+}
+
+void ModelHandle::InitSlots() {
+  slot_memory_.reset(new char[max_readers_ * sizeof(Slot) + alignof(Slot)]);
+  uintptr_t base = reinterpret_cast<uintptr_t>(slot_memory_.get());
+  slots_ = reinterpret_cast<Slot*>(base + (alignof(Slot) - base % alignof(Slot)) % alignof(Slot));
+  // Slot is trivially destructible so there is no matching destructor call.
+  for (std::size_t i = 0; i < max_readers_; ++i) {
+    new (slots_ + i) Slot();
+  }
+}
+
+ModelHandle::Reader::Reader(ModelHandle &handle) : handle_(handle), slot_(handle.Claim()) {}
+
+ModelHandle::Reader::~Reader() {
+  slot_.claimed.store(false);
+}
+
+ModelHandle::Slot &ModelHandle::Claim() {
+  for (std::size_t i = 0; i < max_readers_; ++i) {
+    bool expected = false;
+    if (slots_[i].claimed.compare_exchange_strong(expected, true)) return slots_[i];
+  }
+  UTIL_THROW(ConfigException, "All " << max_readers_ << " reader slots are in use.");
+}
+
+void ModelHandle::Replace(base::Model *model) {
+  std::unique_ptr<base::Model> owned(model);
+  Publish(owned);
+}
+
+void ModelHandle::Replace(const char *file, const Config &config, ModelType if_arpa) {
+  // Load before taking the lock so a slow load does not block other replacements.
+  std::unique_ptr<base::Model> model(LoadVirtual(file, config, if_arpa));
+  Publish(model);
+}
+
+void ModelHandle::ReplaceInBackground(const std::string &file, const Config &config, ModelType if_arpa) {
+  Wait();
+  background_ = boost::thread(&ModelHandle::Background, this, file, config, if_arpa);
+}
+
+void ModelHandle::Wait() {
+  if (background_.joinable()) background_.join();
+  if (background_error_) {
+    std::exception_ptr error(background_error_);
+    background_error_ = std::exception_ptr();
+    std::rethrow_exception(error);
+  }
+}
+
+void ModelHandle::Publish(std::unique_ptr<base::Model> &model) {
+  boost::mutex::scoped_lock lock(replace_mutex_);
+  Published *published = new Published();
+  published->generation = current_.load()->generation + 1;
+  published->model.reset(model.release());
+  std::unique_ptr<Published> old(current_.exchange(published));
+  const uint64_t epoch = epoch_.fetch_add(1) + 1;
+  // Wait for readers that entered before the exchange.  These loads are
+  // sequentially consistent to pair with the Guard's store of its epoch
+  // followed by its load of current_: either the reader saw the new model or
+  // this sees its old epoch.
+  for (std::size_t i = 0; i < max_readers_; ++i) {
+    while (true) {
+      uint64_t reading = slots_[i].epoch.load();
+      if (!reading || reading >= epoch) break;
+      boost::this_thread::yield();
+    }
+  }
+}
+
+void ModelHandle::Background(std::string file, Config config, ModelType if_arpa) {
+  try {
+    Replace(file.c_str(), config, if_arpa);
+  } catch (...) {
+    background_error_ = std::current_exception();
+  }
+}
+
+} // namespace ngram
+} // namespace lm
+#endif // WITH_THREADS
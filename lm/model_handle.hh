@@ -0,0 +1,159 @@
+#ifndef LM_MODEL_HANDLE_H
+#define LM_MODEL_HANDLE_H
+
+/* Replace the model behind a long-running service without stopping queries.
+ * Readers pin the current model with a Guard.  Replace publishes a new model
+ * with one atomic exchange, then waits for readers that might still hold the
+ * old one before deleting it, in the style of RCU with epochs:
+ *
+ *   - Each Reader owns a slot.  Entering a Guard stores the global epoch in
+ *     the slot and then loads the current model; leaving stores 0.
+ *   - Replace exchanges the model, increments the epoch to e, and waits until
+ *     every slot is 0 or at least e.  A reader that loaded the old model must
+ *     have entered before the exchange, so its slot holds an epoch below e
+ *     until it leaves.
+ *
+ * Entering and leaving are a few atomic operations on a slot nobody else
+ * writes, so the read side does not contend.  Guards on the same Reader do
+ * not nest.
+ *
+ * Only available when compiled with WITH_THREADS.
+ */
+
+#ifdef WITH_THREADS
+
+#include "config.hh"
+#include "model_type.hh"
+#include "virtual_interface.hh"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+namespace ngram {
+
+class ModelHandle {
+  private:
+    struct Published {
+      std::unique_ptr<base::Model> model;
+      uint64_t generation;
+    };
+
+    // One per Reader, on its own cache line so readers do not share.
+    struct alignas(64) Slot {
+      Slot() : epoch(0), claimed(false) {}
+      std::atomic<uint64_t> epoch;
+      std::atomic<bool> claimed;
+    };
+
+  public:
+    // Takes ownership of model.  At most max_readers Readers may exist at once.
+    ModelHandle(base::Model *model, std::size_t max_readers);
+
+    // Load file with LoadVirtual.
+    ModelHandle(const char *file, std::size_t max_readers, const Config &config = Config(), ModelType if_arpa = PROBING);
+
+    // Waits for any background load.  There must be no Readers left.
+    ~ModelHandle();
+
+    class Guard;
+
+    // Register a thread that queries.  Keep it for the life of the thread.
+    class Reader {
+      public:
+        explicit Reader(ModelHandle &handle);
+        ~Reader();
+
+      private:
+        friend class Guard;
+        ModelHandle &handle_;
+        Slot &slot_;
+
+        Reader(const Reader &);
+        Reader &operator=(const Reader &);
+    };
+
+    // Pins the model that was current when constructed.  Keep guards short
+    // since Replace waits for them.
+    class Guard {
+      public:
+        explicit Guard(Reader &reader) : slot_(reader.slot_) {
+          slot_.epoch.store(reader.handle_.epoch_.load());
+          published_ = reader.handle_.current_.load();
+        }
+
+        ~Guard() {
+          slot_.epoch.store(0, std::memory_order_release);
+        }
+
+        const base::Model &operator*() const { return *published_->model; }
+        const base::Model *operator->() const { return published_->model.get(); }
+
+        // 0 for the initial model, then 1 more for each Replace.
+        uint64_t Generation() const { return published_->generation; }
+
+      private:
+        Slot &slot_;
+        const Published *published_;
+
+        Guard(const Guard &);
+        Guard &operator=(const Guard &);
+    };
+
+    /* Publish model, taking ownership, then wait for readers of the previous
+     * model and delete it.  Replacements are serialized.
+     */
+    void Replace(base::Model *model);
+
+    // Load file with LoadVirtual, then Replace.
+    void Replace(const char *file, const Config &config = Config(), ModelType if_arpa = PROBING);
+
+    /* Load and Replace in a background thread and return immediately.  Queries
+     * continue on the current model until the new one is ready.  Call Wait to
+     * learn whether it worked.
+     */
+    void ReplaceInBackground(const std::string &file, const Config &config = Config(), ModelType if_arpa = PROBING);
+
+    // Wait for ReplaceInBackground, rethrowing anything loading threw.
+    void Wait();
+
+    // Generation of the current model.
+    uint64_t Generation() const { return current_.load()->generation; }
+
+  private:
+    void InitSlots();
+
+    Slot &Claim();
+
+    void Publish(std::unique_ptr<base::Model> &model);
+
+    void Background(std::string file, Config config, ModelType if_arpa);
+
+    // Before C++17, new does not honor alignas(64), so slots_ is aligned by
+    // hand within slot_memory_.
+    std::unique_ptr<char[]> slot_memory_;
+    Slot *slots_;
+    const std::size_t max_readers_;
+
+    std::atomic<uint64_t> epoch_;
+    std::atomic<Published*> current_;
+
+    // Held while replacing.
+    boost::mutex replace_mutex_;
+
+    boost::thread background_;
+    std::exception_ptr background_error_;
+};
+
+} // namespace ngram
+} // namespace lm
+
+#endif // WITH_THREADS
+#endif // LM_MODEL_HANDLE_H
@@ -0,0 +1,132 @@
+#include "model_handle.hh"
+
+#include "model.hh"
+
+#define BOOST_TEST_MODULE ModelHandleTest
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <vector>
+
+namespace lm {
+namespace ngram {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+Config SilentConfig() {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  return config;
+}
+
+// Counts live models so the test can see when old ones are deleted.
+std::atomic<int> live_models(0);
+
+class CountedModel : public ProbingModel {
+  public:
+    CountedModel() : ProbingModel(TestLocation(), SilentConfig()) { ++live_models; }
+    ~CountedModel() { --live_models; }
+};
+
+float Score(const base::Model &model) {
+  std::vector<char> in(model.StateSize()), out(model.StateSize());
+  model.BeginSentenceWrite(&in[0]);
+  return model.BaseScore(&in[0], model.BaseVocabulary().Index("looking"), &out[0]);
+}
+
+class Replacer {
+  public:
+    Replacer(ModelHandle &handle, std::atomic<bool> &replaced) : handle_(handle), replaced_(replaced) {}
+    void operator()() {
+      handle_.Replace(new CountedModel());
+      replaced_ = true;
+    }
+  private:
+    ModelHandle &handle_;
+    std::atomic<bool> &replaced_;
+};
+
+class Querier {
+  public:
+    Querier(ModelHandle &handle, std::atomic<bool> &stop, std::atomic<int> &bad) : handle_(handle), stop_(stop), bad_(bad) {}
+    // Boost.Test is not thread safe, so count bad scores for the main thread to check.
+    void operator()() {
+      ModelHandle::Reader reader(handle_);
+      while (!stop_) {
+        ModelHandle::Guard guard(reader);
+        if (!(Score(*guard) < 0.0)) ++bad_;
+      }
+    }
+  private:
+    ModelHandle &handle_;
+    std::atomic<bool> &stop_;
+    std::atomic<int> &bad_;
+};
+
+BOOST_AUTO_TEST_CASE(WaitsForReaders) {
+  ModelHandle handle(new CountedModel(), 2);
+  BOOST_CHECK_EQUAL(1, live_models.load());
+  ModelHandle::Reader reader(handle);
+  std::atomic<bool> replaced(false);
+  boost::thread replacer;
+  {
+    ModelHandle::Guard guard(reader);
+    BOOST_CHECK_EQUAL(0U, guard.Generation());
+    float before = Score(*guard);
+    replacer = boost::thread(Replacer(handle, replaced));
+    // The new model is published but the old one stays while the guard is held.
+    while (handle.Generation() == 0) boost::this_thread::yield();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    BOOST_CHECK(!replaced);
+    BOOST_CHECK_EQUAL(2, live_models.load());
+    BOOST_CHECK_EQUAL(before, Score(*guard));
+  }
+  replacer.join();
+  BOOST_CHECK(replaced);
+  BOOST_CHECK_EQUAL(1, live_models.load());
+  ModelHandle::Guard guard(reader);
+  BOOST_CHECK_EQUAL(1U, guard.Generation());
+}
+
+BOOST_AUTO_TEST_CASE(ReaderSlots) {
+  ModelHandle handle(new CountedModel(), 1);
+  {
+    ModelHandle::Reader first(handle);
+    BOOST_CHECK_THROW(ModelHandle::Reader second(handle), ConfigException);
+  }
+  // Released by the destructor.
+  ModelHandle::Reader again(handle);
+}
+
+BOOST_AUTO_TEST_CASE(Background) {
+  ModelHandle handle(TestLocation(), 4, SilentConfig());
+  std::atomic<bool> stop(false);
+  std::atomic<int> bad(0);
+  boost::thread_group readers;
+  for (unsigned int i = 0; i < 3; ++i) {
+    readers.create_thread(Querier(handle, stop, bad));
+  }
+  for (unsigned int i = 0; i < 5; ++i) {
+    handle.ReplaceInBackground(TestLocation(), SilentConfig(), i % 2 ? PROBING : TRIE);
+  }
+  handle.Wait();
+  BOOST_CHECK_EQUAL(5U, handle.Generation());
+  handle.ReplaceInBackground("does_not_exist.arpa", SilentConfig());
+  BOOST_CHECK_THROW(handle.Wait(), util::Exception);
+  BOOST_CHECK_EQUAL(5U, handle.Generation());
+  stop = true;
+  readers.join_all();
+  BOOST_CHECK_EQUAL(0, bad.load());
+}
+
+} // namespace
+} // namespace ngram
+} // namespace lm
@@ -1,4 +1,5 @@
 #include "model.hh"
+#include "../util/prefetch.hh"
 
 #include <cstdlib>
 #include <cstring>
@@ -6,6 +7,7 @@
 #define BOOST_TEST_MODULE ModelTest
 #include <boost/test/unit_test.hpp>
 #include <boost/test/floating_point_comparison.hpp>
+#include <boost/scoped_ptr.hpp>
 
 // Apparently some Boost versions use templates and are pretty strict about types matching.
 #define SLOPPY_CHECK_CLOSE(ref, value, tol) BOOST_CHECK_CLOSE(static_cast<double>(ref), static_cast<double>(value), static_cast<double>(tol));
@@ -431,6 +433,183 @@ BOOST_AUTO_TEST_CASE(write_and_read_quant_array_trie) {
   BinaryTest<QuantArrayTrieModel>();
 }
 
+template <class ModelT> void WordTableTest(Config::WriteMethod write_method) {
+  Config config;
+  config.write_mmap = "test_words.binary";
+  config.messages = NULL;
+  config.write_method = write_method;
+  config.word_table = true;
+  ExpectEnumerateVocab enumerate;
+  config.enumerate_vocab = &enumerate;
+  {
+    ModelT copy_model(TestLocation(), config);
+    BOOST_REQUIRE(copy_model.GetVocabulary().HasWords());
+    for (WordIndex i = 0; i < enumerate.seen.size(); ++i) {
+      BOOST_CHECK_EQUAL(enumerate.seen[i], copy_model.GetVocabulary().Word(i));
+    }
+  }
+  config.write_mmap = NULL;
+  config.word_table = false;
+  enumerate.Clear();
+  {
+    // Enumeration must skip over the table.
+    ModelT binary("test_words.binary", config);
+    enumerate.Check(binary.GetVocabulary());
+    BOOST_REQUIRE(binary.GetVocabulary().HasWords());
+    for (WordIndex i = 0; i < enumerate.seen.size(); ++i) {
+      BOOST_CHECK_EQUAL(enumerate.seen[i], binary.GetVocabulary().Word(i));
+    }
+    Everything(binary);
+  }
+  unlink("test_words.binary");
+}
+
+BOOST_AUTO_TEST_CASE(word_table_probing) {
+  WordTableTest<ProbingModel>(Config::WRITE_AFTER);
+  WordTableTest<ProbingModel>(Config::WRITE_MMAP);
+}
+BOOST_AUTO_TEST_CASE(word_table_trie) {
+  WordTableTest<TrieModel>(Config::WRITE_AFTER);
+  WordTableTest<TrieModel>(Config::WRITE_MMAP);
+}
+
+template <class ModelT> void PrefetchTest() {
+  Config config;
+  config.write_mmap = "test_prefetch.binary";
+  config.messages = NULL;
+  config.word_table = true;
+  {
+    ModelT copy_model(TestLocation(), config);
+    BOOST_CHECK(!copy_model.Prefetching());
+  }
+  config.write_mmap = NULL;
+  config.load_method = util::LAZY_PREFETCH;
+  {
+    ModelT binary("test_prefetch.binary", config);
+    BOOST_REQUIRE(binary.Prefetching());
+    // Queries work before prefetching finishes.
+    Everything(binary);
+    binary.Prefetching()->Wait();
+    BOOST_CHECK(binary.Prefetching()->Ready());
+    // Vocabulary, five orders, and the word table.
+    BOOST_CHECK_EQUAL(7U, binary.Prefetching()->Ranges());
+    for (std::size_t i = 0; i < 7; ++i) {
+      BOOST_CHECK(binary.Prefetching()->Ready(i));
+    }
+    Everything(binary);
+  }
+  unlink("test_prefetch.binary");
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_probing) {
+  PrefetchTest<ProbingModel>();
+}
+BOOST_AUTO_TEST_CASE(prefetch_trie) {
+  PrefetchTest<TrieModel>();
+}
+
+template <class ModelT> void SharedTest() {
+  Config config;
+  config.write_mmap = "test_shared.binary";
+  config.messages = NULL;
+  config.word_table = true;
+  {
+    ModelT copy_model(TestLocation(), config);
+  }
+  config.write_mmap = NULL;
+  config.load_method = util::SHARED;
+  {
+    // The second attaches to the segment the first created.
+    ModelT first("test_shared.binary", config);
+    ModelT second("test_shared.binary", config);
+    Everything(first);
+    Everything(second);
+    BOOST_REQUIRE(second.GetVocabulary().HasWords());
+    BOOST_CHECK_EQUAL("looking", second.GetVocabulary().Word(second.GetVocabulary().Index("looking")));
+  }
+  unlink("test_shared.binary");
+}
+
+BOOST_AUTO_TEST_CASE(shared_probing) {
+  SharedTest<ProbingModel>();
+}
+BOOST_AUTO_TEST_CASE(shared_trie) {
+  SharedTest<TrieModel>();
+}
+
+void SpecializedTest(ModelType if_arpa) {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  boost::scoped_ptr<base::Model> general(LoadVirtual(TestLocation(), config, if_arpa));
+  boost::scoped_ptr<base::Model> special(LoadVirtualSpecialized(TestLocation(), config, if_arpa));
+  BOOST_REQUIRE_EQUAL(5, special->Order());
+  BOOST_CHECK_EQUAL(sizeof(OrderState<5>), special->StateSize());
+  BOOST_CHECK(special->StateSize() <= general->StateSize());
+
+  const char *words[] = {"looking", "on", "a", "little", "more", "loin", "also", "would", "consider", "higher", "to", "look", "</s>"};
+  // Score through the virtual interface using each model's own state size.
+  std::vector<char> general_state(2 * general->StateSize()), special_state(2 * special->StateSize());
+  general->BeginSentenceWrite(&general_state[0]);
+  special->BeginSentenceWrite(&special_state[0]);
+  for (std::size_t i = 0; i < sizeof(words) / sizeof(const char*); ++i) {
+    void *general_in = &general_state[(i % 2) * general->StateSize()];
+    void *general_out = &general_state[((i + 1) % 2) * general->StateSize()];
+    void *special_in = &special_state[(i % 2) * special->StateSize()];
+    void *special_out = &special_state[((i + 1) % 2) * special->StateSize()];
+    FullScoreReturn expect(general->BaseFullScore(general_in, general->BaseVocabulary().Index(words[i]), general_out));
+    FullScoreReturn got(special->BaseFullScore(special_in, special->BaseVocabulary().Index(words[i]), special_out));
+    BOOST_CHECK_CLOSE(expect.prob, got.prob, 0.001);
+    BOOST_CHECK_EQUAL(expect.ngram_length, got.ngram_length);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(specialized_probing) {
+  SpecializedTest(PROBING);
+}
+BOOST_AUTO_TEST_CASE(specialized_trie) {
+  SpecializedTest(TRIE);
+}
+BOOST_AUTO_TEST_CASE(specialized_fallback) {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  boost::scoped_ptr<base::Model> model(LoadVirtualSpecialized(TestLocation(), config, QUANT_ARRAY_TRIE));
+  BOOST_CHECK_EQUAL(sizeof(State), model->StateSize());
+}
+
+template <class ModelT> void CompactStateTest() {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  ModelT model(TestLocation(), config);
+  BOOST_CHECK(sizeof(CompactState) < sizeof(State));
+  const char *words[] = {"looking", "on", "a", "little", "more", "loin", "also", "would", "consider", "higher", "to", "look", "good", "</s>"};
+  State full[2];
+  CompactState compact[2];
+  full[0] = model.BeginSentenceState();
+  compact[0].Set(full[0]);
+  for (std::size_t i = 0; i < sizeof(words) / sizeof(const char*); ++i) {
+    WordIndex word = model.GetVocabulary().Index(words[i]);
+    FullScoreReturn expect(model.FullScore(full[i % 2], word, full[(i + 1) % 2]));
+    FullScoreReturn got(model.FullScore(compact[i % 2], word, compact[(i + 1) % 2]));
+    BOOST_CHECK_CLOSE(expect.prob, got.prob, 0.001);
+    BOOST_CHECK_EQUAL(expect.ngram_length, got.ngram_length);
+    CompactState converted;
+    converted.Set(full[(i + 1) % 2]);
+    BOOST_CHECK(converted == compact[(i + 1) % 2]);
+    BOOST_CHECK_EQUAL(hash_value(full[(i + 1) % 2]), hash_value(compact[(i + 1) % 2]));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(compact_state_probing) {
+  CompactStateTest<ProbingModel>();
+}
+BOOST_AUTO_TEST_CASE(compact_state_trie) {
+  CompactStateTest<TrieModel>();
+  CompactStateTest<QuantTrieModel>();
+}
+
 BOOST_AUTO_TEST_CASE(rest_max) {
   Config config;
   config.arpa_complain = Config::NONE;
@@ -3,12 +3,26 @@
 
 #include "enumerate_vocab.hh"
 #include "model.hh"
+#include "trace.hh"
+#include "../util/file.hh"
 #include "../util/file_stream.hh"
 #include "../util/file_piece.hh"
+#include "../util/latency_histogram.hh"
+#include "../util/string_stream.hh"
+#include "../util/tokenize_piece.hh"
 #include "../util/usage.hh"
 
+#ifdef WITH_THREADS
+#include "../util/thread_pool.hh"
+
+#include <boost/utility/in_place_factory.hpp>
+#endif // WITH_THREADS
+
+#include <algorithm>
 #include <cstdlib>
+#include <deque>
 #include <string>
+#include <vector>
 #include <cmath>
 
 namespace lm {
@@ -21,16 +35,33 @@ class QueryPrinter {
 
     void Word(StringPiece surface, WordIndex vocab, const FullScoreReturn &ret) {
       if (!print_word_) return;
-      out_ << surface << '=' << vocab << ' ' << static_cast<unsigned int>(ret.ngram_length)  << ' ' << ret.prob << '\t';
+      FormatWord(out_, surface, vocab, ret);
       if (flush_) out_.flush();
     }
 
     void Line(uint64_t oov, float total) {
       if (!print_line_) return;
-      out_ << "Total: " << total << " OOV: " << oov << '\n';
+      FormatLine(out_, oov, total);
+      if (flush_) out_.flush();
+    }
+
+    // Threaded Query formats blocks of output with these then calls Block.
+    template <class Stream> static void FormatWord(Stream &out, StringPiece surface, WordIndex vocab, const FullScoreReturn &ret) {
+      out << surface << '=' << vocab << ' ' << static_cast<unsigned int>(ret.ngram_length)  << ' ' << ret.prob << '\t';
+    }
+
+    template <class Stream> static void FormatLine(Stream &out, uint64_t oov, float total) {
+      out << "Total: " << total << " OOV: " << oov << '\n';
+    }
+
+    void Block(StringPiece text) {
+      out_ << text;
       if (flush_) out_.flush();
     }
 
+    bool PrintWord() const { return print_word_; }
+    bool PrintLine() const { return print_line_; }
+
     void Summary(double ppl_including_oov, double ppl_excluding_oov, uint64_t corpus_oov, uint64_t corpus_tokens) {
       if (!print_summary_) return;
       out_ <<
@@ -41,6 +72,12 @@ class QueryPrinter {
       out_.flush();
     }
 
+    void Latency(const util::LatencyHistogram &words, const util::LatencyHistogram &sentences) {
+      words.Print("Word latency", out_);
+      sentences.Print("Sentence latency", out_);
+      out_.flush();
+    }
+
   private:
     util::FileStream out_;
     bool print_word_;
@@ -49,7 +86,11 @@ class QueryPrinter {
     bool flush_;
 };
 
-template <class Model, class Printer> void Query(const Model &model, bool sentence_context, Printer &printer) {
+/* If latency is set, time each FullScore call and pass percentiles to
+ * printer.Latency.  A sentence's latency is the sum of its queries, so reading
+ * and printing are excluded.
+ */
+template <class Model, class Printer> void Query(const Model &model, bool sentence_context, Printer &printer, bool latency = false) {
   typename Model::State state, out;
   lm::FullScoreReturn ret;
   StringPiece word;
@@ -61,14 +102,24 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
   uint64_t corpus_oov = 0;
   uint64_t corpus_tokens = 0;
 
+  util::LatencyHistogram word_latency, sentence_latency;
+  uint64_t before = 0;
+
   while (true) {
     state = sentence_context ? model.BeginSentenceState() : model.NullContextState();
     float total = 0.0;
     uint64_t oov = 0;
+    uint64_t sentence_time = 0;
 
     while (in.ReadWordSameLine(word)) {
       lm::WordIndex vocab = model.GetVocabulary().Index(word);
+      if (latency) before = util::LatencyClock();
       ret = model.FullScore(state, vocab, out);
+      if (latency) {
+        uint64_t took = util::LatencyClock() - before;
+        word_latency.Add(took);
+        sentence_time += took;
+      }
       if (vocab == model.GetVocabulary().NotFound()) {
         ++oov;
         corpus_total_oov_only += ret.prob;
@@ -84,11 +135,18 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
       UTIL_THROW_IF('\n' != in.get(), util::Exception, "FilePiece is confused.");
     } catch (const util::EndOfFileException &e) { break; }
     if (sentence_context) {
+      if (latency) before = util::LatencyClock();
       ret = model.FullScore(state, model.GetVocabulary().EndSentence(), out);
+      if (latency) {
+        uint64_t took = util::LatencyClock() - before;
+        word_latency.Add(took);
+        sentence_time += took;
+      }
       total += ret.prob;
       ++corpus_tokens;
       printer.Word("</s>", model.GetVocabulary().EndSentence(), ret);
     }
+    if (latency) sentence_latency.Add(sentence_time);
     printer.Line(oov, total);
     corpus_total += total;
     corpus_oov += oov;
@@ -98,11 +156,211 @@ template <class Model, class Printer> void Query(const Model &model, bool senten
       pow(10.0, -((corpus_total - corpus_total_oov_only) / static_cast<double>(corpus_tokens - corpus_oov))), // PPL excluding OOVs
       corpus_oov,
       corpus_tokens);
+  if (latency) printer.Latency(word_latency, sentence_latency);
 }
 
-template <class Model> void Query(const char *file, const Config &config, bool sentence_context, QueryPrinter &printer) {
+#ifdef WITH_THREADS
+/* Threaded Query.  The reading thread copies whole lines into blocks, workers
+ * score blocks and format their output, and one output thread prints blocks
+ * in input order.  Corpus statistics are accumulated in input order as well,
+ * so the output is identical to Query.
+ */
+struct QueryBlock {
+  uint64_t sequence;
+  // Words separated by ' ' and lines ended by '\n'.  At the end of the input,
+  // the last line has no '\n' if the input did not.
+  std::string words;
+
+  // Filled in by workers.
+  std::string output;
+  // Totals of complete lines and probabilities of OOVs in order, so the
+  // output thread can add them to the corpus sums in the same order as Query.
+  std::vector<float> line_totals;
+  std::vector<float> oov_probs;
+  uint64_t oov, tokens;
+};
+
+struct QueryTotals {
+  QueryTotals() : total(0.0), total_oov_only(0.0), oov(0), tokens(0) {}
+  double total;
+  double total_oov_only;
+  uint64_t oov;
+  uint64_t tokens;
+};
+
+// Copy lines until to has at least size bytes.  Returns false at end of file.
+inline bool ReadQueryBlock(util::FilePiece &in, std::size_t size, std::string &to) {
+  to.clear();
+  StringPiece word;
+  while (to.size() < size) {
+    bool first = true;
+    while (in.ReadWordSameLine(word)) {
+      if (!first) to += ' ';
+      first = false;
+      to.append(word.data(), word.size());
+    }
+    try {
+      UTIL_THROW_IF('\n' != in.get(), util::Exception, "FilePiece is confused.");
+    } catch (const util::EndOfFileException &e) { return false; }
+    to += '\n';
+  }
+  return true;
+}
+
+template <class Model> class QueryWorker {
+  public:
+    typedef QueryBlock *Request;
+
+    QueryWorker(const Model &model, bool sentence_context, bool print_word, bool print_line, util::PCQueue<Request> &done)
+      : model_(model), sentence_context_(sentence_context), print_word_(print_word), print_line_(print_line), done_(done) {}
+
+    void operator()(Request block) {
+      block->output.clear();
+      out_.swap(block->output);
+      block->line_totals.clear();
+      block->oov_probs.clear();
+      block->oov = 0;
+      block->tokens = 0;
+      const char *end = block->words.data() + block->words.size();
+      for (const char *line = block->words.data(); line != end;) {
+        const char *newline = std::find(line, end, '\n');
+        Line(StringPiece(line, newline - line), newline != end, *block);
+        line = (newline == end) ? end : newline + 1;
+      }
+      out_.swap(block->output);
+      done_.Produce(block);
+    }
+
+  private:
+    void Line(StringPiece line, bool complete, QueryBlock &block) {
+      typename Model::State state(sentence_context_ ? model_.BeginSentenceState() : model_.NullContextState()), out;
+      lm::FullScoreReturn ret;
+      float total = 0.0;
+      uint64_t oov = 0;
+      for (util::TokenIter<util::SingleCharacter, true> word(line, ' '); word; ++word) {
+        lm::WordIndex vocab = model_.GetVocabulary().Index(*word);
+        ret = model_.FullScore(state, vocab, out);
+        if (vocab == model_.GetVocabulary().NotFound()) {
+          ++oov;
+          block.oov_probs.push_back(ret.prob);
+        }
+        total += ret.prob;
+        if (print_word_) QueryPrinter::FormatWord(out_, *word, vocab, ret);
+        ++block.tokens;
+        state = out;
+      }
+      // Like Query, a last line without a newline gets no </s> and is not
+      // counted in the totals.
+      if (!complete) return;
+      if (sentence_context_) {
+        ret = model_.FullScore(state, model_.GetVocabulary().EndSentence(), out);
+        total += ret.prob;
+        ++block.tokens;
+        if (print_word_) QueryPrinter::FormatWord(out_, "</s>", model_.GetVocabulary().EndSentence(), ret);
+      }
+      if (print_line_) QueryPrinter::FormatLine(out_, oov, total);
+      block.line_totals.push_back(total);
+      block.oov += oov;
+    }
+
+    const Model &model_;
+    bool sentence_context_, print_word_, print_line_;
+    util::StringStream out_;
+    util::PCQueue<Request> &done_;
+};
+
+// There should only be one QueryOutput.
+class QueryOutput {
+  public:
+    typedef QueryBlock *Request;
+
+    QueryOutput(QueryPrinter &printer, QueryTotals &totals, util::PCQueue<Request> &done)
+      : printer_(printer), totals_(totals), done_(done), base_sequence_(0) {}
+
+    void operator()(Request block) {
+      uint64_t pos = block->sequence - base_sequence_;
+      if (pos >= ordering_.size()) {
+        ordering_.resize(pos + 1, NULL);
+      }
+      ordering_[pos] = block;
+      while (!ordering_.empty() && ordering_.front()) {
+        Print(*ordering_.front());
+        done_.Produce(ordering_.front());
+        ordering_.pop_front();
+        ++base_sequence_;
+      }
+    }
+
+  private:
+    void Print(const QueryBlock &block) {
+      if (!block.output.empty()) printer_.Block(block.output);
+      for (std::vector<float>::const_iterator i = block.line_totals.begin(); i != block.line_totals.end(); ++i) {
+        totals_.total += *i;
+      }
+      for (std::vector<float>::const_iterator i = block.oov_probs.begin(); i != block.oov_probs.end(); ++i) {
+        totals_.total_oov_only += *i;
+      }
+      totals_.oov += block.oov;
+      totals_.tokens += block.tokens;
+    }
+
+    QueryPrinter &printer_;
+    QueryTotals &totals_;
+    util::PCQueue<Request> &done_;
+    std::deque<Request> ordering_;
+    uint64_t base_sequence_;
+};
+
+template <class Model> void ParallelQuery(const Model &model, bool sentence_context, QueryPrinter &printer, std::size_t threads, std::size_t block_size = 1 << 20) {
+  // Enough blocks that workers do not wait on the reading or output thread.
+  const std::size_t queue = 2 * threads + 2;
+  std::vector<QueryBlock> blocks(queue);
+  util::PCQueue<QueryBlock*> recycle(queue);
+  for (std::size_t i = 0; i < queue; ++i) {
+    recycle.Produce(&blocks[i]);
+  }
+  QueryTotals totals;
+  {
+    util::ThreadPool<QueryOutput> output(queue, 1, boost::in_place(boost::ref(printer), boost::ref(totals), boost::ref(recycle)), NULL);
+    // Destroyed first, so workers finish before the output thread does.
+    util::ThreadPool<QueryWorker<Model> > workers(queue, threads, boost::in_place(boost::cref(model), sentence_context, printer.PrintWord(), printer.PrintLine(), boost::ref(output.In())), NULL);
+    util::FilePiece in(0);
+    bool more = true;
+    for (uint64_t sequence = 0; more; ++sequence) {
+      QueryBlock *block = recycle.Consume();
+      block->sequence = sequence;
+      more = ReadQueryBlock(in, block_size, block->words);
+      workers.Produce(block);
+    }
+  }
+  printer.Summary(
+      pow(10.0, -(totals.total / static_cast<double>(totals.tokens))), // PPL including OOVs
+      pow(10.0, -((totals.total - totals.total_oov_only) / static_cast<double>(totals.tokens - totals.oov))), // PPL excluding OOVs
+      totals.oov,
+      totals.tokens);
+}
+#endif // WITH_THREADS
+
+// If trace is not NULL, also record the queries there for kenlm_replay.  If
+// threads is positive, score with that many threads; latency and trace are
+// not supported then, nor are threads without WITH_THREADS.
+template <class Model> void Query(const char *file, const Config &config, bool sentence_context, QueryPrinter &printer, bool latency = false, const char *trace = NULL, std::size_t threads = 0) {
   Model model(file, config);
-  Query<Model, QueryPrinter>(model, sentence_context, printer);
+  if (threads) {
+#ifdef WITH_THREADS
+    UTIL_THROW_IF(latency || trace, util::Exception, "Latency and tracing are not supported with threads.");
+    ParallelQuery<Model>(model, sentence_context, printer, threads);
+#else // WITH_THREADS
+    UTIL_THROW(util::Exception, "Threaded scoring requires compiling with WITH_THREADS.");
+#endif // WITH_THREADS
+  } else if (trace) {
+    util::scoped_fd trace_fd(util::CreateOrThrow(trace));
+    TracingModel<Model> tracing(model, trace_fd.get());
+    Query<TracingModel<Model>, QueryPrinter>(tracing, sentence_context, printer, latency);
+    tracing.Flush();
+  } else {
+    Query<Model, QueryPrinter>(model, sentence_context, printer, latency);
+  }
 }
 
 } // namespace ngram
@@ -0,0 +1,102 @@
+#include "ngram_query.hh"
+
+#include "model.hh"
+#include "../util/file.hh"
+
+#define BOOST_TEST_MODULE NGramQueryTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include <unistd.h>
+
+namespace lm {
+namespace ngram {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+// Lines of known and unknown words, some empty.  The last line has no newline.
+std::string TestInput() {
+  const char *words[] = {"looking", "on", "a", "little", "more", "loin", "unknownword", "also", "would", "consider", "higher", "to", "look", "biarritz", "for", "."};
+  const unsigned int kWords = sizeof(words) / sizeof(const char*);
+  std::string input;
+  for (unsigned int line = 0; line < 500; ++line) {
+    for (unsigned int i = 0; i < (line * 7) % 13; ++i) {
+      if (i) input += ' ';
+      input += words[(line * 5 + i * 3) % kWords];
+    }
+    input += '\n';
+  }
+  input += "looking on a";
+  return input;
+}
+
+std::string ReadAll(int fd) {
+  std::string ret(util::SizeOrThrow(fd), 0);
+  util::SeekOrThrow(fd, 0);
+  util::ReadOrThrow(fd, &ret[0], ret.size());
+  return ret;
+}
+
+// Run one query with stdin redirected from input and return what it printed.
+template <class Function> std::string Capture(const std::string &input, Function function) {
+  util::scoped_fd in(util::MakeTemp("ngram_query_test_in"));
+  util::WriteOrThrow(in.get(), input.data(), input.size());
+  util::SeekOrThrow(in.get(), 0);
+  util::scoped_fd saved(util::DupOrThrow(0));
+  UTIL_THROW_IF(-1 == dup2(in.get(), 0), util::ErrnoException, "dup2 failed");
+  util::scoped_fd out(util::MakeTemp("ngram_query_test_out"));
+  {
+    QueryPrinter printer(out.get(), true, true, true, false);
+    function(printer);
+  }
+  UTIL_THROW_IF(-1 == dup2(saved.get(), 0), util::ErrnoException, "dup2 failed");
+  return ReadAll(out.get());
+}
+
+struct Serial {
+  Serial(const ProbingModel &model, bool sentence_context) : model_(model), sentence_context_(sentence_context) {}
+  void operator()(QueryPrinter &printer) const {
+    Query<ProbingModel, QueryPrinter>(model_, sentence_context_, printer);
+  }
+  const ProbingModel &model_;
+  bool sentence_context_;
+};
+
+#ifdef WITH_THREADS
+struct Parallel {
+  Parallel(const ProbingModel &model, bool sentence_context, std::size_t threads) : model_(model), sentence_context_(sentence_context), threads_(threads) {}
+  void operator()(QueryPrinter &printer) const {
+    // Small blocks so lines are spread over many blocks and threads.
+    ParallelQuery<ProbingModel>(model_, sentence_context_, printer, threads_, 64);
+  }
+  const ProbingModel &model_;
+  bool sentence_context_;
+  std::size_t threads_;
+};
+
+// Output, including the corpus totals in the summary, matches byte for byte.
+BOOST_AUTO_TEST_CASE(ThreadedMatchesSerial) {
+  Config config;
+  config.messages = NULL;
+  ProbingModel model(TestLocation(), config);
+  std::string input(TestInput());
+  for (int sentence_context = 0; sentence_context < 2; ++sentence_context) {
+    std::string expected(Capture(input, Serial(model, sentence_context)));
+    BOOST_REQUIRE(expected.find("Tokens:\t") != std::string::npos);
+    for (std::size_t threads = 1; threads <= 4; ++threads) {
+      BOOST_CHECK(expected == Capture(input, Parallel(model, sentence_context, threads)));
+    }
+  }
+}
+#endif // WITH_THREADS
+
+} // namespace
+} // namespace ngram
+} // namespace lm
@@ -10,12 +10,19 @@
 void Usage(const char *name) {
   std::cerr <<
     "KenLM was compiled with maximum order " << KENLM_MAX_ORDER << ".\n"
-    "Usage: " << name << " [-b] [-n] [-w] [-s] lm_file\n"
+    "Usage: " << name << " [-b] [-n] [-w] [-s] [-L] [-T trace] [-t threads] lm_file\n"
     "-b: Do not buffer output.\n"
     "-n: Do not wrap the input in <s> and </s>.\n"
     "-v summary|sentence|word: Print statistics at this level.\n"
     "   Can be used multiple times: -v summary -v sentence -v word\n"
-    "-l lazy|populate|read|parallel: Load lazily, with populate, or malloc+read\n"
+    "-l lazy|populate|read|parallel|prefetch|shared: Load lazily, with populate, or malloc+read.\n"
+    "   prefetch maps lazily and faults the model in from background threads.\n"
+    "   shared copies the model to shared memory once for all processes.\n"
+    "-L: Time each query and print word and sentence latency percentiles.\n"
+    "-T trace: Record queries to trace for kenlm_replay.  Binary models need a\n"
+    "   word table (build_binary -W).\n"
+    "-t threads: Score blocks of lines with this many threads.  Output is in input\n"
+    "   order and identical to single-threaded output.  Incompatible with -L and -T.\n"
     "The default loading method is populate on Linux and read on others.\n\n"
     "Each word in the output is formatted as:\n"
     "  word=vocab_id ngram_length log10(p(word|context))\n"
@@ -35,9 +42,12 @@ int main(int argc, char *argv[]) {
   bool print_line = false;
   bool print_summary = false;
   bool flush = false;
+  bool latency = false;
+  const char *trace = NULL;
+  std::size_t threads = 0;
 
   int opt;
-  while ((opt = getopt(argc, argv, "bnv:l:")) != -1) {
+  while ((opt = getopt(argc, argv, "bnv:l:LT:t:")) != -1) {
     switch (opt) {
       case 'b':
         flush = true;
@@ -77,16 +87,31 @@ int main(int argc, char *argv[]) {
           config.load_method = util::READ;
         } else if (!strcmp(optarg, "parallel")) {
           config.load_method = util::PARALLEL_READ;
+        } else if (!strcmp(optarg, "prefetch")) {
+          config.load_method = util::LAZY_PREFETCH;
+        } else if (!strcmp(optarg, "shared")) {
+          config.load_method = util::SHARED;
         } else {
           Usage(argv[0]);
         }
         break;
+      case 'L':
+        latency = true;
+        break;
+      case 'T':
+        trace = optarg;
+        config.word_table = true;
+        break;
+      case 't':
+        threads = strtoul(optarg, NULL, 10);
+        if (!threads) Usage(argv[0]);
+        break;
       case 'h':
       default:
         Usage(argv[0]);
     }
   }
-  if (optind + 1 != argc)
+  if (optind + 1 != argc || (threads && (latency || trace)))
     Usage(argv[0]);
   // No verbosity argument specified.
   if (!print_word && !print_line && !print_summary) {
@@ -103,22 +128,22 @@ int main(int argc, char *argv[]) {
       std::cerr << "This binary file contains " << lm::ngram::kModelNames[model_type] << "." << std::endl;
       switch(model_type) {
         case PROBING:
-          Query<lm::ngram::ProbingModel>(file, config, sentence_context, printer);
+          Query<lm::ngram::ProbingModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         case REST_PROBING:
-          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, printer);
+          Query<lm::ngram::RestProbingModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         case TRIE:
-          Query<TrieModel>(file, config, sentence_context, printer);
+          Query<TrieModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         case QUANT_TRIE:
-          Query<QuantTrieModel>(file, config, sentence_context, printer);
+          Query<QuantTrieModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         case ARRAY_TRIE:
-          Query<ArrayTrieModel>(file, config, sentence_context, printer);
+          Query<ArrayTrieModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         case QUANT_ARRAY_TRIE:
-          Query<QuantArrayTrieModel>(file, config, sentence_context, printer);
+          Query<QuantArrayTrieModel>(file, config, sentence_context, printer, latency, trace, threads);
           break;
         default:
           std::cerr << "Unrecognized kenlm model type " << model_type << std::endl;
@@ -127,11 +152,11 @@ int main(int argc, char *argv[]) {
 #ifdef WITH_NPLM
     } else if (lm::np::Model::Recognize(file)) {
       lm::np::Model model(file);
-      Query<lm::np::Model, lm::ngram::QueryPrinter>(model, sentence_context, printer);
-      Query<lm::np::Model, lm::ngram::QueryPrinter>(model, sentence_context, printer);
+      Query<lm::np::Model, lm::ngram::QueryPrinter>(model, sentence_context, printer, latency);
+      Query<lm::np::Model, lm::ngram::QueryPrinter>(model, sentence_context, printer, latency);
 #endif
     } else {
-      Query<ProbingModel>(file, config, sentence_context, printer);
+      Query<ProbingModel>(file, config, sentence_context, printer, latency, trace, threads);
     }
     util::PrintUsage(std::cerr);
   } catch (const std::exception &e) {
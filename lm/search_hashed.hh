@@ -82,6 +82,16 @@ template <class Value> class HashedSearch {
       return ret + Longest::Size(counts.back(), config.probing_multiplier);
     }
 
+    // Offset from the start of the search to the end of each order's table.
+    static void OrderEnds(const std::vector<uint64_t> &counts, const Config &config, std::vector<uint64_t> &ends) {
+      ends.resize(counts.size());
+      ends[0] = Unigram::Size(counts[0]);
+      for (unsigned char n = 1; n < counts.size() - 1; ++n) {
+        ends[n] = ends[n - 1] + Middle::Size(counts[n], config.probing_multiplier);
+      }
+      ends.back() = ends[counts.size() - 2] + Longest::Size(counts.back(), config.probing_multiplier);
+    }
+
     uint8_t *SetupMemory(uint8_t *start, const std::vector<uint64_t> &counts, const Config &config);
 
     void InitializeFromARPA(const char *file, util::FilePiece &f, const std::vector<uint64_t> &counts, const Config &config, ProbingVocabulary &vocab, BinaryFormat &backing);
@@ -53,6 +53,17 @@ template <class Quant, class Bhiksha> class TrieSearch {
       return ret + Longest::Size(Quant::LongestBits(config), counts.back(), counts[0]);
     }
 
+    // Offset from the start of the search to the end of each order's array.
+    // The quantization tables count as part of the unigrams.
+    static void OrderEnds(const std::vector<uint64_t> &counts, const Config &config, std::vector<uint64_t> &ends) {
+      ends.resize(counts.size());
+      ends[0] = Quant::Size(counts.size(), config) + Unigram::Size(counts[0]);
+      for (unsigned char i = 1; i < counts.size() - 1; ++i) {
+        ends[i] = ends[i - 1] + Middle::Size(Quant::MiddleBits(config), counts[i], counts[0], counts[i+1], config);
+      }
+      ends.back() = ends[counts.size() - 2] + Longest::Size(Quant::LongestBits(config), counts.back(), counts[0]);
+    }
+
     TrieSearch() : middle_begin_(NULL), middle_end_(NULL) {}
 
     ~TrieSearch() { FreeMiddles(); }
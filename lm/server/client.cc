@@ -0,0 +1,56 @@
+#include "client.hh"
+
+#include "../../util/exception.hh"
+#include "../../util/file.hh"
+
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace lm {
+namespace server {
+
+Client::Client(const char *socket_path) : next_id_(0) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  UTIL_THROW_IF(strlen(socket_path) >= sizeof(address.sun_path), util::Exception, "Socket path " << socket_path << " is too long.");
+  strcpy(address.sun_path, socket_path);
+  fd_.reset(socket(AF_UNIX, SOCK_STREAM, 0));
+  UTIL_THROW_IF(fd_.get() == -1, util::ErrnoException, "Could not create a socket");
+  UTIL_THROW_IF(connect(fd_.get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)), util::ErrnoException, "Could not connect to " << socket_path);
+}
+
+void Client::Send(uint32_t id, const StringPiece &sentence, uint8_t flags) {
+  UTIL_THROW_IF(kRequestHeader + sentence.size() > kMaxRequest, util::Exception, "Sentence of " << sentence.size() << " bytes is too long for the server.");
+  AppendRequest(id, flags, sentence.data(), sentence.size(), buffer_);
+}
+
+void Client::Flush() {
+  if (buffer_.empty()) return;
+  util::WriteOrThrow(fd_.get(), buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void Client::CloseWrite() {
+  Flush();
+  UTIL_THROW_IF(shutdown(fd_.get(), SHUT_WR), util::ErrnoException, "Could not shut down writing to the server");
+}
+
+void Client::Receive(Response &out) {
+  Flush();
+  util::ReadOrThrow(fd_.get(), &out, sizeof(Response));
+}
+
+Response Client::Score(const StringPiece &sentence, uint8_t flags) {
+  Send(next_id_, sentence, flags);
+  Response ret;
+  Receive(ret);
+  UTIL_THROW_IF(ret.id != next_id_, util::Exception, "Expected response " << next_id_ << " but got " << ret.id << ".  Are there other requests outstanding?");
+  ++next_id_;
+  return ret;
+}
+
+} // namespace server
+} // namespace lm
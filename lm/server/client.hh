@@ -0,0 +1,49 @@
+#ifndef LM_SERVER_CLIENT_H
+#define LM_SERVER_CLIENT_H
+
+#include "protocol.hh"
+#include "../../util/file.hh"
+#include "../../util/string_piece.hh"
+
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+namespace server {
+
+/* Connection to kenlm_server.  Not thread safe; use one per thread.  Send
+ * buffers requests so several can go out in one write, which Flush or
+ * Receive does.
+ */
+class Client {
+  public:
+    explicit Client(const char *socket_path);
+
+    void Send(uint32_t id, const StringPiece &sentence, uint8_t flags = kBeginSentence | kEndSentence);
+
+    void Flush();
+
+    // Flush and tell the server no more requests are coming.  Responses to
+    // the requests already sent can still be received.
+    void CloseWrite();
+
+    // Block for the next response, flushing first.
+    void Receive(Response &out);
+
+    // Send one sentence and wait for its score.  Do not mix with outstanding
+    // Sends on the same connection.
+    Response Score(const StringPiece &sentence, uint8_t flags = kBeginSentence | kEndSentence);
+
+  private:
+    util::scoped_fd fd_;
+
+    std::string buffer_;
+
+    uint32_t next_id_;
+};
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_CLIENT_H
@@ -0,0 +1,151 @@
+#include "client.hh"
+#include "../../util/file_piece.hh"
+#include "../../util/file_stream.hh"
+#include "../../util/latency_histogram.hh"
+#include "../../util/usage.hh"
+
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace {
+
+struct Result {
+  Result() : failed(false), log_prob(0.0), oovs(0) {}
+  util::LatencyHistogram latency;
+  bool failed;
+  std::string error;
+  double log_prob;
+  uint64_t oovs;
+};
+
+// One connection keeping up to depth requests outstanding.
+class Connection {
+  public:
+    Connection(const std::string &socket, const std::vector<std::string> &corpus, uint64_t offset, uint64_t requests, unsigned int depth, Result &result)
+      : socket_(socket), corpus_(corpus), offset_(offset), requests_(requests), depth_(depth), result_(result) {}
+
+    void operator()() {
+      try {
+        Run();
+      } catch (const std::exception &e) {
+        result_.failed = true;
+        result_.error = e.what();
+      }
+    }
+
+  private:
+    void Run() {
+      lm::server::Client client(socket_.c_str());
+      std::vector<uint64_t> sent(requests_);
+      uint64_t next = 0;
+      lm::server::Response response;
+      for (uint64_t received = 0; received < requests_; ++received) {
+        for (; next < requests_ && next - received < depth_; ++next) {
+          sent[next] = util::LatencyClock();
+          client.Send(static_cast<uint32_t>(next), corpus_[(offset_ + next) % corpus_.size()]);
+        }
+        client.Receive(response);
+        result_.latency.Add(util::LatencyClock() - sent[response.id]);
+        result_.log_prob += response.log_prob;
+        result_.oovs += response.oovs;
+      }
+    }
+
+    const std::string &socket_;
+    const std::vector<std::string> &corpus_;
+    uint64_t offset_, requests_;
+    unsigned int depth_;
+    Result &result_;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    std::string socket, corpus_file;
+    unsigned int connections, depth;
+    uint64_t requests;
+    namespace po = boost::program_options;
+    po::options_description options("Load generator options");
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("socket,s", po::value<std::string>(&socket)->required(), "Socket kenlm_server listens on")
+      ("input,i", po::value<std::string>(&corpus_file)->required(), "Sentences to send, one per line")
+      ("connections,c", po::value<unsigned int>(&connections)->default_value(4), "Concurrent connections, each in its own thread")
+      ("depth,p", po::value<unsigned int>(&depth)->default_value(1), "Requests each connection keeps outstanding")
+      ("requests,n", po::value<uint64_t>(&requests)->default_value(0), "Requests per connection.  Default: one pass over the input");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr << "Send sentences to kenlm_server from several connections and report throughput\n"
+        "and latency percentiles.\n"
+        << argv[0] << " -s /tmp/kenlm.sock -i corpus.txt -c 8 -p 4\n"
+        << options << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+    if (!connections || !depth) {
+      std::cerr << "Specify at least one connection and a positive depth." << std::endl;
+      return 1;
+    }
+
+    std::vector<std::string> corpus;
+    {
+      util::FilePiece in(corpus_file.c_str());
+      StringPiece line;
+      while (in.ReadLineOrEOF(line)) corpus.push_back(std::string(line.data(), line.size()));
+    }
+    if (corpus.empty()) {
+      std::cerr << "No sentences in " << corpus_file << std::endl;
+      return 1;
+    }
+    if (!requests) requests = corpus.size();
+    if (requests > 0xffffffffULL) {
+      std::cerr << "Request ids are 32-bit, so send at most 2^32 - 1 requests per connection." << std::endl;
+      return 1;
+    }
+
+    // Failed writes throw instead of killing the process.
+    signal(SIGPIPE, SIG_IGN);
+    std::vector<Result> results(connections);
+    double wall = util::WallTime();
+    boost::thread_group threads;
+    for (unsigned int i = 0; i < connections; ++i) {
+      // Stagger starting points so connections send different sentences.
+      threads.create_thread(Connection(socket, corpus, i * corpus.size() / connections, requests, depth, results[i]));
+    }
+    threads.join_all();
+    wall = util::WallTime() - wall;
+
+    util::LatencyHistogram latency;
+    double log_prob = 0.0;
+    uint64_t oovs = 0;
+    for (std::vector<Result>::const_iterator i = results.begin(); i != results.end(); ++i) {
+      if (i->failed) {
+        std::cerr << "Connection " << (i - results.begin()) << " failed: " << i->error << std::endl;
+        return 1;
+      }
+      latency.Merge(i->latency);
+      log_prob += i->log_prob;
+      oovs += i->oovs;
+    }
+    util::FileStream out(1);
+    out << "Requests: " << latency.Count()
+      << " Seconds: " << wall
+      << " Requests/s: " << (static_cast<double>(latency.Count()) / wall)
+      << " Log10 probability sum: " << log_prob
+      << " OOVs: " << oovs << '\n';
+    latency.Print("Request", out);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
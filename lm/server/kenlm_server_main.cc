@@ -0,0 +1,85 @@
+#include "server.hh"
+#include "../model.hh"
+#include "../../util/usage.hh"
+
+#include <boost/program_options.hpp>
+
+#include <csignal>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+
+lm::server::Server *running = NULL;
+
+extern "C" void StopRunning(int) {
+  if (running) running->Stop();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    lm::server::ServerConfig config;
+    std::string model_file, load;
+    namespace po = boost::program_options;
+    po::options_description options("Server options");
+    options.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("model,m", po::value<std::string>(&model_file)->required(), "Language model")
+      ("socket,s", po::value<std::string>(&config.socket)->required(), "Unix domain socket to listen on")
+      ("threads,t", po::value<unsigned int>(&config.threads)->default_value(config.threads), "Worker threads that score")
+      ("batch,b", po::value<std::size_t>(&config.batch)->default_value(config.batch), "Most requests in a batch")
+      ("delay,d", po::value<unsigned int>(&config.delay)->default_value(config.delay), "Microseconds to wait for a batch to fill")
+      ("queue,q", po::value<std::size_t>(&config.max_queued)->default_value(config.max_queued), "Stop reading from clients when this many requests are queued")
+      ("load,l", po::value<std::string>(&load)->default_value("populate"), "How to load a binary model: lazy, populate, read, prefetch, or shared");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    if (argc == 1 || vm["help"].as<bool>()) {
+      std::cerr << "Score sentences for clients on a Unix domain socket.  See lm/server/protocol.hh\n"
+        "for the wire format and lm/server/client.hh for a client.  SIGINT or SIGTERM\n"
+        "stops the server after answering queued requests.\n"
+        << argv[0] << " -m model.binary -s /tmp/kenlm.sock\n"
+        << options << std::endl;
+      return 1;
+    }
+    po::notify(vm);
+
+    lm::ngram::Config model_config;
+    if (load == "lazy") {
+      model_config.load_method = util::LAZY;
+    } else if (load == "populate") {
+      model_config.load_method = util::POPULATE_OR_READ;
+    } else if (load == "read") {
+      model_config.load_method = util::READ;
+    } else if (load == "prefetch") {
+      model_config.load_method = util::LAZY_PREFETCH;
+    } else if (load == "shared") {
+      model_config.load_method = util::SHARED;
+    } else {
+      std::cerr << "Unknown load method " << load << std::endl;
+      return 1;
+    }
+    std::unique_ptr<lm::base::Model> model(lm::ngram::LoadVirtual(model_file.c_str(), model_config));
+
+    lm::server::Server server(*model, config);
+    running = &server;
+    signal(SIGINT, StopRunning);
+    signal(SIGTERM, StopRunning);
+    std::cerr << "Listening on " << config.socket << std::endl;
+    server.Run();
+    running = NULL;
+
+    lm::server::ServerStats stats(server.Stats());
+    std::cerr << "Connections: " << stats.connections
+      << " Requests: " << stats.requests
+      << " Batches: " << stats.batches
+      << " Mean batch: " << (stats.batches ? static_cast<double>(stats.requests) / static_cast<double>(stats.batches) : 0.0) << '\n';
+    util::PrintUsage(std::cerr);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
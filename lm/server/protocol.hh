@@ -0,0 +1,56 @@
+#ifndef LM_SERVER_PROTOCOL_H
+#define LM_SERVER_PROTOCOL_H
+
+/* Wire format between kenlm_server and its clients over a Unix domain socket.
+ * Both ends are on the same host so integers and floats are in host order.
+ *
+ * Request:  uint32_t size of what follows
+ *           uint32_t id chosen by the client
+ *           uint8_t  flags (kBeginSentence, kEndSentence)
+ *           size - 5 bytes of text, words separated by spaces
+ * Response: Response below, 16 bytes.
+ *
+ * A client may send many requests before reading responses.  Requests from
+ * one connection can be scored in different batches, so responses may arrive
+ * in any order; match them with the id.
+ */
+
+#include <cstring>
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+namespace server {
+
+const uint8_t kBeginSentence = 1;
+const uint8_t kEndSentence = 2;
+
+// Bytes after the size field: id and flags.
+const std::size_t kRequestHeader = sizeof(uint32_t) + sizeof(uint8_t);
+
+// Larger requests close the connection.
+const uint32_t kMaxRequest = 1 << 20;
+
+struct Response {
+  uint32_t id;
+  // log10 probability of the words, and </s> with kEndSentence.
+  float log_prob;
+  // Words that were <unk>.
+  uint32_t oovs;
+  // Words scored, including </s> with kEndSentence.
+  uint32_t words;
+};
+
+inline void AppendRequest(uint32_t id, uint8_t flags, const char *text, std::size_t length, std::string &to) {
+  uint32_t size = static_cast<uint32_t>(kRequestHeader + length);
+  to.append(reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+  to.append(reinterpret_cast<const char*>(&id), sizeof(uint32_t));
+  to.push_back(static_cast<char>(flags));
+  to.append(text, length);
+}
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_PROTOCOL_H
@@ -0,0 +1,436 @@
+#include "server.hh"
+
+#include "../../util/exception.hh"
+#include "../../util/spaces.hh"
+#include "../../util/tokenize_piece.hh"
+
+#include <boost/thread/thread_time.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace lm {
+namespace server {
+
+namespace {
+// Stop reading requests from a client with this many bytes of responses it
+// has not read yet.
+const std::size_t kMaxBacklog = 1 << 20;
+// When the server is stopping, give up on a client that takes no responses
+// for this many milliseconds.
+const int kStopTimeout = 5000;
+} // namespace
+
+/* Responses are appended to a buffer and sent without blocking, so workers
+ * never wait for a slow client.  Whatever the socket does not take is sent by
+ * the connection's own thread when poll says the socket is writable.
+ */
+class Connection {
+  public:
+    explicit Connection(int fd) : fd_(fd), sent_(0), outstanding_(0), draining_(false), broken_(false), stopping_(false) {
+      int pipes[2];
+      UTIL_THROW_IF(pipe(pipes), util::ErrnoException, "Could not create a pipe");
+      wake_read_.reset(pipes[0]);
+      wake_write_.reset(pipes[1]);
+      for (int i = 0; i < 2; ++i) {
+        UTIL_THROW_IF(fcntl(pipes[i], F_SETFL, fcntl(pipes[i], F_GETFL) | O_NONBLOCK) == -1, util::ErrnoException, "Could not make a pipe non-blocking");
+      }
+    }
+
+    int Get() const { return fd_.get(); }
+
+    // The connection thread queued this many requests.
+    void Expect(std::size_t count) {
+      boost::mutex::scoped_lock lock(mutex_);
+      outstanding_ += count;
+    }
+
+    // Called by workers.  Never blocks on the client.  Drops the responses if
+    // the client went away.
+    void Write(const Response *responses, std::size_t count) {
+      boost::mutex::scoped_lock lock(mutex_);
+      outstanding_ -= count;
+      if (broken_) return;
+      const bool was_pending = Pending();
+      out_.append(reinterpret_cast<const char*>(responses), count * sizeof(Response));
+      Flush();
+      // Wake the connection thread if it should start polling for writability
+      // or it was waiting for the last response before closing.
+      if ((Pending() && !was_pending) || (draining_ && !outstanding_)) Wake();
+    }
+
+    /* Called by the connection thread.  Send buffered responses as the socket
+     * allows until it is readable, if read_requests is set and the server is
+     * not stopping.  Returns false when the connection is done: the client
+     * went away, or no more requests will be read and every response has
+     * been sent.
+     */
+    bool Wait(bool read_requests) {
+      while (true) {
+        bool reading;
+        short write_event;
+        int timeout;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          draining_ = !read_requests || stopping_;
+          Flush();
+          if (broken_) return false;
+          if (draining_ && !outstanding_ && !Pending()) return false;
+          // Backpressure: a client that does not read responses stops being read.
+          reading = !draining_ && out_.size() - sent_ < kMaxBacklog;
+          write_event = Pending() ? POLLOUT : 0;
+          // Workers always finish what is queued, but a client might never read.
+          timeout = (stopping_ && write_event) ? kStopTimeout : -1;
+        }
+        pollfd watch[2];
+        watch[0].fd = fd_.get();
+        watch[0].events = (reading ? POLLIN : 0) | write_event;
+        watch[1].fd = wake_read_.get();
+        watch[1].events = POLLIN;
+        int ready = poll(watch, 2, timeout);
+        if (ready == -1) {
+          if (errno == EINTR) continue;
+          return Break();
+        }
+        if (!ready) return Break();
+        if (watch[1].revents) {
+          char drain[64];
+          while (read(wake_read_.get(), drain, sizeof(drain)) > 0) {}
+        }
+        if (watch[0].revents & POLLIN) return true;
+        // Hung up while we were not reading, so nobody will take the responses.
+        if (watch[0].revents & (POLLERR | POLLHUP | POLLNVAL)) return Break();
+      }
+    }
+
+    // Stop reading requests.  The connection thread exits once the requests
+    // it already queued are answered and sent.
+    void Shutdown() {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+      Wake();
+    }
+
+  private:
+    bool Pending() const { return sent_ != out_.size(); }
+
+    // Give up on the client.  Returns false for Wait.
+    bool Break() {
+      boost::mutex::scoped_lock lock(mutex_);
+      broken_ = true;
+      return false;
+    }
+
+    // Send as much as the socket takes without blocking.  Hold mutex_.
+    void Flush() {
+      while (Pending() && !broken_) {
+        ssize_t ret = send(fd_.get(), out_.data() + sent_, out_.size() - sent_, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret == -1) {
+          if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+          if (errno != EINTR) broken_ = true;
+          continue;
+        }
+        sent_ += ret;
+      }
+      if (!Pending()) {
+        out_.clear();
+        sent_ = 0;
+      } else if (sent_ >= out_.size() / 2) {
+        out_.erase(0, sent_);
+        sent_ = 0;
+      }
+    }
+
+    void Wake() {
+      char byte = 0;
+      // A full pipe already wakes the thread.
+      ssize_t ignored = write(wake_write_.get(), &byte, 1);
+      (void)ignored;
+    }
+
+    util::scoped_fd fd_;
+    util::scoped_fd wake_read_, wake_write_;
+
+    boost::mutex mutex_;
+    // Responses not yet taken by the socket start at out_[sent_].
+    std::string out_;
+    std::size_t sent_;
+    // Requests queued but not answered.
+    std::size_t outstanding_;
+    // The connection thread stopped reading and is waiting to send the rest.
+    bool draining_;
+    bool broken_;
+    // Set by Shutdown.
+    bool stopping_;
+};
+
+ServerConfig::ServerConfig() : threads(2), batch(64), delay(100), max_queued(65536) {}
+
+Server::Server(const base::Model &model, const ServerConfig &config)
+  : model_(model), config_(config), stopping_(false), connection_threads_(0),
+    connection_count_(0), request_count_(0), batch_count_(0) {
+  UTIL_THROW_IF(!config.threads, util::Exception, "The server needs at least one worker thread.");
+  UTIL_THROW_IF(!config.batch, util::Exception, "Batches must hold at least one request.");
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  UTIL_THROW_IF(config.socket.size() >= sizeof(address.sun_path), util::Exception, "Socket path " << config.socket << " is too long.");
+  strcpy(address.sun_path, config.socket.c_str());
+
+  listen_.reset(socket(AF_UNIX, SOCK_STREAM, 0));
+  UTIL_THROW_IF(listen_.get() == -1, util::ErrnoException, "Could not create a socket");
+  UTIL_THROW_IF(unlink(config.socket.c_str()) && errno != ENOENT, util::ErrnoException, "Could not replace " << config.socket);
+  UTIL_THROW_IF(bind(listen_.get(), reinterpret_cast<sockaddr*>(&address), sizeof(address)), util::ErrnoException, "Could not bind to " << config.socket);
+  UTIL_THROW_IF(listen(listen_.get(), SOMAXCONN), util::ErrnoException, "Could not listen on " << config.socket);
+
+  int pipes[2];
+  UTIL_THROW_IF(pipe(pipes), util::ErrnoException, "Could not create a pipe");
+  stop_read_.reset(pipes[0]);
+  stop_write_.reset(pipes[1]);
+}
+
+Server::~Server() {
+  unlink(config_.socket.c_str());
+}
+
+void Server::Run() {
+  for (unsigned int i = 0; i < config_.threads; ++i) {
+    workers_.add_thread(new boost::thread(&Server::Work, this));
+  }
+  pollfd watch[2];
+  watch[0].fd = stop_read_.get();
+  watch[1].fd = listen_.get();
+  watch[0].events = watch[1].events = POLLIN;
+  while (true) {
+    if (poll(watch, 2, -1) == -1) {
+      UTIL_THROW_IF(errno != EINTR, util::ErrnoException, "poll failed");
+      continue;
+    }
+    if (watch[0].revents) break;
+    if (!watch[1].revents) continue;
+    int fd = accept(listen_.get(), NULL, NULL);
+    if (fd == -1) {
+      // Includes running out of file descriptors; keep serving existing clients.
+      if (errno != EINTR && errno != ECONNABORTED) std::cerr << "accept failed: " << strerror(errno) << std::endl;
+      continue;
+    }
+    std::shared_ptr<Connection> connection(new Connection(fd));
+    {
+      boost::mutex::scoped_lock lock(connections_mutex_);
+      std::vector<std::weak_ptr<Connection> >::iterator out = connections_.begin();
+      for (std::vector<std::weak_ptr<Connection> >::iterator i = connections_.begin(); i != connections_.end(); ++i) {
+        if (!i->expired()) *out++ = *i;
+      }
+      connections_.erase(out, connections_.end());
+      connections_.push_back(connection);
+      ++connection_threads_;
+    }
+    ++connection_count_;
+    boost::thread(&Server::Read, this, connection).detach();
+  }
+
+  // Stop reading, answer what was already queued, then stop the workers.
+  {
+    boost::mutex::scoped_lock lock(connections_mutex_);
+    for (std::vector<std::weak_ptr<Connection> >::iterator i = connections_.begin(); i != connections_.end(); ++i) {
+      std::shared_ptr<Connection> live(i->lock());
+      if (live) live->Shutdown();
+    }
+    while (connection_threads_) connections_done_.wait(lock);
+  }
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    stopping_ = true;
+  }
+  not_empty_.notify_all();
+  workers_.join_all();
+}
+
+void Server::Stop() {
+  char byte = 0;
+  // Only async-signal-safe calls here.
+  ssize_t ignored = write(stop_write_.get(), &byte, 1);
+  (void)ignored;
+}
+
+ServerStats Server::Stats() const {
+  ServerStats ret;
+  ret.connections = connection_count_.load();
+  ret.requests = request_count_.load();
+  ret.batches = batch_count_.load();
+  return ret;
+}
+
+void Server::Enqueue(std::deque<Pending> &requests) {
+  {
+    boost::mutex::scoped_lock lock(queue_mutex_);
+    while (queue_.size() >= config_.max_queued) not_full_.wait(lock);
+    for (std::deque<Pending>::iterator i = requests.begin(); i != requests.end(); ++i) {
+      queue_.push_back(Pending());
+      std::swap(queue_.back(), *i);
+    }
+  }
+  if (requests.size() == 1) {
+    not_empty_.notify_one();
+  } else {
+    not_empty_.notify_all();
+  }
+  requests.clear();
+}
+
+void Server::Read(std::shared_ptr<Connection> connection) {
+  std::vector<char> buffer(65536);
+  std::size_t filled = 0;
+  std::deque<Pending> parsed;
+  // After the client stops sending, keep going until it has every response.
+  bool reading = true;
+  while (connection->Wait(reading)) {
+    ssize_t got = read(connection->Get(), &buffer[filled], buffer.size() - filled);
+    if (got == -1 && errno == EINTR) continue;
+    if (got <= 0) {
+      reading = false;
+      continue;
+    }
+    filled += got;
+    // Parse every complete request so they are queued under one lock.
+    std::size_t consumed = 0, need = 0;
+    bool bad = false;
+    while (filled - consumed >= sizeof(uint32_t)) {
+      const char *at = &buffer[0] + consumed;
+      uint32_t size;
+      memcpy(&size, at, sizeof(uint32_t));
+      if (size < kRequestHeader || size > kMaxRequest) {
+        bad = true;
+        break;
+      }
+      if (filled - consumed < sizeof(uint32_t) + size) {
+        need = sizeof(uint32_t) + size;
+        break;
+      }
+      at += sizeof(uint32_t);
+      parsed.push_back(Pending());
+      Pending &request = parsed.back();
+      request.connection = connection;
+      memcpy(&request.id, at, sizeof(uint32_t));
+      request.flags = static_cast<uint8_t>(at[sizeof(uint32_t)]);
+      request.text.assign(at + kRequestHeader, size - kRequestHeader);
+      consumed += sizeof(uint32_t) + size;
+    }
+    if (!parsed.empty()) {
+      connection->Expect(parsed.size());
+      Enqueue(parsed);
+    }
+    // Answer what parsed, then close.
+    if (bad) {
+      reading = false;
+      continue;
+    }
+    filled -= consumed;
+    memmove(&buffer[0], &buffer[0] + consumed, filled);
+    if (need > buffer.size()) buffer.resize(need);
+  }
+  connection.reset();
+  boost::mutex::scoped_lock lock(connections_mutex_);
+  --connection_threads_;
+  connections_done_.notify_all();
+}
+
+void Server::Score(const Pending &request, std::vector<char> &states, Response &out) const {
+  const base::Vocabulary &vocab = model_.BaseVocabulary();
+  void *in_state = &states[0];
+  void *out_state = &states[model_.StateSize()];
+  if (request.flags & kBeginSentence) {
+    model_.BeginSentenceWrite(in_state);
+  } else {
+    model_.NullContextWrite(in_state);
+  }
+  out.id = request.id;
+  out.log_prob = 0.0;
+  out.oovs = 0;
+  out.words = 0;
+  for (util::TokenIter<util::BoolCharacter, true> i(request.text, util::kSpaces); i; ++i) {
+    WordIndex word = vocab.Index(*i);
+    out.oovs += (word == vocab.NotFound());
+    out.log_prob += model_.BaseScore(in_state, word, out_state);
+    std::swap(in_state, out_state);
+    ++out.words;
+  }
+  if (request.flags & kEndSentence) {
+    out.log_prob += model_.BaseScore(in_state, vocab.EndSentence(), out_state);
+    ++out.words;
+  }
+}
+
+namespace {
+struct ByConnection {
+  ByConnection(const std::vector<std::shared_ptr<Connection> > &connections) : connections_(connections) {}
+  bool operator()(std::size_t left, std::size_t right) const {
+    return connections_[left].get() < connections_[right].get();
+  }
+  const std::vector<std::shared_ptr<Connection> > &connections_;
+};
+} // namespace
+
+void Server::Work() {
+  std::vector<Pending> batch;
+  std::vector<char> states(2 * model_.StateSize());
+  std::vector<Response> responses, run;
+  std::vector<std::shared_ptr<Connection> > connections;
+  std::vector<std::size_t> order;
+  while (true) {
+    {
+      boost::mutex::scoped_lock lock(queue_mutex_);
+      while (queue_.empty() && !stopping_) not_empty_.wait(lock);
+      if (queue_.empty()) return;
+      if (config_.delay && queue_.size() < config_.batch && !stopping_) {
+        const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds(config_.delay);
+        while (queue_.size() < config_.batch && !stopping_ && not_empty_.timed_wait(lock, deadline)) {}
+        // Another worker may have taken everything.
+        if (queue_.empty()) continue;
+      }
+      std::size_t take = std::min(config_.batch, queue_.size());
+      batch.resize(take);
+      for (std::size_t i = 0; i < take; ++i) {
+        std::swap(batch[i], queue_.front());
+        queue_.pop_front();
+      }
+    }
+    not_full_.notify_all();
+    ++batch_count_;
+    request_count_ += batch.size();
+
+    responses.resize(batch.size());
+    connections.resize(batch.size());
+    order.resize(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      Score(batch[i], states, responses[i]);
+      connections[i].swap(batch[i].connection);
+      order[i] = i;
+    }
+    batch.clear();
+    // One write per connection.
+    std::sort(order.begin(), order.end(), ByConnection(connections));
+    for (std::size_t begin = 0; begin < order.size();) {
+      Connection *connection = connections[order[begin]].get();
+      run.clear();
+      std::size_t end = begin;
+      for (; end < order.size() && connections[order[end]].get() == connection; ++end) {
+        run.push_back(responses[order[end]]);
+      }
+      connection->Write(&run[0], run.size());
+      begin = end;
+    }
+    connections.clear();
+  }
+}
+
+} // namespace server
+} // namespace lm
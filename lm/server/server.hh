@@ -0,0 +1,122 @@
+#ifndef LM_SERVER_SERVER_H
+#define LM_SERVER_SERVER_H
+
+/* Score sentences for clients on a Unix domain socket.  A thread per
+ * connection parses requests and queues them.  Workers take up to batch
+ * requests at a time, waiting up to delay for a batch to fill, score them,
+ * and write each connection's responses in one call.  Coalescing amortizes
+ * wakeups and system calls when many clients send at once, while delay bounds
+ * the latency it adds when load is light.  Writes never block a worker: what
+ * the socket does not take is buffered and sent by the connection thread, which
+ * stops reading requests from a client that falls too far behind.
+ */
+
+#include "protocol.hh"
+#include "../virtual_interface.hh"
+#include "../../util/file.hh"
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+namespace server {
+
+struct ServerConfig {
+  ServerConfig();
+
+  // Path of the socket.  An existing file there is replaced.
+  std::string socket;
+
+  // Worker threads that score.
+  unsigned int threads;
+
+  // Most requests in a batch.
+  std::size_t batch;
+
+  // How long a worker waits for a batch to fill, in microseconds.  0 takes
+  // whatever is queued.
+  unsigned int delay;
+
+  // Connection threads block when this many requests are queued.
+  std::size_t max_queued;
+};
+
+struct ServerStats {
+  uint64_t connections;
+  uint64_t requests;
+  uint64_t batches;
+};
+
+class Connection;
+
+class Server {
+  public:
+    // Creates the socket, so clients can connect once this returns.  The
+    // model must outlive the server.
+    Server(const base::Model &model, const ServerConfig &config);
+
+    // Removes the socket.  Stop and wait for Run to return first.
+    ~Server();
+
+    // Accept connections until Stop.  Then stop reading requests and return
+    // once every request already read has been answered.
+    void Run();
+
+    // Safe to call from other threads and signal handlers.
+    void Stop();
+
+    ServerStats Stats() const;
+
+  private:
+    struct Pending {
+      std::shared_ptr<Connection> connection;
+      uint32_t id;
+      uint8_t flags;
+      std::string text;
+    };
+
+    friend class Connection;
+
+    // Called by connection threads.
+    void Enqueue(std::deque<Pending> &requests);
+    void Read(std::shared_ptr<Connection> connection);
+
+    void Work();
+
+    void Score(const Pending &request, std::vector<char> &states, Response &out) const;
+
+    const base::Model &model_;
+    const ServerConfig config_;
+
+    util::scoped_fd listen_;
+    // Stop writes to stop_write_ so Run wakes up.
+    util::scoped_fd stop_read_, stop_write_;
+
+    boost::mutex queue_mutex_;
+    boost::condition_variable not_empty_, not_full_;
+    std::deque<Pending> queue_;
+    bool stopping_;
+
+    // Live connections so Run can shut them down when stopping.
+    boost::mutex connections_mutex_;
+    boost::condition_variable connections_done_;
+    std::vector<std::weak_ptr<Connection> > connections_;
+    std::size_t connection_threads_;
+
+    boost::thread_group workers_;
+
+    std::atomic<uint64_t> connection_count_, request_count_, batch_count_;
+};
+
+} // namespace server
+} // namespace lm
+
+#endif // LM_SERVER_SERVER_H
@@ -0,0 +1,203 @@
+#include "server.hh"
+
+#include "client.hh"
+#include "../model.hh"
+#include "../../util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE ServerTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lm {
+namespace server {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "../test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+const char *kSentences[] = {
+  "looking on a little more loin",
+  "also would consider higher to look good",
+  "biarritz unknownword",
+  "",
+};
+
+// Score directly to compare with the server.
+float Direct(const ngram::ProbingModel &model, const char *sentence, bool begin, bool end, uint32_t &oovs) {
+  ngram::State state(begin ? model.BeginSentenceState() : model.NullContextState()), out;
+  float ret = 0.0;
+  oovs = 0;
+  for (util::TokenIter<util::SingleCharacter, true> word(sentence, ' '); word; ++word) {
+    WordIndex index = model.GetVocabulary().Index(*word);
+    oovs += (index == 0);
+    ret += model.FullScore(state, index, out).prob;
+    state = out;
+  }
+  if (end) ret += model.FullScore(state, model.GetVocabulary().EndSentence(), out).prob;
+  return ret;
+}
+
+class Running {
+  public:
+    Running(const ngram::ProbingModel &model, const ServerConfig &config) : server_(model, config), thread_(&Server::Run, &server_) {}
+
+    ~Running() {
+      server_.Stop();
+      thread_.join();
+    }
+
+    Server &Get() { return server_; }
+
+  private:
+    Server server_;
+    boost::thread thread_;
+};
+
+ServerConfig TestConfig() {
+  ServerConfig config;
+  config.socket = "server_test.sock";
+  config.batch = 8;
+  config.delay = 1000;
+  return config;
+}
+
+BOOST_AUTO_TEST_CASE(MatchesModel) {
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(TestLocation(), model_config);
+  Running server(model, TestConfig());
+  Client client("server_test.sock");
+  for (std::size_t i = 0; i < sizeof(kSentences) / sizeof(const char*); ++i) {
+    for (uint8_t flags = 0; flags < 4; ++flags) {
+      uint32_t oovs;
+      float expected = Direct(model, kSentences[i], flags & kBeginSentence, flags & kEndSentence, oovs);
+      Response response(client.Score(kSentences[i], flags));
+      BOOST_CHECK_CLOSE(expected, response.log_prob, 0.001);
+      BOOST_CHECK_EQUAL(oovs, response.oovs);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Pipelined) {
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(TestLocation(), model_config);
+  Running server(model, TestConfig());
+  const std::size_t kSentenceCount = sizeof(kSentences) / sizeof(const char*);
+  std::vector<float> expected(kSentenceCount);
+  for (std::size_t i = 0; i < kSentenceCount; ++i) {
+    uint32_t oovs;
+    expected[i] = Direct(model, kSentences[i], true, true, oovs);
+  }
+
+  // Two connections with many requests outstanding.
+  const uint32_t kRequests = 100;
+  Client first("server_test.sock"), second("server_test.sock");
+  for (uint32_t id = 0; id < kRequests; ++id) {
+    first.Send(id, kSentences[id % kSentenceCount]);
+    second.Send(id, kSentences[(id + 1) % kSentenceCount]);
+  }
+  first.Flush();
+  second.Flush();
+  std::vector<bool> seen(kRequests);
+  for (uint32_t i = 0; i < kRequests; ++i) {
+    Response response;
+    first.Receive(response);
+    BOOST_REQUIRE(response.id < kRequests);
+    BOOST_CHECK(!seen[response.id]);
+    seen[response.id] = true;
+    BOOST_CHECK_CLOSE(expected[response.id % kSentenceCount], response.log_prob, 0.001);
+    second.Receive(response);
+    BOOST_CHECK_CLOSE(expected[(response.id + 1) % kSentenceCount], response.log_prob, 0.001);
+  }
+  ServerStats stats(server.Get().Stats());
+  BOOST_CHECK_EQUAL(2U, stats.connections);
+  BOOST_CHECK_EQUAL(2 * kRequests, stats.requests);
+  // Requests were coalesced.
+  BOOST_CHECK(stats.batches < stats.requests);
+}
+
+BOOST_AUTO_TEST_CASE(SlowClient) {
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(TestLocation(), model_config);
+  Running server(model, TestConfig());
+  // More responses than the socket holds, but less than the backlog that
+  // stops the server reading requests, so Flush returns.
+  const uint32_t kRequests = 40000;
+  Client slow("server_test.sock");
+  for (uint32_t id = 0; id < kRequests; ++id) {
+    slow.Send(id, "");
+  }
+  slow.Flush();
+  // Workers must not be stuck writing to the client that does not read.
+  Client fast("server_test.sock");
+  for (std::size_t i = 0; i < 100; ++i) {
+    uint32_t oovs;
+    float expected = Direct(model, kSentences[0], true, true, oovs);
+    BOOST_CHECK_CLOSE(expected, fast.Score(kSentences[0]).log_prob, 0.001);
+  }
+  // The slow client still gets everything.
+  std::vector<bool> seen(kRequests);
+  for (uint32_t i = 0; i < kRequests; ++i) {
+    Response response;
+    slow.Receive(response);
+    BOOST_REQUIRE(response.id < kRequests);
+    BOOST_CHECK(!seen[response.id]);
+    seen[response.id] = true;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(AnswersAfterClientCloses) {
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(TestLocation(), model_config);
+  Running server(model, TestConfig());
+  Client client("server_test.sock");
+  for (uint32_t id = 0; id < 10; ++id) {
+    client.Send(id, kSentences[0]);
+  }
+  client.Flush();
+  client.CloseWrite();
+  for (uint32_t i = 0; i < 10; ++i) {
+    Response response;
+    client.Receive(response);
+    BOOST_CHECK(response.id < 10);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(AnswersAfterStop) {
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(TestLocation(), model_config);
+  ServerConfig config(TestConfig());
+  // Workers wait for a full batch, so the requests are still queued at Stop.
+  config.batch = 100;
+  config.delay = 200000;
+  Running server(model, config);
+  Client client("server_test.sock");
+  for (uint32_t id = 0; id < 10; ++id) {
+    client.Send(id, kSentences[0]);
+  }
+  client.Flush();
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  server.Get().Stop();
+  for (uint32_t i = 0; i < 10; ++i) {
+    Response response;
+    client.Receive(response);
+    BOOST_CHECK(response.id < 10);
+  }
+}
+
+} // namespace
+} // namespace server
+} // namespace lm
@@ -11,28 +11,31 @@ namespace lm {
 namespace ngram {
 
 // This is a POD but if you want memcmp to return the same as operator==, call
-// ZeroRemaining first.
-class State {
+// ZeroRemaining first.  MaxOrder is the highest order of model it can be used
+// with.  Most code uses State, which supports KENLM_MAX_ORDER.
+template <unsigned char MaxOrder> class OrderState {
   public:
-    bool operator==(const State &other) const {
+    static const unsigned char kMaxOrder = MaxOrder;
+
+    bool operator==(const OrderState &other) const {
       if (length != other.length) return false;
       return !memcmp(words, other.words, length * sizeof(WordIndex));
     }
 
     // Three way comparison function.
-    int Compare(const State &other) const {
+    int Compare(const OrderState &other) const {
       if (length != other.length) return length < other.length ? -1 : 1;
       return memcmp(words, other.words, length * sizeof(WordIndex));
     }
 
-    bool operator<(const State &other) const {
+    bool operator<(const OrderState &other) const {
       if (length != other.length) return length < other.length;
       return memcmp(words, other.words, length * sizeof(WordIndex)) < 0;
     }
 
     // Call this before using raw memcmp.
     void ZeroRemaining() {
-      for (unsigned char i = length; i < KENLM_MAX_ORDER - 1; ++i) {
+      for (unsigned char i = length; i < MaxOrder - 1; ++i) {
         words[i] = 0;
         backoff[i] = 0.0;
       }
@@ -42,17 +45,71 @@ class State {
 
     // You shouldn't need to touch anything below this line, but the members are public so FullState will qualify as a POD.
     // This order minimizes total size of the struct if WordIndex is 64 bit, float is 32 bit, and alignment of 64 bit integers is 64 bit.
-    WordIndex words[KENLM_MAX_ORDER - 1];
-    float backoff[KENLM_MAX_ORDER - 1];
+    WordIndex words[MaxOrder - 1];
+    float backoff[MaxOrder - 1];
     unsigned char length;
 };
 
+// A class rather than a typedef so it can be forward declared.
+class State : public OrderState<KENLM_MAX_ORDER> {};
+
 typedef State Right;
 
+template <unsigned char MaxOrder> inline uint64_t hash_value(const OrderState<MaxOrder> &state, uint64_t seed = 0) {
+  return util::MurmurHashNative(state.words, sizeof(WordIndex) * state.length, seed);
+}
+
 inline uint64_t hash_value(const State &state, uint64_t seed = 0) {
   return util::MurmurHashNative(state.words, sizeof(WordIndex) * state.length, seed);
 }
 
+/* State without backoffs for decoders that store many hypotheses.  It has the
+ * same identity as the full state so it works for recombination.  Scoring
+ * from it looks the backoffs up again, which is slower than scoring from a
+ * full state but gives the same result.
+ */
+template <unsigned char MaxOrder> class CompactOrderState {
+  public:
+    bool operator==(const CompactOrderState &other) const {
+      if (length != other.length) return false;
+      return !memcmp(words, other.words, length * sizeof(WordIndex));
+    }
+
+    int Compare(const CompactOrderState &other) const {
+      if (length != other.length) return length < other.length ? -1 : 1;
+      return memcmp(words, other.words, length * sizeof(WordIndex));
+    }
+
+    bool operator<(const CompactOrderState &other) const {
+      return Compare(other) < 0;
+    }
+
+    // Drop the backoffs from a full state.
+    void Set(const OrderState<MaxOrder> &from) {
+      memcpy(words, from.words, sizeof(words));
+      length = from.length;
+    }
+
+    void ZeroRemaining() {
+      for (unsigned char i = length; i < MaxOrder - 1; ++i) words[i] = 0;
+    }
+
+    unsigned char Length() const { return length; }
+
+    WordIndex words[MaxOrder - 1];
+    unsigned char length;
+};
+
+class CompactState : public CompactOrderState<KENLM_MAX_ORDER> {};
+
+template <unsigned char MaxOrder> inline uint64_t hash_value(const CompactOrderState<MaxOrder> &state, uint64_t seed = 0) {
+  return util::MurmurHashNative(state.words, sizeof(WordIndex) * state.length, seed);
+}
+
+inline uint64_t hash_value(const CompactState &state, uint64_t seed = 0) {
+  return util::MurmurHashNative(state.words, sizeof(WordIndex) * state.length, seed);
+}
+
 struct Left {
   bool operator==(const Left &other) const {
     return
@@ -0,0 +1,248 @@
+#include "synthetic.hh"
+
+#include "lm_exception.hh"
+#include "../util/exception.hh"
+#include "../util/file_stream.hh"
+#include "../util/fixed_array.hh"
+#include "../util/murmur_hash.hh"
+
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace lm {
+namespace {
+
+// Random numbers from the generator's raw output, since std:: distributions differ by implementation.
+class Random {
+  public:
+    explicit Random(uint64_t seed) : gen_(seed) {}
+
+    // Uniform in [0, 1).
+    double Uniform() {
+      return static_cast<double>(gen_() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Uniform in [0, bound).
+    uint64_t Below(uint64_t bound) { return gen_() % bound; }
+
+  private:
+    std::mt19937_64 gen_;
+};
+
+class Zipf {
+  public:
+    Zipf(uint64_t size, double exponent) : cdf_(size) {
+      double sum = 0.0;
+      for (uint64_t i = 0; i < size; ++i) {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent);
+        cdf_[i] = sum;
+      }
+      for (uint64_t i = 0; i < size; ++i) cdf_[i] /= sum;
+    }
+
+    uint64_t Sample(Random &random) const {
+      std::vector<double>::const_iterator found = std::upper_bound(cdf_.begin(), cdf_.end(), random.Uniform());
+      return std::min<uint64_t>(found - cdf_.begin(), cdf_.size() - 1);
+    }
+
+  private:
+    std::vector<double> cdf_;
+};
+
+// Bijective base 26 so frequent words are short and all strings are distinct.
+std::string WordString(uint64_t rank) {
+  std::string ret;
+  for (uint64_t n = rank + 1; n; n = (n - 1) / 26) {
+    ret.push_back('a' + static_cast<char>((n - 1) % 26));
+  }
+  std::reverse(ret.begin(), ret.end());
+  return ret;
+}
+
+// N-grams are identified by where they first appear in the corpus.
+class NGramHash {
+  public:
+    NGramHash(const WordIndex *tokens, unsigned char order) : tokens_(tokens), order_(order) {}
+    std::size_t operator()(uint64_t position) const {
+      return util::MurmurHashNative(tokens_ + position, order_ * sizeof(WordIndex));
+    }
+  private:
+    const WordIndex *tokens_;
+    unsigned char order_;
+};
+
+class NGramEqual {
+  public:
+    NGramEqual(const WordIndex *tokens, unsigned char order) : tokens_(tokens), order_(order) {}
+    bool operator()(uint64_t first, uint64_t second) const {
+      return !memcmp(tokens_ + first, tokens_ + second, order_ * sizeof(WordIndex));
+    }
+  private:
+    const WordIndex *tokens_;
+    unsigned char order_;
+};
+
+struct Entry {
+  Entry() : count(0), kept(false), mass(0.0), lower_mass(0.0), prob(0.0) {}
+  uint64_t count;
+  bool kept;
+  // Probability of kept n-grams extending this one.
+  double mass;
+  // Probability the next lower order gives the same words.
+  double lower_mass;
+  float prob;
+};
+
+typedef boost::unordered_map<uint64_t, Entry, NGramHash, NGramEqual> NGramMap;
+
+struct Candidate {
+  uint64_t position;
+  uint64_t count;
+  bool operator<(const Candidate &other) const {
+    if (count != other.count) return count > other.count;
+    return position < other.position;
+  }
+};
+
+const double kDiscount = 0.5;
+
+} // namespace
+
+const WordIndex SyntheticCorpus::kBOS, SyntheticCorpus::kEOS, SyntheticCorpus::kUnk;
+
+SyntheticConfig::SyntheticConfig()
+  : vocab(10000), sentences(10000), mean_length(20), zipf(1.0), mix(0.5), seed(1), order(5) {}
+
+SyntheticCorpus::SyntheticCorpus(const SyntheticConfig &config) {
+  UTIL_THROW_IF(!config.vocab, ConfigException, "The synthetic vocabulary must have at least one word.");
+  UTIL_THROW_IF(!config.mean_length, ConfigException, "The mean sentence length must be positive.");
+  UTIL_THROW_IF(config.vocab + 3 > static_cast<uint64_t>(kMaxWordIndex), ConfigException, "Vocabulary size " << config.vocab << " is too large.");
+  words_.push_back("<s>");
+  words_.push_back("</s>");
+  words_.push_back("<unk>");
+  for (uint64_t i = 0; i < config.vocab; ++i) {
+    words_.push_back(WordString(i));
+  }
+
+  Random random(config.seed);
+  Zipf zipf(config.vocab, config.zipf);
+  const uint64_t kFirst = 3;
+  for (uint64_t s = 0; s < config.sentences; ++s) {
+    uint64_t length = 1 + random.Below(2 * config.mean_length - 1);
+    tokens_.push_back(kBOS);
+    for (uint64_t i = 0; i < length; ++i) {
+      uint64_t rank = zipf.Sample(random);
+      WordIndex previous = tokens_.back();
+      if (random.Uniform() < config.mix && previous != kBOS) {
+        // Rotate the distribution by an offset that depends on the previous word.
+        rank = (rank + ((previous * 0x9E3779B97F4A7C15ULL) >> 17) % config.vocab) % config.vocab;
+      }
+      tokens_.push_back(static_cast<WordIndex>(kFirst + rank));
+    }
+    tokens_.push_back(kEOS);
+  }
+}
+
+void SyntheticCorpus::WriteText(int fd) const {
+  util::FileStream out(fd);
+  for (std::vector<WordIndex>::const_iterator i = tokens_.begin(); i != tokens_.end(); ++i) {
+    if (*i == kBOS) continue;
+    if (*i == kEOS) {
+      out << '\n';
+      continue;
+    }
+    if (*(i - 1) != kBOS) out << ' ';
+    out << words_[*i];
+  }
+}
+
+void SyntheticCorpus::WriteARPA(const SyntheticConfig &config, int fd) const {
+  UTIL_THROW_IF(config.order < 1 || config.order > KENLM_MAX_ORDER, ConfigException, "Order " << static_cast<unsigned int>(config.order) << " is outside 1 to " << KENLM_MAX_ORDER << ".");
+  const WordIndex *tokens = &tokens_[0];
+
+  // Count n-grams that do not cross sentence boundaries.
+  util::FixedArray<NGramMap> maps(config.order);
+  for (unsigned char n = 1; n <= config.order; ++n) {
+    maps.emplace_back(1024, NGramHash(tokens, n), NGramEqual(tokens, n));
+  }
+  uint64_t predicted = 0;
+  for (uint64_t begin = 0; begin < tokens_.size();) {
+    uint64_t end = begin + 1;
+    while (tokens_[end - 1] != kEOS) ++end;
+    predicted += end - begin - 1;
+    for (unsigned char n = 1; n <= config.order; ++n) {
+      for (uint64_t i = begin; i + n <= end; ++i) {
+        ++maps[n - 1][i].count;
+      }
+    }
+    begin = end;
+  }
+
+  // Keep the most frequent n-grams whose prefix and suffix were kept.
+  std::vector<std::vector<uint64_t> > kept(config.order);
+  for (unsigned char n = 1; n <= config.order; ++n) {
+    NGramMap &map = maps[n - 1];
+    std::vector<Candidate> candidates;
+    for (NGramMap::const_iterator i = map.begin(); i != map.end(); ++i) {
+      if (n > 1 && !(maps[n - 2].find(i->first)->second.kept && maps[n - 2].find(i->first + 1)->second.kept)) continue;
+      Candidate candidate;
+      candidate.position = i->first;
+      candidate.count = i->second.count;
+      candidates.push_back(candidate);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    uint64_t limit = (n <= config.counts.size() && config.counts[n - 1]) ? config.counts[n - 1] : candidates.size();
+    for (std::vector<Candidate>::const_iterator i = candidates.begin(); i != candidates.end(); ++i) {
+      // Always keep <s> and </s>.
+      if (kept[n - 1].size() >= limit && !(n == 1 && tokens[i->position] < kUnk)) continue;
+      Entry &entry = map[i->position];
+      entry.kept = true;
+      if (n == 1) {
+        // One count is reserved for <unk>.
+        entry.prob = (tokens[i->position] == kBOS) ? -99.0 : std::log10(static_cast<double>(i->count) / static_cast<double>(predicted + 1));
+      } else {
+        Entry &context = maps[n - 2].find(i->position)->second;
+        double prob = (static_cast<double>(i->count) - kDiscount) / static_cast<double>(context.count);
+        context.mass += prob;
+        // The suffix was kept, so the lower order has its probability.
+        context.lower_mass += std::pow(10.0, static_cast<double>(maps[n - 2].find(i->position + 1)->second.prob));
+        entry.prob = std::log10(prob);
+      }
+      kept[n - 1].push_back(i->position);
+    }
+  }
+
+  util::FileStream out(fd);
+  out << "\n\\data\\\n";
+  for (unsigned char n = 1; n <= config.order; ++n) {
+    // Unigrams include <unk>.
+    out << "ngram " << static_cast<unsigned int>(n) << '=' << (kept[n - 1].size() + (n == 1)) << '\n';
+  }
+  for (unsigned char n = 1; n <= config.order; ++n) {
+    out << "\n\\" << static_cast<unsigned int>(n) << "-grams:\n";
+    if (n == 1) {
+      out << static_cast<float>(std::log10(1.0 / static_cast<double>(predicted + 1))) << "\t<unk>";
+      if (config.order > 1) out << "\t0";
+      out << '\n';
+    }
+    for (std::vector<uint64_t>::const_iterator i = kept[n - 1].begin(); i != kept[n - 1].end(); ++i) {
+      const Entry &entry = maps[n - 1].find(*i)->second;
+      out << entry.prob << '\t' << words_[tokens[*i]];
+      for (unsigned char w = 1; w < n; ++w) {
+        out << ' ' << words_[tokens[*i + w]];
+      }
+      if (n < config.order && tokens[*i + n - 1] != kEOS) {
+        // Normalize: the left over mass goes to words the lower order predicts.
+        out << '\t' << static_cast<float>(std::log10((1.0 - entry.mass) / (1.0 - entry.lower_mass)));
+      }
+      out << '\n';
+    }
+  }
+  out << "\n\\end\\\n";
+}
+
+} // namespace lm
@@ -0,0 +1,71 @@
+#ifndef LM_SYNTHETIC_H
+#define LM_SYNTHETIC_H
+
+/* Synthetic corpora and ARPA models for benchmarks that cannot ship real
+ * models.  Output depends only on the configuration, including the seed, and
+ * not on the platform's standard library.
+ *
+ * Words are drawn from a Zipf distribution.  With probability mix, the word is
+ * instead drawn from a Zipf distribution over a permutation of the vocabulary
+ * that depends on the previous word, so higher-order n-grams repeat as they
+ * would in text.  Frequent words get short strings.
+ *
+ * The ARPA is estimated from the corpus's n-gram counts with absolute
+ * discounting.  Each order keeps its most frequent n-grams whose prefix and
+ * suffix were kept, so the model is closed under prefix and suffix.
+ */
+
+#include "word_index.hh"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+
+struct SyntheticConfig {
+  SyntheticConfig();
+
+  // Words excluding <s>, </s>, and <unk>.
+  uint64_t vocab;
+  uint64_t sentences;
+  // Sentence lengths are uniform from 1 to 2 * mean_length - 1.
+  unsigned int mean_length;
+  // Zipf exponent.
+  double zipf;
+  // Probability of drawing from the distribution conditioned on the previous word.
+  double mix;
+  uint64_t seed;
+
+  unsigned char order;
+  // Maximum number of n-grams to keep for each order starting with unigrams.  Missing or 0 means keep all.
+  std::vector<uint64_t> counts;
+};
+
+class SyntheticCorpus {
+  public:
+    // Ids of special words.  Others are words_[id].
+    static const WordIndex kBOS = 0, kEOS = 1, kUnk = 2;
+
+    explicit SyntheticCorpus(const SyntheticConfig &config);
+
+    // Each sentence starts with kBOS and ends with kEOS.
+    const std::vector<WordIndex> &Tokens() const { return tokens_; }
+
+    const std::string &Word(WordIndex id) const { return words_[id]; }
+
+    // Text with one sentence per line, without <s> and </s>.
+    void WriteText(int fd) const;
+
+    // Estimate and write an ARPA file.
+    void WriteARPA(const SyntheticConfig &config, int fd) const;
+
+  private:
+    std::vector<WordIndex> tokens_;
+    std::vector<std::string> words_;
+};
+
+} // namespace lm
+
+#endif // LM_SYNTHETIC_H
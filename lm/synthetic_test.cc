@@ -0,0 +1,120 @@
+#include "synthetic.hh"
+
+#include "model.hh"
+#include "read_arpa.hh"
+#include "../util/file.hh"
+#include "../util/file_piece.hh"
+#include "../util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE SyntheticTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <string>
+
+namespace lm {
+namespace {
+
+SyntheticConfig SmallConfig() {
+  SyntheticConfig config;
+  config.vocab = 500;
+  config.sentences = 300;
+  config.mean_length = 8;
+  config.order = 3;
+  return config;
+}
+
+BOOST_AUTO_TEST_CASE(Reproducible) {
+  SyntheticConfig config(SmallConfig());
+  SyntheticCorpus first(config), second(config);
+  BOOST_CHECK(first.Tokens() == second.Tokens());
+  config.seed = 2;
+  SyntheticCorpus third(config);
+  BOOST_CHECK(first.Tokens() != third.Tokens());
+
+  // Frequent words are short.
+  BOOST_CHECK_EQUAL("a", first.Word(3));
+  BOOST_CHECK_EQUAL("aa", first.Word(3 + 26));
+}
+
+BOOST_AUTO_TEST_CASE(Sentences) {
+  SyntheticConfig config(SmallConfig());
+  SyntheticCorpus corpus(config);
+  uint64_t sentences = 0;
+  const std::vector<WordIndex> &tokens = corpus.Tokens();
+  for (std::size_t i = 0; i < tokens.size(); ++i) {
+    if (tokens[i] == SyntheticCorpus::kBOS) {
+      ++sentences;
+      BOOST_REQUIRE(i + 2 < tokens.size());
+      BOOST_CHECK(tokens[i + 1] > SyntheticCorpus::kUnk);
+    }
+  }
+  BOOST_CHECK_EQUAL(config.sentences, sentences);
+  BOOST_CHECK_EQUAL(SyntheticCorpus::kEOS, tokens.back());
+}
+
+BOOST_AUTO_TEST_CASE(ARPA) {
+  SyntheticConfig config(SmallConfig());
+  config.counts.push_back(0);
+  config.counts.push_back(400);
+  config.counts.push_back(100);
+  SyntheticCorpus corpus(config);
+  const char *kName = "synthetic_test.arpa";
+  {
+    util::scoped_fd file(util::CreateOrThrow(kName));
+    corpus.WriteARPA(config, file.get());
+  }
+
+  util::FilePiece in(kName);
+  std::vector<uint64_t> counts;
+  ReadARPACounts(in, counts);
+  BOOST_REQUIRE_EQUAL(3U, counts.size());
+  BOOST_CHECK(counts[0] > 100);
+  BOOST_CHECK_EQUAL(400U, counts[1]);
+  BOOST_CHECK(counts[2] <= 100);
+
+  // Every n-gram's prefix and suffix are present.
+  std::vector<std::set<std::string> > ngrams(3);
+  for (unsigned int n = 1; n <= 3; ++n) {
+    ReadNGramHeader(in, n);
+    for (uint64_t i = 0; i < counts[n - 1]; ++i) {
+      StringPiece line(in.ReadLine());
+      util::TokenIter<util::SingleCharacter> field(line, '\t');
+      ++field;
+      std::string words(field->data(), field->size());
+      if (n > 1) {
+        BOOST_CHECK_MESSAGE(ngrams[n - 2].count(words.substr(0, words.rfind(' '))), "Missing prefix of " << words);
+        BOOST_CHECK_MESSAGE(ngrams[n - 2].count(words.substr(words.find(' ') + 1)), "Missing suffix of " << words);
+      }
+      ngrams[n - 1].insert(words);
+    }
+  }
+
+  ngram::Config model_config;
+  model_config.messages = NULL;
+  ngram::ProbingModel model(kName, model_config);
+  BOOST_CHECK_EQUAL(3, model.Order());
+  ngram::State out;
+  FullScoreReturn ret(model.FullScore(model.BeginSentenceState(), model.GetVocabulary().Index(corpus.Word(corpus.Tokens()[1])), out));
+  BOOST_CHECK(ret.prob < 0.0);
+  BOOST_CHECK(ret.prob > -10.0);
+
+  // Backoffs normalize each context, including ones that back off twice.
+  ngram::State contexts[3];
+  contexts[0] = model.NullContextState();
+  contexts[1] = model.BeginSentenceState();
+  model.FullScore(contexts[1], model.GetVocabulary().Index(corpus.Word(corpus.Tokens()[1])), contexts[2]);
+  for (std::size_t c = 0; c < 3; ++c) {
+    double sum = 0.0;
+    for (WordIndex word = 0; word < model.GetVocabulary().Bound(); ++word) {
+      sum += std::pow(10.0, static_cast<double>(model.FullScore(contexts[c], word, out).prob));
+    }
+    BOOST_CHECK_CLOSE(1.0, sum, 0.01);
+  }
+  std::remove(kName);
+}
+
+} // namespace
+} // namespace lm
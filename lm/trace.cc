@@ -0,0 +1,128 @@
+#include "trace.hh"
+
+#include "lm_exception.hh"
+#include "virtual_interface.hh"
+#include "../util/exception.hh"
+#include "../util/file.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lm {
+namespace ngram {
+
+const char kTraceMagic[] = "KenLM query trace v1\n";
+
+namespace {
+
+const uint64_t kNoId = static_cast<uint64_t>(-1);
+
+class TraceParser {
+  public:
+    TraceParser(const char *begin, const char *end) : at_(reinterpret_cast<const uint8_t*>(begin)), end_(reinterpret_cast<const uint8_t*>(end)) {}
+
+    bool Done() const { return at_ == end_; }
+
+    uint8_t Byte() {
+      UTIL_THROW_IF(at_ == end_, FormatLoadException, "Trace ends in the middle of a record.");
+      return *at_++;
+    }
+
+    uint64_t VarInt() {
+      uint64_t ret = 0;
+      for (unsigned int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = Byte();
+        ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return ret;
+      }
+      UTIL_THROW(FormatLoadException, "Trace has a varint longer than 64 bits.");
+    }
+
+    StringPiece Bytes(uint64_t length) {
+      UTIL_THROW_IF(length > static_cast<uint64_t>(end_ - at_), FormatLoadException, "Trace ends in the middle of a word.");
+      StringPiece ret(reinterpret_cast<const char*>(at_), length);
+      at_ += length;
+      return ret;
+    }
+
+  private:
+    const uint8_t *at_;
+    const uint8_t *const end_;
+};
+
+} // namespace
+
+TraceWriter::TraceWriter(const base::Vocabulary &vocab, int fd)
+  : vocab_(vocab), ids_(vocab.Words().Size(), kNoId), next_id_(0), out_(fd) {
+  UTIL_THROW_IF(!vocab.HasWords(), ConfigException, "Tracing queries requires a model with a word table.  Build one with build_binary -W or set Config::word_table when loading ARPA.");
+  out_.write(kTraceMagic, sizeof(kTraceMagic) - 1);
+}
+
+void TraceWriter::Query(const WordIndex *context_rbegin, const WordIndex *context_rend, WordIndex word) {
+  uint64_t context[KENLM_MAX_ORDER];
+  unsigned char length = static_cast<unsigned char>(std::min<std::ptrdiff_t>(context_rend - context_rbegin, KENLM_MAX_ORDER - 1));
+  // Definitions have to come before the query that uses them.
+  for (unsigned char i = 0; i < length; ++i) {
+    context[i] = TraceId(context_rbegin[i]);
+  }
+  uint64_t predict = TraceId(word);
+  out_ << static_cast<char>(length);
+  for (unsigned char i = 0; i < length; ++i) {
+    WriteVarInt(context[i]);
+  }
+  WriteVarInt(predict);
+}
+
+uint64_t TraceWriter::TraceId(WordIndex word) {
+  UTIL_THROW_IF(word >= ids_.size(), util::Exception, "Word index " << word << " is not in the vocabulary of " << ids_.size() << " words.");
+  uint64_t &id = ids_[word];
+  if (id != kNoId) return id;
+  id = next_id_++;
+  vocab_.Word(word, word_);
+  out_ << static_cast<char>(kTraceDefine);
+  WriteVarInt(word_.size());
+  out_.write(word_.data(), word_.size());
+  return id;
+}
+
+void TraceWriter::WriteVarInt(uint64_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    out_ << static_cast<char>((value & 0x7f) | 0x80);
+  }
+  out_ << static_cast<char>(value);
+}
+
+Trace::Trace(int fd) {
+  std::string data;
+  char buf[1 << 16];
+  std::size_t got;
+  while ((got = util::ReadOrEOF(fd, buf, sizeof(buf)))) {
+    data.append(buf, got);
+  }
+  const std::size_t magic_length = sizeof(kTraceMagic) - 1;
+  UTIL_THROW_IF(data.size() < magic_length || memcmp(data.data(), kTraceMagic, magic_length), FormatLoadException, "This is not a KenLM query trace.");
+
+  TraceParser parser(data.data() + magic_length, data.data() + data.size());
+  while (!parser.Done()) {
+    uint8_t length = parser.Byte();
+    if (length == kTraceDefine) {
+      StringPiece word(parser.Bytes(parser.VarInt()));
+      words_.push_back(std::string(word.data(), word.size()));
+      continue;
+    }
+    TraceQuery query;
+    query.length = std::min<uint8_t>(length, KENLM_MAX_ORDER - 1);
+    for (uint8_t i = 0; i < length; ++i) {
+      uint64_t id = parser.VarInt();
+      UTIL_THROW_IF(id >= words_.size(), FormatLoadException, "Trace uses word " << id << " before defining it.");
+      if (i < query.length) query.context[i] = static_cast<uint32_t>(id);
+    }
+    uint64_t id = parser.VarInt();
+    UTIL_THROW_IF(id >= words_.size(), FormatLoadException, "Trace uses word " << id << " before defining it.");
+    query.word = static_cast<uint32_t>(id);
+    queries_.push_back(query);
+  }
+}
+
+} // namespace ngram
+} // namespace lm
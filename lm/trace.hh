@@ -0,0 +1,131 @@
+#ifndef LM_TRACE_H
+#define LM_TRACE_H
+
+/* Record the (context, word) queries a decoder makes so they can be replayed
+ * against any model with kenlm_replay.  Decoders backtrack and fan out
+ * hypotheses, so their access pattern differs from scoring sentences left to
+ * right.
+ *
+ * Words are written as strings the first time they appear, so the recording
+ * model needs a word table (Config::word_table or build_binary -W) and the
+ * trace does not depend on its vocabulary ids.
+ *
+ * Format: kTraceMagic then records.  Each record starts with a byte.  If it is
+ * kTraceDefine, a varint length and that many bytes follow and the word gets
+ * the next trace id, counting from 0.  Otherwise the byte is the length of
+ * the context and that many varint trace ids (most recent first) are
+ * followed by the varint trace id of the word being scored.
+ */
+
+#include "return.hh"
+#include "state.hh"
+#include "word_index.hh"
+#include "../util/file_stream.hh"
+
+#include <boost/noncopyable.hpp>
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+namespace base { class Vocabulary; }
+namespace ngram {
+
+extern const char kTraceMagic[];
+const unsigned char kTraceDefine = 0xff;
+
+// Not thread safe.  Use a writer per thread, each with its own file.
+class TraceWriter : boost::noncopyable {
+  public:
+    // Throws ConfigException if vocab has no word table.  Does not take ownership of fd.
+    TraceWriter(const base::Vocabulary &vocab, int fd);
+
+    // Record scoring word after the context, with the most recent word first.
+    void Query(const WordIndex *context_rbegin, const WordIndex *context_rend, WordIndex word);
+
+    void Flush() { out_.flush(); }
+
+  private:
+    uint64_t TraceId(WordIndex word);
+
+    void WriteVarInt(uint64_t value);
+
+    const base::Vocabulary &vocab_;
+
+    // Trace id for each vocabulary id, or kNoId.
+    std::vector<uint64_t> ids_;
+    uint64_t next_id_;
+
+    std::string word_;
+
+    util::FileStream out_;
+};
+
+/* Wrap a model so that FullScore also records a trace.  This has enough of
+ * the model interface for Query in ngram_query.hh.
+ */
+template <class Model> class TracingModel {
+  public:
+    typedef typename Model::State State;
+    typedef typename Model::Vocabulary Vocabulary;
+
+    TracingModel(const Model &model, int fd) : model_(model), writer_(model.GetVocabulary(), fd) {}
+
+    FullScoreReturn FullScore(const State &in_state, const WordIndex new_word, State &out_state) const {
+      writer_.Query(in_state.words, in_state.words + in_state.length, new_word);
+      return model_.FullScore(in_state, new_word, out_state);
+    }
+
+    const State &BeginSentenceState() const { return model_.BeginSentenceState(); }
+    const State &NullContextState() const { return model_.NullContextState(); }
+    const Vocabulary &GetVocabulary() const { return model_.GetVocabulary(); }
+    unsigned char Order() const { return model_.Order(); }
+
+    const Model &Base() const { return model_; }
+
+    void Flush() { writer_.Flush(); }
+
+  private:
+    const Model &model_;
+    mutable TraceWriter writer_;
+};
+
+struct TraceQuery {
+  // Trace ids of the context, most recent first.
+  uint32_t context[KENLM_MAX_ORDER - 1];
+  uint32_t word;
+  unsigned char length;
+};
+
+// A trace read into memory.
+class Trace {
+  public:
+    // Read a trace from fd until EOF.  Contexts longer than KENLM_MAX_ORDER - 1 are truncated.
+    explicit Trace(int fd);
+
+    // Strings indexed by trace id.
+    const std::vector<std::string> &Words() const { return words_; }
+
+    const std::vector<TraceQuery> &Queries() const { return queries_; }
+
+    /* Convert trace ids to vocabulary ids in a model.  Words the model does
+     * not have become vocab.NotFound().
+     */
+    template <class Vocab> void MapWords(const Vocab &vocab, std::vector<WordIndex> &out) const {
+      out.resize(words_.size());
+      for (std::size_t i = 0; i < words_.size(); ++i) {
+        out[i] = vocab.Index(words_[i]);
+      }
+    }
+
+  private:
+    std::vector<std::string> words_;
+    std::vector<TraceQuery> queries_;
+};
+
+} // namespace ngram
+} // namespace lm
+
+#endif // LM_TRACE_H
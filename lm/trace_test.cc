@@ -0,0 +1,93 @@
+#include "trace.hh"
+
+#include "model.hh"
+#include "../util/file.hh"
+#include "../util/tokenize_piece.hh"
+
+#define BOOST_TEST_MODULE TraceTest
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+#include <vector>
+
+namespace lm {
+namespace ngram {
+namespace {
+
+const char *TestLocation() {
+  if (boost::unit_test::framework::master_test_suite().argc < 2) {
+    return "test.arpa";
+  }
+  return boost::unit_test::framework::master_test_suite().argv[1];
+}
+
+Config SilentConfig() {
+  Config config;
+  config.arpa_complain = Config::NONE;
+  config.messages = NULL;
+  return config;
+}
+
+// Branch from every prefix of a sentence like a decoder expanding hypotheses.
+template <class Model> void Queries(const Model &model, std::vector<float> &probs) {
+  const char *sentence = "looking on a little more loin </s>";
+  const char *branches[] = {"on", "little", "</s>", "unknownword"};
+  typename Model::State state(model.BeginSentenceState()), out;
+  for (util::TokenIter<util::SingleCharacter, true> word(sentence, ' '); word; ++word) {
+    for (unsigned int i = 0; i < sizeof(branches) / sizeof(const char*); ++i) {
+      probs.push_back(model.FullScore(state, model.GetVocabulary().Index(branches[i]), out).prob);
+    }
+    probs.push_back(model.FullScore(state, model.GetVocabulary().Index(*word), out).prob);
+    state = out;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RoundTrip) {
+  Config config(SilentConfig());
+  config.word_table = true;
+  ProbingModel probing(TestLocation(), config);
+
+  util::scoped_fd file(util::MakeTemp("trace_test_temp"));
+  std::vector<float> expected;
+  {
+    TracingModel<ProbingModel> tracing(probing, file.get());
+    Queries(tracing, expected);
+  }
+  util::SeekOrThrow(file.get(), 0);
+  Trace trace(file.get());
+  BOOST_REQUIRE_EQUAL(expected.size(), trace.Queries().size());
+  // Each distinct word, including <s> and <unk>, is defined once.
+  BOOST_CHECK_EQUAL(9U, trace.Words().size());
+  BOOST_CHECK_EQUAL("<s>", trace.Words()[trace.Queries()[0].context[0]]);
+  BOOST_CHECK_EQUAL("on", trace.Words()[trace.Queries()[0].word]);
+
+  // Replay against a different model type with different vocabulary ids.
+  TrieModel trie(TestLocation(), SilentConfig());
+  std::vector<WordIndex> ids;
+  trace.MapWords(trie.GetVocabulary(), ids);
+  TrieModel::State state, out;
+  WordIndex context[KENLM_MAX_ORDER];
+  for (std::size_t i = 0; i < trace.Queries().size(); ++i) {
+    const TraceQuery &query = trace.Queries()[i];
+    for (unsigned char j = 0; j < query.length; ++j) context[j] = ids[query.context[j]];
+    trie.GetState(context, context + query.length, state);
+    BOOST_CHECK_CLOSE(expected[i], trie.FullScore(state, ids[query.word], out).prob, 0.001);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RequiresWordTable) {
+  ProbingModel probing(TestLocation(), SilentConfig());
+  util::scoped_fd file(util::MakeTemp("trace_test_temp"));
+  BOOST_CHECK_THROW(TraceWriter(probing.GetVocabulary(), file.get()), ConfigException);
+}
+
+BOOST_AUTO_TEST_CASE(BadMagic) {
+  util::scoped_fd file(util::MakeTemp("trace_test_temp"));
+  util::WriteOrThrow(file.get(), "not a trace", 11);
+  util::SeekOrThrow(file.get(), 0);
+  BOOST_CHECK_THROW(Trace trace(file.get()), FormatLoadException);
+}
+
+} // namespace
+} // namespace ngram
+} // namespace lm
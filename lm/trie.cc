@@ -1,6 +1,7 @@
 #include "trie.hh"
 
 #include "bhiksha.hh"
+#include "../util/bit_packed_search.hh"
 #include "../util/bit_packing.hh"
 #include "../util/exception.hh"
 #include "../util/sorted_uniform.hh"
@@ -12,27 +13,9 @@ namespace ngram {
 namespace trie {
 namespace {
 
-class KeyAccessor {
-  public:
-    KeyAccessor(const void *base, uint64_t key_mask, uint8_t key_bits, uint8_t total_bits)
-      : base_(reinterpret_cast<const uint8_t*>(base)), key_mask_(key_mask), key_bits_(key_bits), total_bits_(total_bits) {}
-
-    typedef uint64_t Key;
-
-    Key operator()(uint64_t index) const {
-      return util::ReadInt57(base_, index * static_cast<uint64_t>(total_bits_), key_bits_, key_mask_);
-    }
-
-  private:
-    const uint8_t *const base_;
-    const WordIndex key_mask_;
-    const uint8_t key_bits_, total_bits_;
-};
-
 bool FindBitPacked(const void *base, uint64_t key_mask, uint8_t key_bits, uint8_t total_bits, uint64_t begin_index, uint64_t end_index, const uint64_t max_vocab, const uint64_t key, uint64_t &at_index) {
-  KeyAccessor accessor(base, key_mask, key_bits, total_bits);
-  if (!util::BoundedSortedUniformFind<uint64_t, KeyAccessor, util::PivotSelect<sizeof(WordIndex)>::T>(accessor, begin_index - 1, (uint64_t)0, end_index, max_vocab, key, at_index)) return false;
-  return true;
+  util::BitPackedAccessor accessor(base, key_mask, key_bits, total_bits);
+  return util::BitPackedFind<util::PivotSelect<sizeof(WordIndex)>::T>(accessor, begin_index, end_index, max_vocab, key, at_index);
 }
 } // namespace
 
@@ -13,6 +13,12 @@ void Vocabulary::SetSpecial(WordIndex begin_sentence, WordIndex end_sentence, Wo
   not_found_ = not_found;
 }
 
+void Vocabulary::Word(WordIndex index, std::string &out) const {
+  UTIL_THROW_IF(words_.Empty(), ConfigException, "This model has no word table.  Rebuild the binary file with build_binary -W.");
+  UTIL_THROW_IF(index >= words_.Size(), util::Exception, "Word index " << index << " is out of range for a vocabulary of size " << words_.Size());
+  words_.Word(index, out);
+}
+
 Model::~Model() {}
 
 } // namespace base
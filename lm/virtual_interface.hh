@@ -3,6 +3,7 @@
 
 #include "return.hh"
 #include "word_index.hh"
+#include "word_table.hh"
 #include "../util/string_piece.hh"
 
 #include <string>
@@ -17,9 +18,9 @@ template <class T, class U, class V> class ModelFacade;
  * calling Model.  It provides faster convenience functions for <s>, </s>, and
  * <unk> although you can also find these using Index.
  *
- * Some models do not load the mapping from index to string.  If you need this,
- * check if the model Vocabulary class implements such a function and access it
- * directly.
+ * Some models do not load the mapping from index to string.  If the binary
+ * file was built with a word table (build_binary -W), Word(index) returns the
+ * string without any heap-allocated map.  Otherwise use EnumerateVocab.
  *
  * The Vocabulary object is always owned by the Model and can be retrieved from
  * the Model using BaseVocabulary() for this abstract interface or
@@ -46,6 +47,26 @@ class Vocabulary {
       return Index(StringPiece(str));
     }
 
+    // Ids are [0, Bound()).  Callers passing ids from outside should check them.
+    virtual WordIndex Bound() const = 0;
+
+    // Is Word available?
+    bool HasWords() const { return !words_.Empty(); }
+    const WordTable &Words() const { return words_; }
+
+    // Reverse lookup.  Throws if the model has no word table.
+    void Word(WordIndex index, std::string &out) const;
+    std::string Word(WordIndex index) const {
+      std::string ret;
+      Word(index, ret);
+      return ret;
+    }
+
+    // Called by the model once the word table is in memory; it owns the memory.
+    void InitWords(const void *base, std::size_t size) {
+      words_.Init(base, size);
+    }
+
   protected:
     // Call SetSpecial afterward.
     Vocabulary() {}
@@ -59,6 +80,8 @@ class Vocabulary {
     WordIndex begin_sentence_, end_sentence_, not_found_;
 
   private:
+    WordTable words_;
+
     // Disable copy constructors.  They're private and undefined.
     // Ersatz boost::noncopyable.
     Vocabulary(const Vocabulary &);
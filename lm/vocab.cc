@@ -46,7 +46,8 @@ void ReadWords(int fd, EnumerateVocab *enumerate, WordIndex expected_count, uint
 
   WordIndex index = 1; // Read <unk> already.
   util::FilePiece in(util::DupOrThrow(fd));
-  for (util::LineIterator w(in, '\0'); w; ++w, ++index) {
+  // Stop at expected_count because a word table may follow the strings.
+  for (util::LineIterator w(in, '\0'); w && index < expected_count; ++w, ++index) {
     enumerate->Add(index, *w);
   }
   UTIL_THROW_IF(expected_count != index, FormatLoadException, "The binary file has the wrong number of words at the end.  This could be caused by a truncated binary file.");
@@ -0,0 +1,86 @@
+#include "word_table.hh"
+
+#include "lm_exception.hh"
+#include "../util/exception.hh"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace lm {
+namespace {
+
+void AppendVarInt(uint64_t value, std::string &out) {
+  for (; value >= 0x80; value >>= 7) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline uint64_t ReadVarInt(const uint8_t *&at) {
+  uint64_t ret = 0;
+  for (unsigned int shift = 0; ; shift += 7) {
+    uint8_t byte = *(at++);
+    ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return ret;
+  }
+}
+
+} // namespace
+
+void WordTable::Build(const char *begin, const char *end, std::string &out) {
+  std::vector<uint64_t> offsets;
+  std::string data;
+  StringPiece previous;
+  uint64_t words = 0;
+  for (const char *i = begin; i < end; ++words) {
+    StringPiece word(i, strlen(i));
+    i += word.size() + 1;
+    std::size_t shared = 0;
+    if (words % kBucket) {
+      std::size_t limit = std::min(previous.size(), word.size());
+      while (shared < limit && previous.data()[shared] == word.data()[shared]) ++shared;
+    } else {
+      offsets.push_back(data.size());
+    }
+    AppendVarInt(shared, data);
+    AppendVarInt(word.size() - shared, data);
+    data.append(word.data() + shared, word.size() - shared);
+    previous = word;
+  }
+  offsets.push_back(data.size());
+  UTIL_THROW_IF(words > static_cast<uint64_t>(kMaxWordIndex), VocabLoadException, "Too many words for the word table: " << words);
+
+  out.append(reinterpret_cast<const char*>(&words), sizeof(uint64_t));
+  out.append(reinterpret_cast<const char*>(&offsets[0]), sizeof(uint64_t) * offsets.size());
+  out.append(data);
+}
+
+void WordTable::Init(const void *base, std::size_t size) {
+  UTIL_THROW_IF(size < 2 * sizeof(uint64_t), FormatLoadException, "Word table is too small at " << size << " bytes.");
+  const uint64_t *header = static_cast<const uint64_t*>(base);
+  uint64_t words = header[0];
+  uint64_t buckets = (words + kBucket - 1) / kBucket;
+  uint64_t data_begin = sizeof(uint64_t) * (2 + buckets);
+  UTIL_THROW_IF(data_begin > size || header[1 + buckets] > size - data_begin, FormatLoadException, "Word table claims to have " << words << " words but it only has " << size << " bytes.  Is the binary file truncated?");
+  words_ = static_cast<WordIndex>(words);
+  offsets_ = header + 1;
+  data_ = static_cast<const uint8_t*>(base) + data_begin;
+}
+
+void WordTable::Word(WordIndex index, std::string &out) const {
+  assert(index < words_);
+  const uint8_t *at = data_ + offsets_[index / kBucket];
+  out.clear();
+  for (WordIndex remaining = index % kBucket; ; --remaining) {
+    std::size_t shared = ReadVarInt(at);
+    std::size_t rest = ReadVarInt(at);
+    out.resize(shared);
+    out.append(reinterpret_cast<const char*>(at), rest);
+    at += rest;
+    if (!remaining) return;
+  }
+}
+
+} // namespace lm
@@ -0,0 +1,59 @@
+#ifndef LM_WORD_TABLE_H
+#define LM_WORD_TABLE_H
+
+#include "word_index.hh"
+#include "../util/string_piece.hh"
+
+#include <cstddef>
+#include <string>
+
+#include <stdint.h>
+
+namespace lm {
+
+/* Front-coded table of vocabulary strings indexed by WordIndex, designed to
+ * be memory mapped from the end of a binary file.
+ *
+ * Words are grouped into buckets of kBucket consecutive indices.  Each word is
+ * stored as varint(length of prefix shared with the previous word in the
+ * bucket), varint(length of the rest), then the rest.  The first word of a
+ * bucket shares nothing so a lookup decodes at most kBucket words.
+ *
+ * Layout:
+ *   uint64_t words
+ *   uint64_t offsets[buckets + 1] into the data
+ *   data
+ */
+class WordTable {
+  public:
+    static const WordIndex kBucket = 16;
+
+    WordTable() : words_(0), offsets_(NULL), data_(NULL) {}
+
+    /* Encode null-delimited strings, in order of WordIndex starting at 0, from
+     * [begin, end).  The encoding is appended to out.
+     */
+    static void Build(const char *begin, const char *end, std::string &out);
+
+    // Use memory produced by Build.  This does not take ownership.
+    void Init(const void *base, std::size_t size);
+
+    bool Empty() const { return data_ == NULL; }
+
+    // Number of words in the table.
+    WordIndex Size() const { return words_; }
+
+    // Replace out with the string for index.  Requires index < Size().
+    void Word(WordIndex index, std::string &out) const;
+
+  private:
+    WordIndex words_;
+
+    const uint64_t *offsets_;
+
+    const uint8_t *data_;
+};
+
+} // namespace lm
+
+#endif // LM_WORD_TABLE_H
@@ -20,6 +20,10 @@ WordIndex Vocabulary::Index(const std::string &str) const {
   return vocab_.lookup_word(str);
 }
 
+WordIndex Vocabulary::Bound() const {
+  return vocab_.size();
+}
+
 class Backend {
   public:
     Backend(const nplm::neuralLM &from, const std::size_t cache_size) : lm_(from), ngram_(from.get_order()) {
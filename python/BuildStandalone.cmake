@@ -8,8 +8,21 @@ file(GLOB
   "python/*.cc"
   )
 
+# The estimation pipeline behind kenlm.lmplz needs threads.
+find_package(Boost 1.41.0 REQUIRED OPTIONAL_COMPONENTS thread)
+if(Boost_THREAD_FOUND)
+  file(GLOB
+    KENLM_PYTHON_ESTIMATION_SRCS
+    "util/stream/*.cc"
+    "lm/common/*.cc"
+    "lm/builder/*.cc"
+    )
+  list(APPEND KENLM_PYTHON_STANDALONE_SRCS ${KENLM_PYTHON_ESTIMATION_SRCS})
+endif()
+
 list(FILTER KENLM_PYTHON_STANDALONE_SRCS EXCLUDE REGEX ".*main.cc")
 list(FILTER KENLM_PYTHON_STANDALONE_SRCS EXCLUDE REGEX ".*test.cc")
+list(FILTER KENLM_PYTHON_STANDALONE_SRCS EXCLUDE REGEX ".*size_option.cc")
 
 add_library(
   kenlm
@@ -20,9 +33,19 @@ add_library(
 target_include_directories(kenlm PRIVATE ${PROJECT_SOURCE_DIR})
 target_compile_definitions(kenlm PRIVATE KENLM_MAX_ORDER=${KENLM_MAX_ORDER})
 
+target_include_directories(kenlm PRIVATE ${Boost_INCLUDE_DIRS})
+if(Boost_THREAD_FOUND)
+  target_link_libraries(kenlm PRIVATE ${Boost_LIBRARIES})
+  target_compile_definitions(kenlm PRIVATE WITH_THREADS)
+endif()
+
 find_package(ZLIB)
 find_package(BZip2)
 find_package(LibLZMA)
+find_path(ZSTD_INCLUDE_DIR zstd.h)
+find_library(ZSTD_LIBRARY zstd)
+find_path(LZ4_INCLUDE_DIR lz4frame.h)
+find_library(LZ4_LIBRARY lz4)
 
 if (ZLIB_FOUND)
   target_link_libraries(kenlm PRIVATE ${ZLIB_LIBRARIES})
@@ -39,3 +62,13 @@ if(LIBLZMA_FOUND)
   target_include_directories(kenlm PRIVATE ${LIBLZMA_INCLUDE_DIRS})
   target_compile_definitions(kenlm PRIVATE HAVE_LZMA)
 endif()
+if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+  target_link_libraries(kenlm PRIVATE ${ZSTD_LIBRARY})
+  target_include_directories(kenlm PRIVATE ${ZSTD_INCLUDE_DIR})
+  target_compile_definitions(kenlm PRIVATE HAVE_ZSTDLIB)
+endif()
+if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+  target_link_libraries(kenlm PRIVATE ${LZ4_LIBRARY})
+  target_include_directories(kenlm PRIVATE ${LZ4_INCLUDE_DIR})
+  target_compile_definitions(kenlm PRIVATE HAVE_LZ4LIB)
+endif()
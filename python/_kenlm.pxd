@@ -1,4 +1,7 @@
 from libcpp cimport bool
+from libcpp.string cimport string
+from libcpp.vector cimport vector
+from libc.stdint cimport uint8_t, uint64_t
 
 cdef extern from "lm/word_index.hh" namespace "lm":
     ctypedef unsigned WordIndex
@@ -38,6 +41,8 @@ cdef extern from "util/mmap.hh" namespace "util":
         POPULATE_OR_READ
         READ
         PARALLEL_READ
+        LAZY_PREFETCH
+        SHARED
 
 cdef extern from "lm/config.hh" namespace "lm::ngram::Config":
     cdef enum ARPALoadComplain:
@@ -53,11 +58,60 @@ cdef extern from "lm/config.hh" namespace "lm::ngram":
         bool show_progress
         ARPALoadComplain arpa_complain
         float unknown_missing_logprob
+        size_t building_memory
+        string temporary_directory_prefix
+        bool word_table
+        uint8_t prob_bits, backoff_bits
+        uint8_t pointer_bhiksha_bits
 
 cdef extern from "lm/model.hh" namespace "lm::ngram":
     cdef Model *LoadVirtual(char *, Config &config) except +
     #default constructor
     cdef Model *LoadVirtual(char *) except +
 
-cdef extern from "python/score_sentence.hh" namespace "lm::base":
+cdef extern from "python/score_sentence.hh" namespace "lm::base" nogil:
     cdef float ScoreSentence(const Model *model, const char *sentence)
+    cdef void ScoreSentences(const Model *model, char **sentences, const size_t *lengths, size_t count, bool bos, bool eos, size_t threads, float *totals, vector[float] *words, vector[size_t] *offsets) except +
+    cdef void ScoreIds(const Model *model, const WordIndex *ids, const size_t *offsets, size_t count, bool bos, bool eos, size_t threads, float *totals, float *words) except +
+
+cdef extern from "lm/model_type.hh" namespace "lm::ngram":
+    ctypedef enum ModelType:
+        PROBING
+        TRIE
+        QUANT_TRIE
+        ARRAY_TRIE
+        QUANT_ARRAY_TRIE
+
+cdef extern from "util/usage.hh" namespace "util":
+    cdef uint64_t ParseSize(const string &arg) except +
+
+cdef extern from "python/build_model.hh" namespace "lm::builder" nogil:
+    cdef cppclass EstimateConfig:
+        EstimateConfig()
+        size_t order
+        string temp_prefix
+        uint64_t memory
+        uint64_t minimum_block
+        uint64_t sort_block
+        size_t block_count
+        WordIndex vocab_estimate
+        uint64_t vocab_pad
+        bool interpolate_unigrams
+        bool skip_symbols
+        bool renumber
+        bool collapse_values
+        bool verbose_header
+        vector[uint64_t] prune
+        string limit_vocab_file
+        vector[float] discount_fallback
+        unsigned int arpa_precision
+        size_t arpa_threads
+        string arpa_compress
+        size_t compress_threads
+
+    cdef cppclass Estimation:
+        Estimation(const EstimateConfig &config, const string &arpa) except +
+        void Feed(const char *data, size_t length) except +
+        void Finish() except +
+
+    cdef void BuildBinary(const char *arpa, const char *binary, ModelType type, const Config &config) except +
@@ -0,0 +1,177 @@
+#include "python/build_model.hh"
+
+#ifdef WITH_THREADS
+#include "lm/builder/output.hh"
+#include "lm/builder/pipeline.hh"
+#endif // WITH_THREADS
+#include "lm/config.hh"
+#include "lm/model.hh"
+#include "util/exception.hh"
+#include "util/file.hh"
+#include "util/float_to_string.hh"
+#include "util/write_compressed.hh"
+
+#include <unistd.h>
+
+namespace lm {
+namespace builder {
+
+EstimateConfig::EstimateConfig()
+  : order(0),
+    temp_prefix(util::DefaultTempDirectory()),
+    memory(1ULL << 30),
+    minimum_block(8 << 10),
+    sort_block(64 << 20),
+    block_count(2),
+    vocab_estimate(1000000),
+    vocab_pad(0),
+    interpolate_unigrams(true),
+    skip_symbols(false),
+    renumber(false),
+    collapse_values(false),
+    verbose_header(false),
+    arpa_precision(0),
+    arpa_threads(1),
+    compress_threads(1) {}
+
+#ifdef WITH_THREADS
+namespace {
+
+// Validate options the way lmplz does and fill in the pipeline's.
+void ToPipeline(const EstimateConfig &from, PipelineConfig &to) {
+  UTIL_THROW_IF(from.order < 1, util::Exception, "The order should be at least 1.");
+  UTIL_THROW_IF(from.vocab_pad && !from.interpolate_unigrams, util::Exception, "Padding the vocabulary requires interpolating unigrams.");
+  UTIL_THROW_IF(from.arpa_precision > util::kToStringFixedMaxPrecision, util::Exception, "ARPA precision is at most " << util::kToStringFixedMaxPrecision);
+  UTIL_THROW_IF(!from.arpa_threads, util::Exception, "ARPA threads must be positive.");
+  to.order = from.order;
+  to.sort.temp_prefix = from.temp_prefix;
+  util::NormalizeTempPrefix(to.sort.temp_prefix);
+  to.sort.total_memory = from.memory;
+  to.sort.buffer_size = from.sort_block;
+  to.minimum_block = from.minimum_block;
+  to.block_count = from.block_count;
+  to.decompress_threads = 1;
+  to.vocab_estimate = from.vocab_estimate;
+  to.vocab_size_for_unk = from.vocab_pad;
+  to.initial_probs.interpolate_unigrams = from.interpolate_unigrams;
+  to.disallowed_symbol_action = from.skip_symbols ? lm::COMPLAIN : lm::THROW_UP;
+  to.renumber_vocabulary = from.renumber;
+  to.output_q = from.collapse_values;
+
+  to.prune_thresholds = from.prune;
+  UTIL_THROW_IF(to.prune_thresholds.size() > to.order, util::Exception, "Pruning thresholds were given for orders 1 through " << to.prune_thresholds.size() << " but the model only has order " << to.order);
+  for (std::size_t i = 1; i < to.prune_thresholds.size(); ++i) {
+    UTIL_THROW_IF(to.prune_thresholds[i - 1] > to.prune_thresholds[i], util::Exception, "Pruning thresholds should be in non-decreasing order.  Otherwise substrings would be removed, which is bad for query-time data structures.");
+  }
+  to.prune_thresholds.resize(to.order, to.prune_thresholds.empty() ? 0 : to.prune_thresholds.back());
+  to.prune_vocab_file = from.limit_vocab_file;
+  to.prune_vocab = !from.limit_vocab_file.empty();
+
+  // Unused without a fallback, but keeps the compiler from complaining.
+  to.discount.fallback = Discount();
+  if (from.discount_fallback.empty()) {
+    to.discount.bad_action = lm::THROW_UP;
+  } else {
+    UTIL_THROW_IF(from.discount_fallback.size() > 3, util::Exception, "Specify at most three fallback discounts: 1, 2, and 3+");
+    to.discount.bad_action = lm::COMPLAIN;
+    to.discount.fallback.amount[0] = 0.0;
+    for (unsigned i = 0; i < 3; ++i) {
+      float discount = from.discount_fallback[std::min<std::size_t>(i, from.discount_fallback.size() - 1)];
+      UTIL_THROW_IF(discount < 0.0 || discount > static_cast<float>(i + 1), util::Exception, "The discount for count " << (i + 1) << " is " << discount << " which is not in the range [0, " << (i + 1) << "].");
+      to.discount.fallback.amount[i + 1] = discount;
+    }
+  }
+
+  // Same as lmplz.
+  InitialProbabilitiesConfig &initial = to.initial_probs;
+  initial.adder_in.total_memory = 32768;
+  initial.adder_in.block_count = 2;
+  initial.adder_out.total_memory = 32768;
+  initial.adder_out.block_count = 2;
+  to.read_backoffs = initial.adder_out;
+}
+
+class RunPipeline {
+  public:
+    // Takes ownership of text and arpa.
+    RunPipeline(const PipelineConfig &config, const EstimateConfig &options, util::WriteCompressed::Format compress, int text, int arpa, std::string &error)
+      : config_(config), options_(options), compress_(compress), text_(text), arpa_(arpa), error_(error) {}
+
+    void operator()() {
+      util::scoped_fd text(text_), arpa(arpa_);
+      try {
+        Output output(config_.sort.temp_prefix, false, config_.output_q);
+        output.Add(new PrintHook(arpa.release(), options_.verbose_header, options_.arpa_precision, options_.arpa_threads, compress_, options_.compress_threads));
+        Pipeline(config_, text.release(), output);
+      } catch (const std::exception &e) {
+        error_ = e.what();
+      }
+    }
+
+  private:
+    PipelineConfig config_;
+    EstimateConfig options_;
+    util::WriteCompressed::Format compress_;
+    int text_, arpa_;
+    std::string &error_;
+};
+
+} // namespace
+
+Estimation::Estimation(const EstimateConfig &config, const std::string &arpa) {
+  PipelineConfig pipeline;
+  ToPipeline(config, pipeline);
+  util::WriteCompressed::Format compress = config.arpa_compress.empty() ? util::WriteCompressed::FormatFromName(arpa) : util::WriteCompressed::ParseFormat(config.arpa_compress);
+  util::scoped_fd arpa_file(util::CreateOrThrow(arpa.c_str()));
+  int fds[2];
+  UTIL_THROW_IF(pipe(fds), util::ErrnoException, "Failed to create a pipe for text");
+  util::scoped_fd read(fds[0]);
+  write_.reset(fds[1]);
+  thread_ = boost::thread(RunPipeline(pipeline, config, compress, read.release(), arpa_file.release(), error_));
+}
+
+Estimation::~Estimation() {
+  try {
+    Finish();
+  } catch (const std::exception &) {}
+}
+
+void Estimation::Feed(const char *data, std::size_t length) {
+  try {
+    util::WriteOrThrow(write_.get(), data, length);
+  } catch (const util::FDException &) {
+    // The pipeline stopped reading, most likely because it failed.  Report
+    // that error instead.
+    Finish();
+    throw;
+  }
+}
+
+void Estimation::Finish() {
+  write_.reset();
+  if (thread_.joinable()) thread_.join();
+  UTIL_THROW_IF(!error_.empty(), util::Exception, error_);
+}
+#else // WITH_THREADS
+// The pipeline runs on threads, so it is not compiled in.
+Estimation::Estimation(const EstimateConfig &, const std::string &) {
+  UTIL_THROW(util::Exception, "Estimating models requires compiling with WITH_THREADS.");
+}
+
+Estimation::~Estimation() {}
+
+void Estimation::Feed(const char *, std::size_t) {}
+
+void Estimation::Finish() {}
+#endif // WITH_THREADS
+
+void BuildBinary(const char *arpa, const char *binary, ngram::ModelType type, const ngram::Config &config) {
+  ngram::Config copy(config);
+  copy.write_mmap = binary;
+  if (!copy.temporary_directory_prefix.empty()) util::NormalizeTempPrefix(copy.temporary_directory_prefix);
+  copy.write_method = (type == ngram::PROBING || type == ngram::REST_PROBING) ? ngram::Config::WRITE_AFTER : ngram::Config::WRITE_MMAP;
+  util::scoped_ptr<base::Model> model(ngram::LoadVirtual(arpa, copy, type));
+}
+
+} // namespace builder
+} // namespace lm
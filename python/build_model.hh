@@ -0,0 +1,92 @@
+// Estimate and binarize models in-process for python users, who would
+// otherwise run lmplz and build_binary and pipe text to them.
+#pragma once
+
+#include "lm/model_type.hh"
+#include "lm/word_index.hh"
+#include "util/file.hh"
+
+#ifdef WITH_THREADS
+#include <boost/thread/thread.hpp>
+#endif // WITH_THREADS
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace lm {
+namespace ngram { struct Config; }
+namespace builder {
+
+// lmplz's options.  The constructor sets lmplz's defaults except memory, which
+// is 1 GB rather than 80% of physical memory because callers may build
+// several models at once.
+struct EstimateConfig {
+  EstimateConfig();
+
+  std::size_t order;
+  std::string temp_prefix;
+  uint64_t memory;
+  uint64_t minimum_block;
+  uint64_t sort_block;
+  std::size_t block_count;
+  WordIndex vocab_estimate;
+  uint64_t vocab_pad;
+  bool interpolate_unigrams;
+  bool skip_symbols;
+  bool renumber;
+  bool collapse_values;
+  bool verbose_header;
+  // As for --prune: empty for none, otherwise non-decreasing counts with the
+  // last repeated for higher orders.
+  std::vector<uint64_t> prune;
+  std::string limit_vocab_file;
+  // As for --discount_fallback: empty to throw when discounts fail, otherwise
+  // up to three discounts.
+  std::vector<float> discount_fallback;
+  unsigned int arpa_precision;
+  std::size_t arpa_threads;
+  // none, gzip, or zstd.  Empty to pick by the ARPA file's extension.
+  std::string arpa_compress;
+  std::size_t compress_threads;
+};
+
+/* Runs lmplz's pipeline on a background thread, writing an ARPA file.  Text
+ * arrives by Feed through a pipe, so the caller can produce it piece by piece.
+ * Neither Feed nor Finish touches python objects, so callers can release the
+ * GIL and several estimations can run at once.  Without WITH_THREADS, the
+ * constructor throws.
+ */
+class Estimation {
+  public:
+    // Throws if config is invalid or arpa cannot be created.
+    Estimation(const EstimateConfig &config, const std::string &arpa);
+
+    // Calls Finish if needed, ignoring errors.
+    ~Estimation();
+
+    // Append text with sentences separated by newlines.  Blocks while the
+    // pipeline catches up.  Throws if the pipeline failed.
+    void Feed(const char *data, std::size_t length);
+
+    // End of text.  Waits for the ARPA file and throws if estimation failed.
+    void Finish();
+
+  private:
+    util::scoped_fd write_;
+
+    std::string error_;
+
+#ifdef WITH_THREADS
+    boost::thread thread_;
+#endif // WITH_THREADS
+};
+
+// Convert arpa to a binary file of the given type as build_binary does,
+// honoring config's building options.  Like build_binary, probing models are
+// built in memory then written and tries are built in the mapped file.
+void BuildBinary(const char *arpa, const char *binary, ngram::ModelType type, const ngram::Config &config);
+
+} // namespace builder
+} // namespace lm
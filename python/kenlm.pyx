@@ -1,5 +1,10 @@
+# distutils: language = c++
+# cython: language_level=3str
 import os
 cimport _kenlm
+from libcpp.vector cimport vector
+from libc.string cimport memcpy
+from libc.stdint cimport uint64_t
 
 cdef bytes as_str(data):
     if isinstance(data, bytes):
@@ -84,6 +89,8 @@ class LoadMethod:
     POPULATE_OR_READ = _kenlm.POPULATE_OR_READ
     READ = _kenlm.READ
     PARALLEL_READ = _kenlm.PARALLEL_READ
+    LAZY_PREFETCH = _kenlm.LAZY_PREFETCH
+    SHARED = _kenlm.SHARED
 
 class ARPALoadComplain:
     ALL = _kenlm.ALL
@@ -241,6 +248,123 @@ cdef class Model:
                 self.vocab.EndSentence(), &out_state)
             yield (ret.prob, ret.ngram_length, False)
 
+    def score_batch(self, sentences, bos = True, eos = True, threads = 1, per_token = False):
+        """
+        score_batch(sentences, bos = True, eos = True, threads = 1, per_token = False) -> numpy array of log10 probabilities
+        Score many sentences at once.  Sentences are split on whitespace and
+        scored in C++ on up to threads threads without holding the GIL.
+        @param sentences is a sequence of strings (do not use boundary symbols)
+        @param bos and eos are as in score and apply to every sentence
+        @param per_token also returns the log10 probability of each token
+
+        Returns a float32 array with one score per sentence, matching score.
+        With per_token = True, returns (totals, words, offsets) where
+        words[offsets[i]:offsets[i+1]] are the probabilities of sentence i's
+        tokens, including </s> if eos, as in full_scores.
+
+        Requires numpy.
+        """
+        import numpy
+        cdef list encoded = [as_str(sentence) for sentence in sentences]
+        cdef size_t count = len(encoded)
+        cdef vector[char*] pointers
+        cdef vector[size_t] lengths
+        pointers.reserve(count)
+        lengths.reserve(count)
+        cdef bytes sentence_bytes
+        for sentence_bytes in encoded:
+            pointers.push_back(sentence_bytes)
+            lengths.push_back(len(sentence_bytes))
+        totals = numpy.zeros(count, dtype=numpy.float32)
+        cdef float[::1] totals_view = totals
+        cdef float *totals_ptr = &totals_view[0] if count else NULL
+        cdef vector[float] words
+        cdef vector[size_t] offsets
+        cdef bint c_bos = bos, c_eos = eos, c_per_token = per_token
+        cdef size_t c_threads = max(threads, 1)
+        with nogil:
+            _kenlm.ScoreSentences(self.model, pointers.data(), lengths.data(), count, c_bos, c_eos, c_threads, totals_ptr,
+                    &words if c_per_token else NULL, &offsets if c_per_token else NULL)
+        if not per_token:
+            return totals
+        words_array = numpy.empty(words.size(), dtype=numpy.float32)
+        cdef float[::1] words_view = words_array
+        if words.size():
+            memcpy(&words_view[0], words.data(), words.size() * sizeof(float))
+        offsets_array = numpy.empty(offsets.size(), dtype=numpy.intp)
+        cdef Py_ssize_t[::1] offsets_view = offsets_array
+        cdef size_t i
+        for i in range(offsets.size()):
+            offsets_view[i] = offsets[i]
+        return totals, words_array, offsets_array
+
+
+    def vocab_index(self, words):
+        """
+        vocab_index(words) -> numpy uint32 array of vocabulary ids
+        Look up each word in the model's vocabulary, 0 for <unk>.  Convert once
+        and pass the ids to score_ids as often as needed.
+
+        Requires numpy.
+        """
+        import numpy
+        cdef list encoded = [as_str(word) for word in words]
+        ids = numpy.empty(len(encoded), dtype=numpy.uint32)
+        cdef unsigned int[::1] ids_view = ids
+        cdef Py_ssize_t i
+        cdef bytes word_bytes
+        for i in range(len(encoded)):
+            word_bytes = encoded[i]
+            ids_view[i] = self.vocab.Index(word_bytes)
+        return ids
+
+    def score_ids(self, ids, offsets, bos = True, eos = True, threads = 1, per_token = False):
+        """
+        score_ids(ids, offsets, bos = True, eos = True, threads = 1, per_token = False) -> numpy array of log10 probabilities
+        Score sentences given as vocabulary ids, for example from vocab_index.
+        Sentence i is ids[offsets[i]:offsets[i+1]], so offsets has one more
+        entry than there are sentences.  ids and offsets may be any arrays
+        supporting the buffer protocol; contiguous uint32 ids and uintp offsets
+        are read in place without copying.  Do not include <s> or </s> ids.
+        @param bos, eos, threads, and per_token are as in score_batch
+
+        Returns a float32 array with one score per sentence.  With per_token =
+        True, returns (totals, words, word_offsets) where
+        words[word_offsets[i]:word_offsets[i+1]] are the probabilities of
+        sentence i's ids followed by </s> if eos.
+
+        Requires numpy.
+        """
+        import numpy
+        ids = numpy.ascontiguousarray(ids, dtype=numpy.uint32)
+        offsets = numpy.ascontiguousarray(offsets, dtype=numpy.uintp)
+        if ids.ndim != 1 or offsets.ndim != 1 or offsets.shape[0] == 0:
+            raise ValueError('ids and offsets should be one-dimensional and offsets should not be empty')
+        cdef const unsigned int[::1] ids_view = ids
+        cdef const size_t[::1] offsets_view = offsets
+        cdef size_t count = offsets_view.shape[0] - 1
+        if offsets_view[0] > offsets_view[count] or offsets_view[count] > <size_t>ids_view.shape[0]:
+            raise ValueError('Offsets should not decrease or go past the {} ids'.format(ids_view.shape[0]))
+        cdef const unsigned int *ids_ptr = &ids_view[0] if ids_view.shape[0] else NULL
+        totals = numpy.zeros(count, dtype=numpy.float32)
+        cdef float[::1] totals_view = totals
+        cdef float *totals_ptr = &totals_view[0] if count else NULL
+        cdef bint c_bos = bos, c_eos = eos
+        cdef size_t c_threads = max(threads, 1)
+        cdef size_t word_count = offsets_view[count] - offsets_view[0] + (count if c_eos else 0)
+        words = numpy.zeros(word_count if per_token else 0, dtype=numpy.float32)
+        cdef float[::1] words_view = words
+        cdef float *words_ptr = &words_view[0] if per_token and word_count else NULL
+        with nogil:
+            _kenlm.ScoreIds(self.model, ids_ptr, &offsets_view[0], count, c_bos, c_eos, c_threads, totals_ptr, words_ptr)
+        if not per_token:
+            return totals
+        word_offsets = offsets.astype(numpy.intp)
+        word_offsets -= word_offsets[0]
+        if eos:
+            word_offsets += numpy.arange(count + 1)
+        return totals, words, word_offsets
+
 
     def BeginSentenceWrite(self, State state):
         """Change the given state to a BOS state."""
@@ -286,3 +410,150 @@ cdef class Model:
 
 class LanguageModel(Model):
     """Backwards compatability stub.  Use Model."""
+
+cdef uint64_t parse_size(value) except? 0:
+    """Bytes as an int or a size like lmplz -S takes: 1G, 80%, etc."""
+    if isinstance(value, int):
+        return value
+    return _kenlm.ParseSize(as_str(value))
+
+# Sentences are handed to lmplz in pieces about this big.
+cdef size_t FEED_CHUNK = 1 << 20
+
+def lmplz(sentences, arpa, order, memory = '1G', temp_prefix = None,
+        prune = None, discount_fallback = None, interpolate_unigrams = True,
+        skip_symbols = False, vocab_estimate = 1000000, vocab_pad = 0,
+        minimum_block = '8K', sort_block = '64M', block_count = 2,
+        renumber = False, collapse_values = False, verbose_header = False,
+        limit_vocab_file = None, arpa_precision = 0, arpa_threads = 1,
+        arpa_compress = None, compress_threads = 1):
+    """
+    Estimate a modified Kneser-Ney language model the way the lmplz program
+    does and write it to an ARPA file, without starting a process.
+
+    :param sentences: iterable of strings, one sentence each, such as the lines of an open file
+    :param arpa: path of the ARPA file to write
+    :param order: order of the model
+
+    The remaining options match lmplz's.  Sizes are bytes or strings like
+    lmplz takes, such as '1G' or '20%'.  memory defaults to 1G rather than
+    lmplz's 80% of physical memory so that several models can be built at
+    once.  discount_fallback is a list of up to three discounts or True for
+    lmplz's default of 0.5 1 1.5.  arpa_compress is none, gzip, or zstd and
+    defaults by the extension of arpa.
+
+    The pipeline runs on native threads.  The GIL is held only while the next
+    sentences are read from the iterable, so calls from several python threads
+    build models in parallel.  Bad options raise RuntimeError, but failures
+    inside the pipeline, such as discounts that cannot be estimated from tiny
+    data, abort the process as they do lmplz.  If sentences raises, the
+    pipeline finishes on the text it already has before the exception
+    propagates and the ARPA file should be discarded.
+    """
+    cdef _kenlm.EstimateConfig config
+    config.order = order
+    if temp_prefix is not None:
+        config.temp_prefix = as_str(temp_prefix)
+    config.memory = parse_size(memory)
+    if prune is not None:
+        config.prune = prune
+    if discount_fallback is True:
+        config.discount_fallback = [0.5, 1.0, 1.5]
+    elif discount_fallback:
+        config.discount_fallback = discount_fallback
+    config.interpolate_unigrams = interpolate_unigrams
+    config.skip_symbols = skip_symbols
+    config.vocab_estimate = vocab_estimate
+    config.vocab_pad = vocab_pad
+    config.minimum_block = parse_size(minimum_block)
+    config.sort_block = parse_size(sort_block)
+    config.block_count = block_count
+    config.renumber = renumber
+    config.collapse_values = collapse_values
+    config.verbose_header = verbose_header
+    if limit_vocab_file is not None:
+        config.limit_vocab_file = as_str(limit_vocab_file)
+    config.arpa_precision = arpa_precision
+    config.arpa_threads = arpa_threads
+    if arpa_compress is not None:
+        config.arpa_compress = as_str(arpa_compress)
+    config.compress_threads = compress_threads
+
+    cdef _kenlm.Estimation *estimation = new _kenlm.Estimation(config, as_str(arpa))
+    cdef bytearray chunk = bytearray()
+    cdef char *data
+    cdef size_t length
+    try:
+        for sentence in sentences:
+            encoded = as_str(sentence)
+            chunk += encoded
+            if not encoded.endswith(b'\n'):
+                chunk += b'\n'
+            if len(chunk) >= FEED_CHUNK:
+                data = chunk
+                length = len(chunk)
+                with nogil:
+                    estimation.Feed(data, length)
+                del chunk[:]
+        data = chunk
+        length = len(chunk)
+        with nogil:
+            estimation.Feed(data, length)
+            estimation.Finish()
+    finally:
+        # Waits for the pipeline if Finish was not reached.
+        with nogil:
+            del estimation
+
+def build_binary(arpa, binary, model_type = 'probing', quantize = 0,
+        backoff_bits = None, array_bits = None,
+        memory = '1G', temp_prefix = None, word_table = False,
+        Config config = None):
+    """
+    Convert an ARPA file to a binary file the way the build_binary program
+    does, without starting a process.
+
+    :param arpa: path of the ARPA file
+    :param binary: path of the binary file to write
+    :param model_type: probing or trie
+    :param quantize: bits for probabilities (build_binary -q), trie only
+    :param backoff_bits: bits for backoffs (-b), defaults to quantize
+    :param array_bits: compress pointers with an array of offsets (-a)
+    :param memory: sorting memory for tries (-S)
+    :param temp_prefix: temporary file prefix for tries (-T), defaults to binary
+    :param word_table: include a word table for id to string lookup (-W)
+    :param config: other options, such as arpa_complain
+
+    The GIL is released while building.
+    """
+    cdef _kenlm.Config c_config = config._c_config if config is not None else _kenlm.Config()
+    cdef _kenlm.ModelType c_type
+    if backoff_bits is not None and not quantize:
+        raise ValueError('Backoff quantization requires quantize')
+    for bits in (quantize, backoff_bits, array_bits):
+        if bits is not None and not 0 <= bits <= 25:
+            raise ValueError('Bit counts are limited to 25')
+    if model_type == 'probing':
+        if quantize or array_bits is not None:
+            raise ValueError('Quantization and pointer compression are only implemented in the trie data structure')
+        c_type = _kenlm.PROBING
+    elif model_type == 'trie':
+        if array_bits is not None:
+            c_type = _kenlm.QUANT_ARRAY_TRIE if quantize else _kenlm.ARRAY_TRIE
+            c_config.pointer_bhiksha_bits = array_bits
+        else:
+            c_type = _kenlm.QUANT_TRIE if quantize else _kenlm.TRIE
+        if quantize:
+            c_config.prob_bits = quantize
+            c_config.backoff_bits = quantize if backoff_bits is None else backoff_bits
+    else:
+        raise ValueError('model_type should be probing or trie, not {}'.format(model_type))
+    c_config.building_memory = parse_size(memory)
+    if temp_prefix is not None:
+        c_config.temporary_directory_prefix = as_str(temp_prefix)
+    c_config.word_table = word_table
+    cdef bytes arpa_bytes = as_str(arpa), binary_bytes = as_str(binary)
+    cdef const char *arpa_path = arpa_bytes
+    cdef const char *binary_path = binary_bytes
+    with nogil:
+        _kenlm.BuildBinary(arpa_path, binary_path, c_type, c_config)
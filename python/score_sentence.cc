@@ -1,8 +1,16 @@
+#include "python/score_sentence.hh"
+
+#include "lm/batch_score.hh"
 #include "lm/state.hh"
 #include "lm/virtual_interface.hh"
 #include "util/tokenize_piece.hh"
 
+#ifdef WITH_THREADS
+#include <boost/thread/thread.hpp>
+#endif // WITH_THREADS
+
 #include <algorithm>
+#include <atomic>
 #include <utility>
 
 namespace lm {
@@ -26,5 +34,92 @@ float ScoreSentence(const base::Model *model, const char *sentence) {
   return ret;
 }
 
+namespace {
+
+// Blocks are handed out one at a time so threads stay busy when sentence
+// lengths vary without contending for every sentence.
+class BlockThread {
+  public:
+    BlockThread(const Model &model, const SentenceBatch &batch, std::atomic<std::size_t> &next)
+      : model_(model), batch_(batch), next_(next) {}
+
+    void operator()() {
+      std::vector<char> states;
+      for (std::size_t block; (block = next_.fetch_add(1)) < batch_.Blocks(); ) {
+        ScoreBatchBlock(model_, batch_, block, states);
+      }
+    }
+
+  private:
+    const Model &model_;
+    const SentenceBatch &batch_;
+    std::atomic<std::size_t> &next_;
+};
+
+// Score every block of batch using up to threads threads.  Without
+// WITH_THREADS, the calling thread does every block.
+void RunBlocks(const Model &model, const SentenceBatch &batch, std::size_t threads) {
+  std::atomic<std::size_t> next(0);
+#ifdef WITH_THREADS
+  threads = std::min(threads, batch.Blocks());
+#else // WITH_THREADS
+  threads = 1;
+#endif // WITH_THREADS
+  if (threads <= 1) {
+    BlockThread(model, batch, next)();
+    return;
+  }
+#ifdef WITH_THREADS
+  boost::thread_group group;
+  for (std::size_t t = 0; t < threads; ++t) {
+    group.create_thread(BlockThread(model, batch, next));
+  }
+  group.join_all();
+#endif // WITH_THREADS
+}
+
+} // namespace
+
+void ScoreSentences(const Model *model, const char *const *sentences, const std::size_t *lengths, std::size_t count, bool bos, bool eos, std::size_t threads, float *totals, std::vector<float> *words, std::vector<std::size_t> *offsets) {
+  SentenceBatch batch;
+  batch.sentences = sentences;
+  batch.lengths = lengths;
+  batch.count = count;
+  batch.begin_sentence = bos;
+  batch.end_sentence = eos;
+  batch.totals = totals;
+  std::vector<std::vector<float> > blocks;
+  if (words) {
+    blocks.resize(batch.Blocks());
+    offsets->assign(count + 1, 0);
+    batch.block_words = blocks.data();
+    // Each sentence's count goes in its end offset, summed below.
+    batch.tokens = offsets->data() + 1;
+  }
+  RunBlocks(*model, batch, threads);
+  if (!words) return;
+  for (std::size_t i = 0; i < count; ++i) {
+    (*offsets)[i + 1] += (*offsets)[i];
+  }
+  words->clear();
+  words->reserve(offsets->back());
+  for (std::size_t b = 0; b < blocks.size(); ++b) {
+    words->insert(words->end(), blocks[b].begin(), blocks[b].end());
+  }
+}
+
+void ScoreIds(const Model *model, const WordIndex *ids, const std::size_t *offsets, std::size_t count, bool bos, bool eos, std::size_t threads, float *totals, float *words) {
+  CheckBatchIds(*model, ids, offsets, count);
+  SentenceBatch batch;
+  batch.ids = ids;
+  batch.offsets = offsets;
+  batch.count = count;
+  batch.begin_sentence = bos;
+  batch.end_sentence = eos;
+  batch.totals = totals;
+  batch.words = words;
+  RunBlocks(*model, batch, threads);
+}
+
 } // namespace base
 } // namespace lm
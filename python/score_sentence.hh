@@ -2,6 +2,11 @@
 // for C++ users (who should do it themselves), but it's faster for python users.
 #pragma once
 
+#include "lm/word_index.hh"
+
+#include <cstddef>
+#include <vector>
+
 namespace lm {
 namespace base {
 
@@ -9,5 +14,21 @@ class Model;
 
 float ScoreSentence(const Model *model, const char *sentence);
 
+// Score count sentences, each split on whitespace, using up to threads
+// threads.  Sentence i is [sentences[i], sentences[i] + lengths[i]) and its
+// log10 probability goes in totals[i].  If words is not NULL, it gets the log10
+// probability of every token (including </s> if eos) and offsets gets count + 1
+// entries so that sentence i's tokens are [offsets[i], offsets[i+1]).
+// Does not touch python objects, so callers can release the GIL.
+void ScoreSentences(const Model *model, const char *const *sentences, const std::size_t *lengths, std::size_t count, bool bos, bool eos, std::size_t threads, float *totals, std::vector<float> *words, std::vector<std::size_t> *offsets);
+
+// Like ScoreSentences but for sentences already converted to vocabulary ids.
+// Sentence i is ids[offsets[i]] through ids[offsets[i+1]-1], so offsets has
+// count + 1 entries.  If words is not NULL, it gets the log10 probability of
+// every token, with </s> after each sentence if eos, so it needs
+// offsets[count] - offsets[0] + (eos ? count : 0) entries.  Throws
+// util::Exception if offsets decrease or an id is not in the vocabulary.
+void ScoreIds(const Model *model, const WordIndex *ids, const std::size_t *offsets, std::size_t count, bool bos, bool eos, std::size_t threads, float *totals, float *words);
+
 } // namespace base
 } // namespace lm
@@ -1,5 +1,6 @@
 from setuptools import setup, Extension
 from setuptools.command.build_ext import build_ext as _build_ext
+from Cython.Build import cythonize
 import glob
 import platform
 import subprocess
@@ -26,7 +27,8 @@ for element in is_max_order:
 print(f"Will build with KenLM max_order set to {max_order}")
 
 FILES = glob.glob('util/*.cc') + glob.glob('lm/*.cc') + glob.glob('util/double-conversion/*.cc') + glob.glob('python/*.cc')
-FILES = [fn for fn in FILES if not (fn.endswith('main.cc') or fn.endswith('test.cc'))]
+#The estimation pipeline behind kenlm.lmplz, which needs threads.
+ESTIMATION_FILES = glob.glob('util/stream/*.cc') + glob.glob('lm/common/*.cc') + glob.glob('lm/builder/*.cc')
 
 #We don't need -std=c++11 but python seems to be compiled with it now.  https://github.com/kpu/kenlm/issues/86
 ARGS = ['-O3', '-DNDEBUG', '-DKENLM_MAX_ORDER='+max_order, '-std=c++11']
@@ -40,6 +42,16 @@ elif platform.system() == 'Darwin':
 else:
     LIBS = []
 
+#util's thread pools, kenlm.lmplz, and Model.score_batch use boost threads.
+#Without them, lmplz raises and score_batch uses one thread.
+if compile_test('boost/thread/thread.hpp', 'boost_thread'):
+    ARGS.append('-DWITH_THREADS')
+    LIBS.append('boost_thread')
+    FILES += ESTIMATION_FILES
+
+#size_option.cc is only for boost::program_options.
+FILES = [fn for fn in FILES if not (fn.endswith('main.cc') or fn.endswith('test.cc') or fn.endswith('size_option.cc'))]
+
 #Attempted fix to https://github.com/kpu/kenlm/issues/186 and https://github.com/kpu/kenlm/issues/197
 if platform.system() == 'Darwin':
     ARGS += ["-stdlib=libc++", "-mmacosx-version-min=10.7"]
@@ -57,6 +69,14 @@ if compile_test('lzma.h', 'lzma'):
     ARGS.append('-DHAVE_XZLIB')
     LIBS.append('lzma')
 
+if compile_test('zstd.h', 'zstd'):
+    ARGS.append('-DHAVE_ZSTDLIB')
+    LIBS.append('zstd')
+
+if compile_test('lz4frame.h', 'lz4'):
+    ARGS.append('-DHAVE_LZ4LIB')
+    LIBS.append('lz4')
+
 
 class build_ext(_build_ext):
     def run(self):
@@ -111,15 +131,16 @@ class build_ext(_build_ext):
         return _build_ext.run(self)
 
 
-ext_modules = [
+#python/kenlm.cpp is generated from kenlm.pyx rather than checked in.
+ext_modules = cythonize([
     Extension(name='kenlm',
-        sources=FILES + ['python/kenlm.cpp'],
+        sources=FILES + ['python/kenlm.pyx'],
         language='C++', 
         include_dirs=['.'] + INCLUDE_PATHS,
         depends = ['python/BuildStandalone.cmake'],
         libraries=LIBS, 
         extra_compile_args=ARGS),
-]
+])
 
 setup(
     name='kenlm',
@@ -0,0 +1,84 @@
+#ifndef UTIL_BIT_PACKED_SEARCH_H
+#define UTIL_BIT_PACKED_SEARCH_H
+
+/* Search sorted keys stored in bit-packed records, as in the trie.  Record i
+ * has its key in the low key_bits of bit offset i * total_bits.
+ *
+ * Interpolation search needs a dependent unpack for every probe and stops
+ * paying off once the range is short, so BitPackedFind scans the last few
+ * entries instead.
+ */
+
+#include "bit_packing.hh"
+#include "sorted_uniform.hh"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace util {
+
+class BitPackedAccessor {
+  public:
+    BitPackedAccessor(const void *base, uint64_t key_mask, uint8_t key_bits, uint8_t total_bits)
+      : base_(reinterpret_cast<const uint8_t*>(base)), key_mask_(key_mask), key_bits_(key_bits), total_bits_(total_bits) {}
+
+    typedef uint64_t Key;
+
+    Key operator()(uint64_t index) const {
+      return ReadInt57(base_, index * static_cast<uint64_t>(total_bits_), key_bits_, key_mask_);
+    }
+
+    const uint8_t *Base() const { return base_; }
+    uint64_t KeyMask() const { return key_mask_; }
+    uint8_t KeyBits() const { return key_bits_; }
+    uint8_t TotalBits() const { return total_bits_; }
+
+  private:
+    const uint8_t *base_;
+    uint64_t key_mask_;
+    uint8_t key_bits_, total_bits_;
+};
+
+// Ranges with at most this many records are scanned.  Tuned with bit_packed_search_benchmark.
+const uint64_t kBitPackedScanBelow = 4;
+
+/* Search [begin, end) for key.  Keys are sorted, at least 0, and at most
+ * max_key.  Sets at on success.
+ */
+template <class Pivot> inline bool BitPackedFind(
+    const BitPackedAccessor &accessor,
+    uint64_t begin, uint64_t end,
+    uint64_t max_key,
+    uint64_t key,
+    uint64_t &at,
+    uint64_t scan_below = kBitPackedScanBelow) {
+  // Same as BoundedSortedUniformFind with before = begin - 1, after = end, until the range is short.
+  uint64_t before_it = begin - 1, after_it = end;
+  uint64_t before_v = 0, after_v = max_key;
+  while (after_it - before_it > scan_below + 1) {
+    uint64_t pivot = before_it + (1 + Pivot::Calc(key - before_v, after_v - before_v, after_it - before_it - 1));
+    uint64_t mid = accessor(pivot);
+    if (mid < key) {
+      before_it = pivot;
+      before_v = mid;
+    } else if (mid > key) {
+      after_it = pivot;
+      after_v = mid;
+    } else {
+      at = pivot;
+      return true;
+    }
+  }
+  for (uint64_t i = before_it + 1; i < after_it; ++i) {
+    uint64_t value = accessor(i);
+    if (value >= key) {
+      at = i;
+      return value == key;
+    }
+  }
+  return false;
+}
+
+} // namespace util
+
+#endif // UTIL_BIT_PACKED_SEARCH_H
@@ -0,0 +1,122 @@
+/* Benchmark searching a trie-like level of bit-packed records: many sorted
+ * node ranges of mostly small size.  Compares plain interpolation search with
+ * switching to a scan at various range sizes.
+ */
+#include "bit_packed_search.hh"
+#include "usage.hh"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace util {
+namespace {
+
+struct Query {
+  uint64_t begin, end, key;
+};
+
+class Level {
+  public:
+    // Total bits mimic a middle order: word, 8-bit quantized prob and backoff, and a pointer.
+    Level(uint64_t vocab, std::size_t ranges, uint8_t extra_bits, boost::mt19937 &rng)
+      : max_key_(vocab - 1), key_bits_(RequiredBits(max_key_)), total_bits_(key_bits_ + extra_bits) {
+      boost::uniform_int<uint64_t> word_dist(0, max_key_);
+      boost::variate_generator<boost::mt19937&, boost::uniform_int<uint64_t> > word(rng, word_dist);
+      // Range sizes are log-uniform in [1, 5000] so most ranges are small.
+      boost::uniform_real<double> log_size_dist(0.0, std::log(5000.0));
+      boost::variate_generator<boost::mt19937&, boost::uniform_real<double> > log_size(rng, log_size_dist);
+      std::vector<uint64_t> range;
+      for (std::size_t r = 0; r < ranges; ++r) {
+        std::size_t size = static_cast<std::size_t>(std::exp(log_size()));
+        range.clear();
+        for (std::size_t i = 0; i < size; ++i) range.push_back(word());
+        std::sort(range.begin(), range.end());
+        range.erase(std::unique(range.begin(), range.end()), range.end());
+        bounds_.push_back(keys_.size());
+        keys_.insert(keys_.end(), range.begin(), range.end());
+      }
+      bounds_.push_back(keys_.size());
+      memory_.resize((keys_.size() * total_bits_ + 7) / 8 + sizeof(uint64_t));
+      for (std::size_t i = 0; i < keys_.size(); ++i) {
+        WriteInt57(&memory_[0], i * total_bits_, key_bits_, keys_[i]);
+      }
+    }
+
+    // Half hits, half random words.
+    void MakeQueries(std::size_t count, boost::mt19937 &rng, std::vector<Query> &out) const {
+      boost::uniform_int<std::size_t> range_dist(0, bounds_.size() - 2);
+      boost::uniform_int<uint64_t> word_dist(0, max_key_);
+      out.resize(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        std::size_t r = range_dist(rng);
+        out[i].begin = bounds_[r];
+        out[i].end = bounds_[r + 1];
+        if (i % 2 && out[i].end > out[i].begin) {
+          boost::uniform_int<uint64_t> pick(out[i].begin, out[i].end - 1);
+          out[i].key = keys_[pick(rng)];
+        } else {
+          out[i].key = word_dist(rng);
+        }
+      }
+    }
+
+    BitPackedAccessor Accessor() const {
+      return BitPackedAccessor(&memory_[0], (1ULL << key_bits_) - 1, key_bits_, total_bits_);
+    }
+
+    uint64_t MaxKey() const { return max_key_; }
+
+    std::size_t Bytes() const { return memory_.size(); }
+
+  private:
+    uint64_t max_key_;
+    uint8_t key_bits_, total_bits_;
+    std::vector<uint64_t> keys_, bounds_;
+    std::vector<uint8_t> memory_;
+};
+
+// Returns a value that depends on the results so the compiler can't skip the work.
+uint64_t Run(const Level &level, const std::vector<Query> &queries, uint64_t scan_below, const char *name) {
+  BitPackedAccessor accessor(level.Accessor());
+  uint64_t meaningless = 0;
+  double start = CPUTime();
+  for (std::vector<Query>::const_iterator q = queries.begin(); q != queries.end(); ++q) {
+    uint64_t at = 0;
+    meaningless += BitPackedFind<Pivot32>(accessor, q->begin, q->end, level.MaxKey(), q->key, at, scan_below);
+    meaningless += at;
+  }
+  double elapsed = CPUTime() - start;
+  std::cout << name << ' ' << scan_below << ' ' << (elapsed * 1e9 / static_cast<double>(queries.size())) << std::endl;
+  return meaningless;
+}
+
+} // namespace
+} // namespace util
+
+int main() {
+  boost::mt19937 rng;
+  const uint64_t kScanBelow[] = {4, 8, 16, 32};
+  uint64_t meaningless = 0;
+  std::cout << "#method scan_below ns/lookup\n";
+  // Roughly L2-resident, L3-resident, and DRAM-bound levels.
+  const std::size_t kRanges[] = {200, 5000, 100000};
+  for (const std::size_t *ranges = kRanges; ranges != kRanges + sizeof(kRanges) / sizeof(std::size_t); ++ranges) {
+    const uint64_t vocab = 1 << 20;
+    util::Level level(vocab, *ranges, 28, rng);
+    std::vector<util::Query> queries;
+    level.MakeQueries(5000000, rng, queries);
+    std::cout << "#ranges " << *ranges << " bytes " << level.Bytes() << '\n';
+    meaningless += util::Run(level, queries, 0, "interpolate");
+    for (const uint64_t *below = kScanBelow; below != kScanBelow + sizeof(kScanBelow) / sizeof(uint64_t); ++below) {
+      meaningless += util::Run(level, queries, *below, "scan");
+    }
+  }
+  std::cerr << "Meaningless " << meaningless << std::endl;
+}
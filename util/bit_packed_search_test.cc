@@ -0,0 +1,85 @@
+#include "bit_packed_search.hh"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int.hpp>
+#include <boost/random/variate_generator.hpp>
+
+#define BOOST_TEST_MODULE BitPackedSearchTest
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace util {
+namespace {
+
+// Pack sorted keys with some junk in the remaining bits to make sure it is masked.
+struct Packed {
+  Packed(const std::vector<uint64_t> &keys, uint64_t max_key, uint8_t extra_bits)
+    : key_bits(RequiredBits(max_key)), total_bits(key_bits + extra_bits),
+      memory((keys.size() * total_bits + 7) / 8 + sizeof(uint64_t), 0) {
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      WriteInt57(&memory[0], i * total_bits, key_bits, keys[i]);
+      if (extra_bits) WriteInt57(&memory[0], i * total_bits + key_bits, extra_bits, (1ULL << extra_bits) - 1);
+    }
+  }
+
+  BitPackedAccessor Accessor() const {
+    return BitPackedAccessor(&memory[0], (1ULL << key_bits) - 1, key_bits, total_bits);
+  }
+
+  uint8_t key_bits, total_bits;
+  std::vector<uint8_t> memory;
+};
+
+void Check(const std::vector<uint64_t> &keys, const Packed &packed, uint64_t max_key, uint64_t key, uint64_t scan_below) {
+  std::vector<uint64_t>::const_iterator ref = std::lower_bound(keys.begin(), keys.end(), key);
+  bool expect = (ref != keys.end() && *ref == key);
+  uint64_t at = 0;
+  BOOST_CHECK_EQUAL(expect, BitPackedFind<Pivot32>(packed.Accessor(), 0, keys.size(), max_key, key, at, scan_below));
+  if (expect) BOOST_CHECK_EQUAL(static_cast<uint64_t>(ref - keys.begin()), at);
+}
+
+void RandomTest(uint64_t max_key, std::size_t entries, uint8_t extra_bits) {
+  boost::mt19937 rng;
+  boost::uniform_int<uint64_t> range(0, max_key);
+  boost::variate_generator<boost::mt19937&, boost::uniform_int<uint64_t> > gen(rng, range);
+  std::vector<uint64_t> keys;
+  for (std::size_t i = 0; i < entries; ++i) keys.push_back(gen());
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  Packed packed(keys, max_key, extra_bits);
+
+  const uint64_t kScanBelow[] = {0, 1, 3, 8, 1000};
+  for (const uint64_t *below = kScanBelow; below != kScanBelow + sizeof(kScanBelow) / sizeof(uint64_t); ++below) {
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      Check(keys, packed, max_key, keys[i], *below);
+    }
+    for (std::size_t i = 0; i < 200; ++i) {
+      Check(keys, packed, max_key, gen(), *below);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+  std::vector<uint64_t> keys;
+  Packed packed(keys, 10, 3);
+  uint64_t at;
+  BOOST_CHECK(!BitPackedFind<Pivot32>(packed.Accessor(), 0, 0, 10, 5, at));
+}
+
+BOOST_AUTO_TEST_CASE(dense) {
+  RandomTest(20, 15, 0);
+}
+
+BOOST_AUTO_TEST_CASE(sparse) {
+  RandomTest(1000000, 500, 13);
+}
+
+BOOST_AUTO_TEST_CASE(wide) {
+  RandomTest((1ULL << 32) - 1, 100, 25);
+}
+
+} // namespace
+} // namespace util
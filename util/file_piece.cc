@@ -4,6 +4,7 @@
 #include "exception.hh"
 #include "file.hh"
 #include "mmap.hh"
+#include "parse_float.hh"
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <io.h>
@@ -16,6 +17,7 @@
 #include <cerrno>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <string>
@@ -42,9 +44,10 @@ LineIterator &LineIterator::operator++() {
   return *this;
 }
 
-FilePiece::FilePiece(const char *name, std::ostream *show_progress, std::size_t min_buffer) :
+FilePiece::FilePiece(const char *name, std::ostream *show_progress, std::size_t min_buffer, std::size_t decompress_threads) :
   file_(OpenReadOrThrow(name)), total_size_(SizeFile(file_.get())),
-  progress_(total_size_, total_size_ == kBadSize ? NULL : show_progress, std::string("Reading ") + name) {
+  progress_(total_size_, total_size_ == kBadSize ? NULL : show_progress, std::string("Reading ") + name),
+  decompress_threads_(decompress_threads) {
   Initialize(name, show_progress, min_buffer);
 }
 
@@ -55,14 +58,15 @@ std::string NamePossiblyFind(int fd, const char *name) {
 }
 } // namespace
 
-FilePiece::FilePiece(int fd, const char *name, std::ostream *show_progress, std::size_t min_buffer) :
+FilePiece::FilePiece(int fd, const char *name, std::ostream *show_progress, std::size_t min_buffer, std::size_t decompress_threads) :
   file_(fd), total_size_(SizeFile(file_.get())),
-  progress_(total_size_, total_size_ == kBadSize ? NULL : show_progress, std::string("Reading ") + NamePossiblyFind(fd, name)) {
+  progress_(total_size_, total_size_ == kBadSize ? NULL : show_progress, std::string("Reading ") + NamePossiblyFind(fd, name)),
+  decompress_threads_(decompress_threads) {
   Initialize(NamePossiblyFind(fd, name).c_str(), show_progress, min_buffer);
 }
 
 FilePiece::FilePiece(std::istream &stream, const char * /*name*/, std::size_t min_buffer) :
-  total_size_(kBadSize) {
+  total_size_(kBadSize), decompress_threads_(1) {
   InitializeNoRead("istream", min_buffer);
 
   fallback_to_read_ = true;
@@ -76,8 +80,8 @@ FilePiece::FilePiece(std::istream &stream, const char * /*name*/, std::size_t mi
 StringPiece FilePiece::ReadLine(char delim, bool strip_cr) {
   std::size_t skip = 0;
   while (true) {
-    const char *i = std::find(position_ + skip, position_end_, delim);
-    if (UTIL_LIKELY(i != position_end_)) {
+    const char *i = static_cast<const char*>(memchr(position_ + skip, delim, position_end_ - position_ - skip));
+    if (UTIL_LIKELY(i)) {
       // End of line.
       // Take 1 byte off the end if it's an unwanted carriage return.
       const std::size_t subtract_cr = (
@@ -187,12 +191,16 @@ template <class T> inline int CrossPlatformIsNaN(T value) {
 }
 
 const char *ParseNumber(StringPiece str, float &out) {
+  const char *fast = FastParseFloat(str.data(), str.data() + str.size(), out);
+  if (fast) return fast;
   int count;
   out = kConverter.StringToFloat(str.data(), str.size(), &count);
   UTIL_THROW_IF_ARG(CrossPlatformIsNaN(out) && str != "NaN" && str != "nan", ParseNumberException, (FirstToken(str)), "float");
   return str.data() + count;
 }
 const char *ParseNumber(StringPiece str, double &out) {
+  const char *fast = FastParseDouble(str.data(), str.data() + str.size(), out);
+  if (fast) return fast;
   int count;
   out = kConverter.StringToDouble(str.data(), str.size(), &count);
   UTIL_THROW_IF_ARG(CrossPlatformIsNaN(out) && str != "NaN" && str != "nan", ParseNumberException, (FirstToken(str)), "double");
@@ -237,9 +245,8 @@ template <class T> T FilePiece::ReadNumber() {
 const char *FilePiece::FindDelimiterOrEOF(const bool *delim)  {
   std::size_t skip = 0;
   while (true) {
-    for (const char *i = position_ + skip; i < position_end_; ++i) {
-      if (delim[static_cast<unsigned char>(*i)]) return i;
-    }
+    const char *i = FindDelimiter(position_ + skip, position_end_, delim);
+    if (i != position_end_) return i;
     if (at_end_) {
       if (position_ == position_end_) Shift();
       return position_end_;
@@ -317,7 +324,7 @@ void FilePiece::TransitionToRead() {
   position_end_ = position_;
 
   try {
-    fell_back_.Reset(file_.release());
+    fell_back_.Reset(file_.release(), decompress_threads_);
   } catch (util::Exception &e) {
     e << " in file " << file_name_;
     throw;
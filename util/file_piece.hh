@@ -61,10 +61,10 @@ class LineIterator {
 // Memory backing the returned StringPiece may vanish on the next call.
 class FilePiece {
   public:
-    // 1 MB default.
-    explicit FilePiece(const char *file, std::ostream *show_progress = NULL, std::size_t min_buffer = 1048576);
+    // 1 MB default.  decompress_threads is passed to ReadCompressed.
+    explicit FilePiece(const char *file, std::ostream *show_progress = NULL, std::size_t min_buffer = 1048576, std::size_t decompress_threads = 1);
     // Takes ownership of fd.  name is used for messages.
-    explicit FilePiece(int fd, const char *name = NULL, std::ostream *show_progress = NULL, std::size_t min_buffer = 1048576);
+    explicit FilePiece(int fd, const char *name = NULL, std::ostream *show_progress = NULL, std::size_t min_buffer = 1048576, std::size_t decompress_threads = 1);
 
     /* Read from an istream.  Don't use this if you can avoid it.  Raw fd IO is
      * much faster.  But sometimes you just have an istream like Boost's HTTP
@@ -216,6 +216,8 @@ class FilePiece {
     std::string file_name_;
 
     ReadCompressed fell_back_;
+
+    std::size_t decompress_threads_;
 };
 
 } // namespace util
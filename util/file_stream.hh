@@ -7,6 +7,7 @@
 #include "fake_ostream.hh"
 #include "file.hh"
 #include "scoped.hh"
+#include "write_compressed.hh"
 
 #include <cassert>
 #include <cstring>
@@ -21,10 +22,20 @@ class FileStream : public FakeOStream<FileStream> {
       : buf_(util::MallocOrThrow(std::max<std::size_t>(buffer_size, kToStringMaxBytes))),
         current_(static_cast<char*>(buf_.get())),
         end_(current_ + std::max<std::size_t>(buffer_size, kToStringMaxBytes)),
-        fd_(out) {}
+        fd_(out),
+        compressed_(NULL) {}
+
+    // Write through a compressor, which must outlive this stream.  seekp is
+    // not supported.
+    explicit FileStream(WriteCompressed &out, std::size_t buffer_size = 8192)
+      : buf_(util::MallocOrThrow(std::max<std::size_t>(buffer_size, kToStringMaxBytes))),
+        current_(static_cast<char*>(buf_.get())),
+        end_(current_ + std::max<std::size_t>(buffer_size, kToStringMaxBytes)),
+        fd_(-1),
+        compressed_(&out) {}
 
 #if __cplusplus >= 201103L
-    FileStream(FileStream &&from) noexcept : buf_(from.buf_.release()), current_(from.current_), end_(from.end_), fd_(from.fd_) {
+    FileStream(FileStream &&from) noexcept : buf_(from.buf_.release()), current_(from.current_), end_(from.end_), fd_(from.fd_), compressed_(from.compressed_) {
       from.end_ = reinterpret_cast<char*>(from.buf_.get());
       from.current_ = from.end_;
     }
@@ -37,11 +48,12 @@ class FileStream : public FakeOStream<FileStream> {
     void SetFD(int to) {
       flush();
       fd_ = to;
+      compressed_ = NULL;
     }
 
     FileStream &flush() {
       if (current_ != buf_.get()) {
-        util::WriteOrThrow(fd_, buf_.get(), current_ - (char*)buf_.get());
+        WriteOut(buf_.get(), current_ - (char*)buf_.get());
         current_ = static_cast<char*>(buf_.get());
       }
       return *this;
@@ -59,12 +71,13 @@ class FileStream : public FakeOStream<FileStream> {
         std::memcpy(current_, data, length);
         current_ += length;
       } else {
-        util::WriteOrThrow(fd_, data, length);
+        WriteOut(data, length);
       }
       return *this;
     }
 
     FileStream &seekp(uint64_t to) {
+      assert(!compressed_);
       flush();
       util::SeekOrThrow(fd_, to);
       return *this;
@@ -87,9 +100,18 @@ class FileStream : public FakeOStream<FileStream> {
     }
 
   private:
+    void WriteOut(const void *data, std::size_t length) {
+      if (compressed_) {
+        compressed_->write(data, length);
+      } else {
+        util::WriteOrThrow(fd_, data, length);
+      }
+    }
+
     util::scoped_malloc buf_;
     char *current_, *end_;
     int fd_;
+    WriteCompressed *compressed_;
 };
 
 } // namespace
@@ -3,9 +3,26 @@
 #include "double-conversion/double-conversion.h"
 #include "double-conversion/utils.h"
 
+#include <cassert>
+#include <cstring>
+
 namespace util {
 namespace {
 const double_conversion::DoubleToStringConverter kConverter(double_conversion::DoubleToStringConverter::NO_FLAGS, "inf", "NaN", 'e', -6, 21, 6, 0);
+
+const uint64_t kPowersOfTen[kToStringFixedMaxPrecision + 1] = {1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL};
+
+const char kDigitPairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
 } // namespace
 
 char *ToString(double value, char *to) {
@@ -20,4 +37,32 @@ char *ToString(float value, char *to) {
   return &to[builder.position()];
 }
 
+char *ToStringFixed(float value, unsigned int precision, char *to) {
+  assert(precision <= kToStringFixedMaxPrecision);
+  double magnitude = value < 0.0f ? -static_cast<double>(value) : static_cast<double>(value);
+  // Also catches NaN.
+  if (!(magnitude < 1e9)) return ToString(value, to);
+  uint64_t scaled = static_cast<uint64_t>(magnitude * static_cast<double>(kPowersOfTen[precision]) + 0.5);
+  if (!scaled) {
+    *to = '0';
+    return to + 1;
+  }
+  if (value < 0.0f) *to++ = '-';
+  to = ToString(scaled / kPowersOfTen[precision], to);
+  uint64_t fraction = scaled % kPowersOfTen[precision];
+  if (!fraction) return to;
+  unsigned int digits = precision;
+  for (; !(fraction % 10); fraction /= 10) --digits;
+  *to++ = '.';
+  // Fill in from the right two digits at a time, including leading zeros.
+  char *end = to + digits;
+  char *i = end;
+  for (; digits >= 2; digits -= 2, fraction /= 100) {
+    i -= 2;
+    std::memcpy(i, kDigitPairs + 2 * (fraction % 100), 2);
+  }
+  if (digits) *--i = '0' + static_cast<char>(fraction);
+  return end;
+}
+
 } // namespace util
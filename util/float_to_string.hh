@@ -20,6 +20,18 @@ template <> struct ToStringBuf<float> {
 char *ToString(double value, char *to);
 char *ToString(float value, char *to);
 
+// Most bytes ToStringFixed writes.
+const unsigned kToStringFixedBytes = 21;
+const unsigned kToStringFixedMaxPrecision = 9;
+
+/* Print value rounded to precision digits after the decimal point, without
+ * trailing zeros: -4.599582, -0.30103, 0.  This is several times faster than
+ * the shortest representation that ToString prints, at the cost of digits
+ * past precision, which is fine for log10 probabilities.  Values of magnitude
+ * 1e9 or more, infinities, and NaN are printed by ToString.
+ */
+char *ToStringFixed(float value, unsigned int precision, char *to);
+
 } // namespace util
 
 #endif // UTIL_FLOAT_TO_STRING_H
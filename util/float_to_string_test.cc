@@ -0,0 +1,65 @@
+#include "float_to_string.hh"
+
+#define BOOST_TEST_MODULE FloatToStringTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+namespace util {
+namespace {
+
+std::string Fixed(float value, unsigned int precision) {
+  char buf[kToStringFixedBytes];
+  return std::string(buf, ToStringFixed(value, precision, buf));
+}
+
+BOOST_AUTO_TEST_CASE(Examples) {
+  BOOST_CHECK_EQUAL("-4.599582", Fixed(-4.599582f, 6));
+  BOOST_CHECK_EQUAL("-0.30103", Fixed(-0.30103f, 6));
+  BOOST_CHECK_EQUAL("-0.301", Fixed(-0.30103f, 3));
+  BOOST_CHECK_EQUAL("-0.3", Fixed(-0.30103f, 1));
+  BOOST_CHECK_EQUAL("0", Fixed(0.0f, 6));
+  BOOST_CHECK_EQUAL("0", Fixed(-0.0f, 6));
+  BOOST_CHECK_EQUAL("0", Fixed(-0.0000001f, 6));
+  BOOST_CHECK_EQUAL("-99", Fixed(-99.0f, 6));
+  BOOST_CHECK_EQUAL("-0.000012", Fixed(-0.0000123f, 6));
+  BOOST_CHECK_EQUAL("-1", Fixed(-0.9999999f, 6));
+  BOOST_CHECK_EQUAL("12", Fixed(12.0f, 0));
+  BOOST_CHECK_EQUAL("-0.12345679", Fixed(-0.123456789f, 8));
+}
+
+BOOST_AUTO_TEST_CASE(NotFixed) {
+  BOOST_CHECK_EQUAL("-inf", Fixed(-std::numeric_limits<float>::infinity(), 6));
+  BOOST_CHECK_EQUAL("NaN", Fixed(std::numeric_limits<float>::quiet_NaN(), 6));
+  BOOST_CHECK_EQUAL("10000000000", Fixed(1e10f, 6));
+}
+
+// Agrees with printf up to trailing zeros, away from ties.
+BOOST_AUTO_TEST_CASE(MatchesPrintf) {
+  std::srand(11);
+  char expected[64];
+  for (unsigned int i = 0; i < 100000; ++i) {
+    float value = -static_cast<float>(std::rand()) / RAND_MAX * std::pow(10.0f, static_cast<float>(std::rand() % 8 - 5));
+    unsigned int precision = i % (kToStringFixedMaxPrecision + 1);
+    std::snprintf(expected, sizeof(expected), "%.*f", precision, static_cast<double>(value));
+    std::string str(expected);
+    if (str.find('.') != std::string::npos) {
+      str.erase(str.find_last_not_of('0') + 1);
+      if (str[str.size() - 1] == '.') str.erase(str.size() - 1);
+    }
+    if (str == "-0") str = "0";
+    std::string got(Fixed(value, precision));
+    if (got != str) {
+      // Only a tie in the double rounding could differ by one in the last digit.
+      double scaled = std::fabs(static_cast<double>(value)) * std::pow(10.0, static_cast<double>(precision));
+      BOOST_CHECK_MESSAGE(std::fabs(scaled - std::floor(scaled) - 0.5) < 1e-6, "Got " << got << " but printf says " << str << " for precision " << precision);
+    }
+  }
+}
+
+} // namespace
+} // namespace util
@@ -0,0 +1,54 @@
+#include "latency_histogram.hh"
+
+#include "file_stream.hh"
+
+namespace util {
+namespace {
+// Enough buckets for any uint64_t: 64 exact then 32 for each shift from 1 to 58.
+const std::size_t kBuckets = (64 - 5 + 1) * 32;
+} // namespace
+
+LatencyHistogram::LatencyHistogram() : counts_(kBuckets), count_(0), max_(0) {}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (std::size_t i = 0; i < counts_.size(); ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  if (other.max_ > max_) max_ = other.max_;
+}
+
+uint64_t LatencyHistogram::BucketTop(unsigned int bucket) {
+  if (bucket < 2 * kSubBuckets) return bucket;
+  unsigned int shift = bucket / kSubBuckets - 1;
+  uint64_t sub = bucket % kSubBuckets + kSubBuckets;
+  return ((sub + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const {
+  if (!count_) return 0;
+  // Rank of the value we want, counting from 1.
+  uint64_t rank = static_cast<uint64_t>(fraction * static_cast<double>(count_) + 0.5);
+  if (rank == 0) rank = 1;
+  if (rank > count_) rank = count_;
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      uint64_t top = BucketTop(i);
+      return top < max_ ? top : max_;
+    }
+  }
+  return max_;
+}
+
+void LatencyHistogram::Print(const char *name, FileStream &out) const {
+  out << name << " count: " << count_
+    << " p50: " << Percentile(0.5)
+    << " p90: " << Percentile(0.9)
+    << " p99: " << Percentile(0.99)
+    << " p99.9: " << Percentile(0.999)
+    << " max: " << max_ << " ns\n";
+}
+
+} // namespace util
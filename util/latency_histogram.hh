@@ -0,0 +1,74 @@
+#ifndef UTIL_LATENCY_HISTOGRAM_H
+#define UTIL_LATENCY_HISTOGRAM_H
+
+/* Histogram of latencies in nanoseconds for reporting percentiles.  Like an
+ * HDR histogram, buckets are exact below 64 then each power of two is split
+ * into 32 buckets, so a percentile is off by at most 1/32 of its value.
+ * Recording is an increment, so each thread should keep its own histogram and
+ * Merge them at the end.
+ */
+
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+namespace util {
+
+class FileStream;
+
+// Monotonic clock for latencies, in nanoseconds.
+inline uint64_t LatencyClock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class LatencyHistogram {
+  public:
+    LatencyHistogram();
+
+    void Add(uint64_t nanoseconds) {
+      ++counts_[Bucket(nanoseconds)];
+      ++count_;
+      if (nanoseconds > max_) max_ = nanoseconds;
+    }
+
+    void Merge(const LatencyHistogram &other);
+
+    uint64_t Count() const { return count_; }
+
+    uint64_t Max() const { return max_; }
+
+    /* Smallest value v, up to bucket precision, such that at least fraction
+     * of the recorded latencies are <= v.  0 if nothing was recorded.
+     */
+    uint64_t Percentile(double fraction) const;
+
+    // Write one line: name, count, p50, p90, p99, p99.9, and max.
+    void Print(const char *name, FileStream &out) const;
+
+  private:
+    static const unsigned int kSubBits = 5;
+    static const uint64_t kSubBuckets = 1ULL << kSubBits;
+
+    static unsigned int Bucket(uint64_t value) {
+      if (value < 2 * kSubBuckets) return static_cast<unsigned int>(value);
+#if defined(__GNUC__)
+      unsigned int shift = 63 - __builtin_clzll(value) - kSubBits;
+#else
+      unsigned int shift = 0;
+      while ((value >> shift) >= 2 * kSubBuckets) ++shift;
+#endif
+      return (shift + 1) * kSubBuckets + static_cast<unsigned int>((value >> shift) - kSubBuckets);
+    }
+
+    // Largest value that lands in bucket.
+    static uint64_t BucketTop(unsigned int bucket);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t max_;
+};
+
+} // namespace util
+
+#endif // UTIL_LATENCY_HISTOGRAM_H
@@ -0,0 +1,62 @@
+#include "latency_histogram.hh"
+
+#define BOOST_TEST_MODULE LatencyHistogramTest
+#include <boost/test/unit_test.hpp>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Empty) {
+  LatencyHistogram histogram;
+  BOOST_CHECK_EQUAL(0U, histogram.Count());
+  BOOST_CHECK_EQUAL(0U, histogram.Percentile(0.5));
+  BOOST_CHECK_EQUAL(0U, histogram.Max());
+}
+
+BOOST_AUTO_TEST_CASE(Exact) {
+  LatencyHistogram histogram;
+  for (uint64_t i = 1; i <= 50; ++i) histogram.Add(i);
+  BOOST_CHECK_EQUAL(50U, histogram.Count());
+  BOOST_CHECK_EQUAL(25U, histogram.Percentile(0.5));
+  BOOST_CHECK_EQUAL(45U, histogram.Percentile(0.9));
+  BOOST_CHECK_EQUAL(50U, histogram.Percentile(1.0));
+  BOOST_CHECK_EQUAL(50U, histogram.Max());
+}
+
+BOOST_AUTO_TEST_CASE(Precision) {
+  LatencyHistogram histogram;
+  for (uint64_t i = 1; i <= 1000000; ++i) histogram.Add(i * 1000);
+  const double fractions[] = {0.5, 0.9, 0.99, 0.999};
+  for (unsigned int i = 0; i < sizeof(fractions) / sizeof(double); ++i) {
+    double expect = fractions[i] * 1e9;
+    double got = static_cast<double>(histogram.Percentile(fractions[i]));
+    BOOST_CHECK(got >= expect);
+    BOOST_CHECK(got <= expect * (1.0 + 1.0 / 32.0));
+  }
+  BOOST_CHECK_EQUAL(1000000000ULL, histogram.Percentile(1.0));
+  BOOST_CHECK_EQUAL(1000000000ULL, histogram.Max());
+}
+
+BOOST_AUTO_TEST_CASE(Tail) {
+  LatencyHistogram histogram;
+  for (unsigned int i = 0; i < 999; ++i) histogram.Add(50);
+  histogram.Add(1ULL << 40);
+  BOOST_CHECK_EQUAL(50U, histogram.Percentile(0.99));
+  BOOST_CHECK_EQUAL(1ULL << 40, histogram.Percentile(1.0));
+  histogram.Add(~0ULL);
+  BOOST_CHECK_EQUAL(~0ULL, histogram.Max());
+}
+
+BOOST_AUTO_TEST_CASE(Merge) {
+  LatencyHistogram a, b;
+  for (unsigned int i = 0; i < 90; ++i) a.Add(10);
+  for (unsigned int i = 0; i < 10; ++i) b.Add(1000);
+  a.Merge(b);
+  BOOST_CHECK_EQUAL(100U, a.Count());
+  BOOST_CHECK_EQUAL(10U, a.Percentile(0.9));
+  BOOST_CHECK_EQUAL(1000U, a.Percentile(0.95));
+  BOOST_CHECK_EQUAL(1000U, a.Max());
+}
+
+} // namespace
+} // namespace util
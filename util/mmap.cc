@@ -302,6 +302,7 @@ void HugeRealloc(std::size_t to, bool zero_new, scoped_memory &mem) {
 void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out) {
   switch (method) {
     case LAZY:
+    case LAZY_PREFETCH:
       out.reset(MapOrThrow(size, false, kFileFlags, false, fd, offset), size, scoped_memory::MMAP_ALLOCATED);
       break;
     case POPULATE_OR_LAZY:
@@ -321,6 +322,9 @@ void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scope
     case PARALLEL_READ:
       UTIL_THROW(Exception, "Parallel read was removed from this repo.");
       break;
+    case SHARED:
+      UTIL_THROW(Exception, "Shared memory segments are named; use util::SharedSegment instead of MapRead.");
+      break;
   }
 }
 
@@ -153,6 +153,14 @@ enum LoadMethod {
   READ,
   // malloc and read in parallel (recommended for Lustre)
   PARALLEL_READ,
+  // mmap with no prepopulate and return immediately.  The owner of the
+  // mapping should then start a util::Prefetcher (see prefetch.hh) to fault
+  // it in from background threads.
+  LAZY_PREFETCH,
+  // Copy into a named shared memory segment, or attach read-only if another
+  // process already did, so processes share one copy.  The owner of the
+  // mapping should use util::SharedSegment (see shared_segment.hh).
+  SHARED,
 };
 
 void MapRead(LoadMethod method, int fd, uint64_t offset, std::size_t size, scoped_memory &out);
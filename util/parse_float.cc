@@ -0,0 +1,113 @@
+#include "parse_float.hh"
+
+#include "spaces.hh"
+
+#include <cfloat>
+#include <cstring>
+
+#include <stdint.h>
+
+namespace util {
+namespace {
+
+// Exactly representable as doubles.
+const double kPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Integers up to 2^53 are exact.
+const uint64_t kMaxExactMantissa = 1ULL << 53;
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Append a digit, returning false if 19 significant digits are exceeded.
+inline bool Append(char c, uint64_t &mantissa, unsigned int &significant) {
+  if (mantissa || c != '0') {
+    if (++significant > 19) return false;
+  }
+  mantissa = mantissa * 10 + (c - '0');
+  return true;
+}
+
+// Parse to a correctly rounded double.  Zero keeps its sign like strtod.
+const char *ParseDecimal(const char *p, const char *end, double &out) {
+  bool negative = false;
+  if (p != end && *p == '-') {
+    negative = true;
+    ++p;
+  }
+  uint64_t mantissa = 0;
+  unsigned int significant = 0;
+  int exponent = 0;
+  const char *digits = p;
+  for (; p != end && IsDigit(*p); ++p) {
+    if (!Append(*p, mantissa, significant)) return NULL;
+  }
+  bool any = (p != digits);
+  if (p != end && *p == '.') {
+    const char *fraction = ++p;
+    for (; p != end && IsDigit(*p); ++p) {
+      if (!Append(*p, mantissa, significant)) return NULL;
+      --exponent;
+    }
+    // Leave "1." to the converter.
+    if (p == fraction) return NULL;
+    any = true;
+  }
+  if (!any) return NULL;
+  if (p != end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negative_exponent = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+      negative_exponent = (*p == '-');
+      ++p;
+    }
+    const char *exponent_digits = p;
+    int value = 0;
+    for (; p != end && IsDigit(*p) && value < 1000; ++p) {
+      value = value * 10 + (*p - '0');
+    }
+    if (p == exponent_digits) return NULL;
+    exponent += negative_exponent ? -value : value;
+  }
+  // Trailing junk is the converter's business.
+  if (p != end && !kSpaces[static_cast<unsigned char>(*p)]) return NULL;
+  if (mantissa == 0) {
+    out = negative ? -0.0 : 0.0;
+    return p;
+  }
+  if (mantissa > kMaxExactMantissa || exponent < -22 || exponent > 22) return NULL;
+  double value = static_cast<double>(mantissa);
+  value = (exponent < 0) ? value / kPowersOfTen[-exponent] : value * kPowersOfTen[exponent];
+  out = negative ? -value : value;
+  return p;
+}
+
+} // namespace
+
+const char *FastParseDouble(const char *begin, const char *end, double &out) {
+  return ParseDecimal(begin, end, out);
+}
+
+const char *FastParseFloat(const char *begin, const char *end, float &out) {
+  double value;
+  const char *ret = ParseDecimal(begin, end, value);
+  if (!ret) return NULL;
+  if (value != 0.0) {
+    double magnitude = value < 0.0 ? -value : value;
+    if (magnitude < FLT_MIN || magnitude > FLT_MAX) return NULL;
+    /* Rounding the correctly rounded double to float is only wrong if the
+     * double landed exactly halfway between two floats, which shows as the
+     * 29 bits that float drops being 1 followed by zeros.
+     */
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & ((1ULL << 29) - 1)) == (1ULL << 28)) return NULL;
+  }
+  out = static_cast<float>(value);
+  return ret;
+}
+
+} // namespace util
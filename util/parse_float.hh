@@ -0,0 +1,20 @@
+#ifndef UTIL_PARSE_FLOAT_H
+#define UTIL_PARSE_FLOAT_H
+
+/* Fast path for the numbers in ARPA files: an optional '-', digits with an
+ * optional fraction, and an optional exponent, followed by a space or the end.
+ * Values with at most 19 significant digits and a decimal exponent within
+ * +/-22 are computed with one exact multiply or divide, so they are correctly
+ * rounded.  Anything else returns NULL so the caller can fall back to
+ * double-conversion, whose results these match exactly.
+ */
+
+namespace util {
+
+// Returns the end of the number or NULL.
+const char *FastParseFloat(const char *begin, const char *end, float &out);
+const char *FastParseDouble(const char *begin, const char *end, double &out);
+
+} // namespace util
+
+#endif // UTIL_PARSE_FLOAT_H
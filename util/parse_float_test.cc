@@ -0,0 +1,100 @@
+#include "parse_float.hh"
+
+#include "double-conversion/double-conversion.h"
+
+#define BOOST_TEST_MODULE ParseFloatTest
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace util {
+namespace {
+
+// As FilePiece configures it.
+const double_conversion::StringToDoubleConverter kConverter(
+    double_conversion::StringToDoubleConverter::ALLOW_TRAILING_JUNK | double_conversion::StringToDoubleConverter::ALLOW_LEADING_SPACES,
+    std::numeric_limits<double>::quiet_NaN(),
+    std::numeric_limits<double>::quiet_NaN(),
+    "inf",
+    "NaN");
+
+// If the fast path takes str, it agrees with the converter bit for bit.
+bool CheckFloat(const std::string &str) {
+  float fast;
+  const char *end = FastParseFloat(str.data(), str.data() + str.size(), fast);
+  if (!end) return false;
+  int count;
+  float slow = kConverter.StringToFloat(str.data(), str.size(), &count);
+  BOOST_CHECK_MESSAGE(!std::memcmp(&fast, &slow, sizeof(float)), str << " parsed to " << fast << " instead of " << slow);
+  BOOST_CHECK_EQUAL(count, end - str.data());
+  return true;
+}
+
+bool CheckDouble(const std::string &str) {
+  double fast;
+  const char *end = FastParseDouble(str.data(), str.data() + str.size(), fast);
+  if (!end) return false;
+  int count;
+  double slow = kConverter.StringToDouble(str.data(), str.size(), &count);
+  BOOST_CHECK_MESSAGE(!std::memcmp(&fast, &slow, sizeof(double)), str << " parsed to " << fast << " instead of " << slow);
+  BOOST_CHECK_EQUAL(count, end - str.data());
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE(ARPAShapes) {
+  const char *kTake[] = {"0", "-0", "-4.599582", "-0.9972678", "-0.30103", "-1.2e-05", "-1.5E+2", "12", "-99", "0.000", "-3.010299956639812\t", "-1.5 <s>", "-2.25\n"};
+  for (std::size_t i = 0; i < sizeof(kTake) / sizeof(const char*); ++i) {
+    BOOST_CHECK_MESSAGE(CheckFloat(kTake[i]), "Fast path declined " << kTake[i]);
+    BOOST_CHECK_MESSAGE(CheckDouble(kTake[i]), "Fast path declined " << kTake[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Declines) {
+  const char *kDecline[] = {"", "-", "inf", "-inf", "NaN", "nan", "+1", "1.", "1e", "1e+", "1.5x", "1.5.3", "-1.2e-30", "1e40", "12345678901234567890", "-3.0102999566398120", "-0.123456789012345678901"};
+  for (std::size_t i = 0; i < sizeof(kDecline) / sizeof(const char*); ++i) {
+    float f;
+    double d;
+    BOOST_CHECK_MESSAGE(!FastParseFloat(kDecline[i], kDecline[i] + std::strlen(kDecline[i]), f), "Fast path took " << kDecline[i]);
+    BOOST_CHECK_MESSAGE(!FastParseDouble(kDecline[i], kDecline[i] + std::strlen(kDecline[i]), d), "Fast path took " << kDecline[i]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Random) {
+  std::srand(7);
+  char buf[40];
+  unsigned int taken = 0;
+  const unsigned int kTrials = 200000;
+  for (unsigned int i = 0; i < kTrials; ++i) {
+    double value = -static_cast<double>(std::rand()) / RAND_MAX * std::pow(10.0, std::rand() % 12 - 8);
+    const char *formats[] = {"%.6f", "%.8g", "%.9g", "%.17g", "%.3e"};
+    std::snprintf(buf, sizeof(buf), formats[i % 5], value);
+    taken += CheckFloat(buf);
+    CheckDouble(buf);
+  }
+  // Nearly everything should take the fast path.
+  BOOST_CHECK(taken > kTrials * 3 / 4);
+}
+
+/* Decimals whose nearest double is exactly halfway between two floats.
+ * Rounding that double again would round to even, which is wrong when the
+ * decimal is just below the midpoint.
+ */
+BOOST_AUTO_TEST_CASE(Halfway) {
+  // 2^24 + 1 is halfway between 2^24 and 2^24 + 2.
+  BOOST_CHECK(!CheckFloat("16777217"));
+  // Just below and above 1 + 3 * 2^-24.
+  BOOST_CHECK(!CheckFloat("1.00000017881393432"));
+  BOOST_CHECK(!CheckFloat("1.00000017881393433"));
+  // The double path has no such problem.
+  BOOST_CHECK(CheckDouble("16777217"));
+  BOOST_CHECK(CheckDouble("1.000000178813934"));
+  BOOST_CHECK(CheckFloat("16777218"));
+}
+
+} // namespace
+} // namespace util
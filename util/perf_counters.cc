@@ -0,0 +1,115 @@
+#include "perf_counters.hh"
+
+#include "file.hh"
+
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define UTIL_PERF_COUNTERS_LINUX
+#endif
+
+namespace util {
+
+const char *PerfCounters::Name(Event event) {
+  switch (event) {
+    case INSTRUCTIONS:
+      return "instructions";
+    case LLC_MISSES:
+      return "LLC misses";
+    case DTLB_MISSES:
+      return "dTLB misses";
+    case BRANCH_MISSES:
+      return "branch mispredicts";
+    default:
+      return "unknown";
+  }
+}
+
+#ifdef UTIL_PERF_COUNTERS_LINUX
+namespace {
+
+int Open(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  // This thread on any CPU.
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t CacheMiss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+  fd_[INSTRUCTIONS] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  fd_[LLC_MISSES] = Open(PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_LL));
+  fd_[DTLB_MISSES] = Open(PERF_TYPE_HW_CACHE, CacheMiss(PERF_COUNT_HW_CACHE_DTLB));
+  fd_[BRANCH_MISSES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) {
+    if (fd_[i] == -1 && error_.empty()) {
+      error_ = std::string(Name(static_cast<Event>(i))) + ": " + strerror(errno);
+    }
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) {
+    if (fd_[i] != -1) close(fd_[i]);
+  }
+}
+
+void PerfCounters::Start() {
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) {
+    if (fd_[i] != -1) ioctl(fd_[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void PerfCounters::Stop() {
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) {
+    if (fd_[i] != -1) ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+  }
+}
+
+uint64_t PerfCounters::Value(Event event) const {
+  if (fd_[event] == -1) return 0;
+  uint64_t ret;
+  ReadOrThrow(fd_[event], &ret, sizeof(uint64_t));
+  return ret;
+}
+
+#else // UTIL_PERF_COUNTERS_LINUX
+
+PerfCounters::PerfCounters() : error_("perf_event_open is only available on Linux") {
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) fd_[i] = -1;
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::Start() {}
+
+void PerfCounters::Stop() {}
+
+uint64_t PerfCounters::Value(Event) const { return 0; }
+
+#endif // UTIL_PERF_COUNTERS_LINUX
+
+bool PerfCounters::Any() const {
+  for (unsigned int i = 0; i < EVENT_COUNT; ++i) {
+    if (fd_[i] != -1) return true;
+  }
+  return false;
+}
+
+} // namespace util
@@ -0,0 +1,58 @@
+#ifndef UTIL_PERF_COUNTERS_H
+#define UTIL_PERF_COUNTERS_H
+
+/* Hardware performance counters for the calling thread, counting user space
+ * only.  This uses perf_event_open on Linux.  Counters that the platform,
+ * kernel, or permissions (see /proc/sys/kernel/perf_event_paranoid) do not
+ * allow are simply unavailable, so callers should check Available.
+ */
+
+#include <boost/noncopyable.hpp>
+
+#include <string>
+
+#include <stdint.h>
+
+namespace util {
+
+class PerfCounters : boost::noncopyable {
+  public:
+    enum Event {
+      INSTRUCTIONS,
+      LLC_MISSES,
+      DTLB_MISSES,
+      BRANCH_MISSES,
+      EVENT_COUNT
+    };
+
+    static const char *Name(Event event);
+
+    // Open counters for the calling thread.  They start stopped at 0.
+    PerfCounters();
+
+    ~PerfCounters();
+
+    bool Available(Event event) const { return fd_[event] != -1; }
+
+    // Is any counter available?
+    bool Any() const;
+
+    // Why the first unavailable counter failed to open.
+    const std::string &Error() const { return error_; }
+
+    // Start and stop counting.  Counts accumulate across intervals.
+    void Start();
+    void Stop();
+
+    // Count so far.  0 if unavailable.
+    uint64_t Value(Event event) const;
+
+  private:
+    int fd_[EVENT_COUNT];
+
+    std::string error_;
+};
+
+} // namespace util
+
+#endif // UTIL_PERF_COUNTERS_H
@@ -0,0 +1,33 @@
+#include "perf_counters.hh"
+
+#define BOOST_TEST_MODULE PerfCountersTest
+#include <boost/test/unit_test.hpp>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Instructions) {
+  PerfCounters counters;
+  if (!counters.Available(PerfCounters::INSTRUCTIONS)) {
+    BOOST_TEST_MESSAGE("Instruction counter unavailable: " << counters.Error());
+    return;
+  }
+  BOOST_CHECK_EQUAL(0U, counters.Value(PerfCounters::INSTRUCTIONS));
+  counters.Start();
+  volatile uint64_t sum = 0;
+  for (uint64_t i = 0; i < 100000; ++i) sum += i;
+  counters.Stop();
+  uint64_t first = counters.Value(PerfCounters::INSTRUCTIONS);
+  BOOST_CHECK(first >= 100000);
+  // Stopped counters do not count.
+  for (uint64_t i = 0; i < 100000; ++i) sum += i;
+  BOOST_CHECK_EQUAL(first, counters.Value(PerfCounters::INSTRUCTIONS));
+}
+
+BOOST_AUTO_TEST_CASE(Names) {
+  BOOST_CHECK_EQUAL(std::string("instructions"), PerfCounters::Name(PerfCounters::INSTRUCTIONS));
+  BOOST_CHECK_EQUAL(std::string("dTLB misses"), PerfCounters::Name(PerfCounters::DTLB_MISSES));
+}
+
+} // namespace
+} // namespace util
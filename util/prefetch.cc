@@ -0,0 +1,114 @@
+#include "prefetch.hh"
+
+#include "mmap.hh"
+#include "usage.hh"
+
+#include <algorithm>
+#include <ostream>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#endif
+
+#ifdef WITH_THREADS
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#endif
+
+namespace util {
+
+#ifdef WITH_THREADS
+struct Prefetcher::Background {
+  boost::mutex messages_mutex;
+  // Joining a boost::thread from two threads at once is undefined.
+  boost::mutex join_mutex;
+  boost::thread_group threads;
+};
+#else // WITH_THREADS
+struct Prefetcher::Background {};
+#endif
+
+const std::size_t Prefetcher::kDefaultChunk;
+
+Prefetcher::Prefetcher(const std::vector<PrefetchRange> &ranges, unsigned int threads, std::size_t chunk, std::ostream *messages)
+  : ranges_(ranges.size()), remaining_(new std::atomic<uint64_t>[ranges.size()]), total_(0), next_(0), done_(0),
+    messages_(messages), start_(messages ? WallTime() : 0.0), background_(new Background()) {
+  // Chunks start on page boundaries so they can be advised.
+  const std::size_t page = SizePage();
+  chunk = std::max(page, chunk - chunk % page);
+  for (std::size_t r = 0; r < ranges.size(); ++r) {
+    remaining_[r].store(ranges[r].size);
+    total_ += ranges[r].size;
+    if (messages_) {
+      names_.push_back(ranges[r].name);
+      sizes_.push_back(ranges[r].size);
+    }
+    const uint8_t *begin = static_cast<const uint8_t*>(ranges[r].begin);
+    const uint8_t *end = begin + ranges[r].size;
+    while (begin != end) {
+      Chunk add;
+      add.begin = begin;
+      const std::size_t to_boundary = chunk - reinterpret_cast<uintptr_t>(begin) % chunk;
+      add.size = std::min<std::size_t>(to_boundary, end - begin);
+      add.range = r;
+      chunks_.push_back(add);
+      begin += add.size;
+    }
+  }
+#ifdef WITH_THREADS
+  threads = std::min<std::size_t>(std::max(1U, threads), chunks_.size());
+  for (unsigned int i = 0; i < threads; ++i) {
+    background_->threads.add_thread(new boost::thread(&Prefetcher::Run, this));
+  }
+#else
+  (void)threads;
+  Run();
+#endif
+}
+
+Prefetcher::~Prefetcher() {
+#ifdef WITH_THREADS
+  // Claim the remaining chunks so threads exit after their current chunk.
+  next_.store(chunks_.size());
+  boost::mutex::scoped_lock lock(background_->join_mutex);
+  background_->threads.join_all();
+#endif
+}
+
+void Prefetcher::Wait() {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(background_->join_mutex);
+  background_->threads.join_all();
+#endif
+}
+
+void Prefetcher::Run() {
+  const std::size_t page = SizePage();
+  for (std::size_t i; (i = next_.fetch_add(1)) < chunks_.size();) {
+    const Chunk &chunk = chunks_[i];
+    const uintptr_t first_page = reinterpret_cast<uintptr_t>(chunk.begin) - reinterpret_cast<uintptr_t>(chunk.begin) % page;
+#if !defined(_WIN32) && !defined(_WIN64)
+    // Best effort: the touches below fault in anything this did not read ahead.
+    madvise(reinterpret_cast<void*>(first_page), reinterpret_cast<uintptr_t>(chunk.begin) + chunk.size - first_page, MADV_WILLNEED);
+#endif
+    uint8_t sum = 0;
+    for (const volatile uint8_t *p = chunk.begin; p < chunk.begin + chunk.size; p += page) {
+      sum += *p;
+    }
+    if (chunk.size) sum += *(reinterpret_cast<const volatile uint8_t*>(chunk.begin) + chunk.size - 1);
+    (void)sum;
+    done_.fetch_add(chunk.size, std::memory_order_relaxed);
+    if (remaining_[chunk.range].fetch_sub(chunk.size, std::memory_order_release) == chunk.size && messages_) {
+      Report(chunk.range);
+    }
+  }
+}
+
+void Prefetcher::Report(std::size_t range) {
+#ifdef WITH_THREADS
+  boost::mutex::scoped_lock lock(background_->messages_mutex);
+#endif
+  *messages_ << "Prefetched " << (names_[range].empty() ? "range" : names_[range].c_str()) << " (" << sizes_[range] << " bytes) after " << (WallTime() - start_) << " seconds." << std::endl;
+}
+
+} // namespace util
@@ -0,0 +1,97 @@
+#ifndef UTIL_PREFETCH_H
+#define UTIL_PREFETCH_H
+
+/* Bring a lazily mapped file into the page cache from background threads so
+ * that loading returns immediately but queries soon stop faulting.  Ranges
+ * are cut into chunks that are handed out in order, so earlier ranges finish
+ * first.  Each chunk is advised with MADV_WILLNEED, then one byte per page is
+ * touched so the pages are also mapped into this process.  Optionally, a line
+ * is logged as each named range finishes.
+ *
+ * Without WITH_THREADS, the constructor does all the work before returning.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace util {
+
+struct PrefetchRange {
+  PrefetchRange(const void *begin_in, std::size_t size_in, const std::string &name_in = std::string())
+    : begin(begin_in), size(size_in), name(name_in) {}
+  const void *begin;
+  std::size_t size;
+  // Used in progress messages.
+  std::string name;
+};
+
+class Prefetcher {
+  public:
+    static const std::size_t kDefaultChunk = 1ULL << 24; // 16 MB
+
+    // The memory must outlive this object.  Threads start immediately.  If
+    // messages is not NULL, log each non-empty range when it is done.
+    Prefetcher(const std::vector<PrefetchRange> &ranges, unsigned int threads, std::size_t chunk = kDefaultChunk, std::ostream *messages = NULL);
+
+    // Stops any remaining work and joins the threads.
+    ~Prefetcher();
+
+    uint64_t Total() const { return total_; }
+
+    uint64_t Done() const { return done_.load(std::memory_order_relaxed); }
+
+    bool Ready() const { return Done() == total_; }
+
+    // Has ranges[range] been fully prefetched?
+    bool Ready(std::size_t range) const {
+      return !remaining_[range].load(std::memory_order_acquire);
+    }
+
+    std::size_t Ranges() const { return ranges_; }
+
+    // Block until everything is prefetched.  Safe to call from several
+    // threads.
+    void Wait();
+
+  private:
+    struct Chunk {
+      const uint8_t *begin;
+      std::size_t size;
+      std::size_t range;
+    };
+
+    void Run();
+
+    void Report(std::size_t range);
+
+    std::vector<Chunk> chunks_;
+    std::size_t ranges_;
+    std::unique_ptr<std::atomic<uint64_t>[]> remaining_;
+    uint64_t total_;
+
+    std::atomic<std::size_t> next_;
+    std::atomic<uint64_t> done_;
+
+    // Only kept for messages.
+    std::vector<std::string> names_;
+    std::vector<std::size_t> sizes_;
+    std::ostream *messages_;
+    double start_;
+
+    // Threads and their locks, so this header does not need Boost.Thread.
+    struct Background;
+    std::unique_ptr<Background> background_;
+
+    Prefetcher(const Prefetcher &);
+    Prefetcher &operator=(const Prefetcher &);
+};
+
+} // namespace util
+
+#endif // UTIL_PREFETCH_H
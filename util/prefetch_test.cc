@@ -0,0 +1,77 @@
+#include "prefetch.hh"
+
+#include "file.hh"
+#include "mmap.hh"
+#include "scoped.hh"
+
+#define BOOST_TEST_MODULE PrefetchTest
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <vector>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(Empty) {
+  std::vector<PrefetchRange> ranges;
+  Prefetcher prefetch(ranges, 2);
+  BOOST_CHECK(prefetch.Ready());
+  BOOST_CHECK_EQUAL(0U, prefetch.Total());
+  prefetch.Wait();
+}
+
+BOOST_AUTO_TEST_CASE(File) {
+  // Odd sizes so ranges and chunks do not line up with pages.
+  const std::size_t kSize = 5 * SizePage() + 17;
+  scoped_fd file(MakeTemp("prefetch_test"));
+  std::vector<char> data(kSize, 'a');
+  WriteOrThrow(file.get(), &data[0], kSize);
+  scoped_memory mem;
+  MapRead(LAZY_PREFETCH, file.get(), 0, kSize, mem);
+
+  std::vector<PrefetchRange> ranges;
+  ranges.push_back(PrefetchRange(mem.begin(), 100));
+  ranges.push_back(PrefetchRange(mem.begin() + 100, 0));
+  ranges.push_back(PrefetchRange(mem.begin() + 100, kSize - 100));
+  Prefetcher prefetch(ranges, 3, SizePage() + 1);
+  BOOST_CHECK_EQUAL(kSize, prefetch.Total());
+  BOOST_CHECK_EQUAL(3U, prefetch.Ranges());
+  prefetch.Wait();
+  BOOST_CHECK(prefetch.Ready());
+  BOOST_CHECK_EQUAL(kSize, prefetch.Done());
+  for (std::size_t i = 0; i < 3; ++i) {
+    BOOST_CHECK(prefetch.Ready(i));
+  }
+  BOOST_CHECK_EQUAL('a', mem.begin()[kSize - 1]);
+}
+
+BOOST_AUTO_TEST_CASE(Messages) {
+  std::vector<char> data(3 * SizePage());
+  std::vector<PrefetchRange> ranges;
+  ranges.push_back(PrefetchRange(&data[0], SizePage(), "first"));
+  ranges.push_back(PrefetchRange(&data[SizePage()], 0, "empty"));
+  ranges.push_back(PrefetchRange(&data[SizePage()], 2 * SizePage(), "second"));
+  std::ostringstream messages;
+  {
+    Prefetcher prefetch(ranges, 2, SizePage(), &messages);
+    prefetch.Wait();
+    // Waiting again is harmless.
+    prefetch.Wait();
+  }
+  const std::string logged(messages.str());
+  BOOST_CHECK(logged.find("Prefetched first (") != std::string::npos);
+  BOOST_CHECK(logged.find("Prefetched second (") != std::string::npos);
+  BOOST_CHECK(logged.find("empty") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(StopEarly) {
+  std::vector<char> data(64 * SizePage());
+  std::vector<PrefetchRange> ranges(1, PrefetchRange(&data[0], data.size()));
+  // The destructor should join without finishing.
+  Prefetcher prefetch(ranges, 1, SizePage());
+  BOOST_CHECK(prefetch.Done() <= data.size());
+}
+
+} // namespace
+} // namespace util
@@ -1,10 +1,11 @@
 #include "file.hh"
 #include "probing_hash_table.hh"
 #include "mmap.hh"
+#include "perf_counters.hh"
 #include "usage.hh"
-#include "thread_pool.hh"
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/locks.hpp>
+
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
 
 #ifdef WIN32
 #include <windows.h>
@@ -15,11 +16,30 @@
 #endif
 
 #include <iostream>
+#include <string>
+#include <vector>
+
+/* Compare probing hash table variants: DivMod vs Power2Mod, entry sizes,
+ * load factor, fraction of lookups that hit, prefetching, and threads.  Each
+ * run prints one tab-separated line with CPU ns per lookup and, where
+ * perf_event_open allows, LLC and dTLB misses per lookup.
+ */
 
 namespace util {
 namespace {
 
-struct Entry {
+// A key plus ValueWords 32-bit words, packed like the entries in lm/.
+#pragma pack(push)
+#pragma pack(4)
+template <unsigned int ValueWords> struct SizedEntry {
+  typedef uint64_t Key;
+  Key key;
+  uint32_t value[ValueWords];
+  Key GetKey() const { return key; }
+};
+#pragma pack(pop)
+
+template <> struct SizedEntry<0> {
   typedef uint64_t Key;
   Key key;
   Key GetKey() const { return key; }
@@ -52,7 +72,7 @@ class URandom {
     util::scoped_fd file_;
 };
 
-struct PrefetchEntry {
+template <class Entry> struct PrefetchEntry {
   uint64_t key;
   const Entry *pointer;
 };
@@ -60,9 +80,10 @@ struct PrefetchEntry {
 template <class TableT, unsigned PrefetchSize> class PrefetchQueue {
   public:
     typedef TableT Table;
+    typedef PrefetchEntry<typename Table::Entry> Pending;
 
     explicit PrefetchQueue(Table &table) : table_(table), cur_(0), twiddle_(false) {
-      for (PrefetchEntry *i = entries_; i != entries_ + PrefetchSize; ++i)
+      for (Pending *i = entries_; i != entries_ + PrefetchSize; ++i)
         i->pointer = NULL;
     }
 
@@ -78,25 +99,25 @@ template <class TableT, unsigned PrefetchSize> class PrefetchQueue {
 
     bool Drain() {
       if (Cur().pointer) {
-        for (PrefetchEntry *i = &Cur(); i < entries_ + PrefetchSize; ++i) {
+        for (Pending *i = &Cur(); i < entries_ + PrefetchSize; ++i) {
           twiddle_ ^= table_.FindFromIdeal(i->key, i->pointer);
         }
       }
-      for (PrefetchEntry *i = entries_; i < &Cur(); ++i) {
+      for (Pending *i = entries_; i < &Cur(); ++i) {
         twiddle_ ^= table_.FindFromIdeal(i->key, i->pointer);
       }
       return twiddle_;
     }
 
   private:
-    PrefetchEntry &Cur() { return entries_[cur_]; }
+    Pending &Cur() { return entries_[cur_]; }
     void Next() {
       ++cur_;
       cur_ = cur_ % PrefetchSize;
     }
 
     Table &table_;
-    PrefetchEntry entries_[PrefetchSize];
+    Pending entries_[PrefetchSize];
     std::size_t cur_;
 
     bool twiddle_;
@@ -123,194 +144,239 @@ template <class TableT> class Immediate {
     bool twiddle_;
 };
 
-std::size_t Size(uint64_t entries, float multiplier = 1.5) {
-  typedef util::ProbingHashTable<Entry, util::IdentityHash, std::equal_to<Entry::Key>, Power2Mod> Table;
-  // Always round up to power of 2 for fair comparison.
-  return Power2Mod::RoundBuckets(Table::Size(entries, multiplier) / sizeof(Entry)) * sizeof(Entry);
-}
+struct Options {
+  std::vector<uint64_t> entries;
+  std::vector<unsigned int> entry_bytes;
+  std::vector<std::string> mods;
+  std::vector<float> multipliers;
+  std::vector<double> hit_rates;
+  std::vector<unsigned int> prefetch;
+  std::vector<std::size_t> threads;
+  uint64_t lookups;
+};
 
-template <class Queue> bool Test(URandom &rn, uint64_t entries, const uint64_t *const queries_begin, const uint64_t *const queries_end, bool ordinary_malloc, float multiplier = 1.5) {
-  std::size_t size = Size(entries, multiplier);
-  scoped_memory backing;
-  if (ordinary_malloc) {
-    backing.reset(util::CallocOrThrow(size), size, scoped_memory::MALLOC_ALLOCATED);
-  } else {
-    util::HugeMalloc(size, true, backing);
-  }
-  typename Queue::Table table(backing.get(), size);
+struct ThreadResult {
+  double seconds;
+  uint64_t misses[PerfCounters::EVENT_COUNT];
+  bool available[PerfCounters::EVENT_COUNT];
+  bool twiddle;
+};
 
-  double start = CPUTime();
-  for (uint64_t i = 0; i < entries; ++i) {
-    Entry entry;
-    entry.key = rn.Get();
-    table.Insert(entry);
+template <class Queue> class LookupThread {
+  public:
+    LookupThread(typename Queue::Table &table, const uint64_t *begin, const uint64_t *end, ThreadResult &result)
+      : table_(table), begin_(begin), end_(end), result_(result) {}
+
+    void operator()() {
+      // Counters belong to the thread that opens them.
+      PerfCounters counters;
+      Queue queue(table_);
+      double start = ThreadTime();
+      counters.Start();
+      for (const uint64_t *i = begin_; i != end_; ++i) {
+        queue.Add(*i);
+      }
+      result_.twiddle = queue.Drain();
+      counters.Stop();
+      result_.seconds = ThreadTime() - start;
+      for (unsigned int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+        result_.misses[e] = counters.Value(static_cast<PerfCounters::Event>(e));
+        result_.available[e] = counters.Available(static_cast<PerfCounters::Event>(e));
+      }
+    }
+
+  private:
+    typename Queue::Table &table_;
+    const uint64_t *begin_, *end_;
+    ThreadResult &result_;
+};
+
+// Returns a meaningless value so the compiler cannot skip lookups.
+template <class Queue> bool Lookups(typename Queue::Table &table, const std::vector<uint64_t> &queries, std::size_t thread_count, std::ostream &out) {
+  std::vector<ThreadResult> results(thread_count);
+  double wall = WallTime();
+  {
+    boost::thread_group threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+      const uint64_t *begin = &queries[0] + queries.size() * t / thread_count;
+      const uint64_t *end = &queries[0] + queries.size() * (t + 1) / thread_count;
+      threads.create_thread(LookupThread<Queue>(table, begin, end, results[t]));
+    }
+    threads.join_all();
   }
-  double inserted = CPUTime() - start;
-  double before_lookup = CPUTime();
-  Queue queue(table);
-  for (const uint64_t *i = queries_begin; i != queries_end; ++i) {
-    queue.Add(*i);
+  wall = WallTime() - wall;
+  bool meaningless = false;
+  ThreadResult sum = results[0];
+  for (std::size_t t = 1; t < results.size(); ++t) {
+    sum.seconds += results[t].seconds;
+    for (unsigned int e = 0; e < PerfCounters::EVENT_COUNT; ++e) {
+      sum.misses[e] += results[t].misses[e];
+      sum.available[e] = sum.available[e] && results[t].available[e];
+    }
   }
-  bool meaningless = queue.Drain();
-  std::cout << ' ' << (inserted / static_cast<double>(entries)) << ' ' << (CPUTime() - before_lookup) / static_cast<double>(queries_end - queries_begin) << std::flush;
+  for (std::size_t t = 0; t < results.size(); ++t) meaningless ^= results[t].twiddle;
+  const double lookups = static_cast<double>(queries.size());
+  out << '\t' << (sum.seconds * 1e9 / lookups) << '\t' << (wall * 1e9 / lookups);
+  const PerfCounters::Event kReport[] = {PerfCounters::LLC_MISSES, PerfCounters::DTLB_MISSES};
+  for (unsigned int e = 0; e < 2; ++e) {
+    out << '\t';
+    if (sum.available[kReport[e]]) {
+      out << (static_cast<double>(sum.misses[kReport[e]]) / lookups);
+    } else {
+      out << "NA";
+    }
+  }
+  out << '\n';
   return meaningless;
 }
 
-bool TestRun(uint64_t lookups = 20000000, float multiplier = 1.5) {
-  URandom rn;
-  util::scoped_memory queries;
-  HugeMalloc(lookups * sizeof(uint64_t), true, queries);
-  rn.Batch(static_cast<uint64_t*>(queries.get()), static_cast<uint64_t*>(queries.get()) + lookups);
-  uint64_t physical_mem_limit = util::GuessPhysicalMemory() / 2;
-  bool meaningless = true;
-  for (uint64_t i = 4; Size(i / multiplier) < physical_mem_limit; i *= 4) {
-    std::cout << static_cast<std::size_t>(i / multiplier) << ' ' << Size(i / multiplier);
-    typedef util::ProbingHashTable<Entry, util::IdentityHash, std::equal_to<Entry::Key>, Power2Mod> Table;
-    typedef util::ProbingHashTable<Entry, util::IdentityHash, std::equal_to<Entry::Key>, DivMod> TableDiv;
-    const uint64_t *const queries_begin = static_cast<const uint64_t*>(queries.get());
-    meaningless ^= util::Test<Immediate<TableDiv> >(rn, i / multiplier, queries_begin, queries_begin + lookups, true, multiplier);
-    meaningless ^= util::Test<Immediate<Table> >(rn, i / multiplier, queries_begin, queries_begin + lookups, true, multiplier);
-    meaningless ^= util::Test<PrefetchQueue<Table, 4> >(rn, i / multiplier, queries_begin, queries_begin + lookups, true, multiplier);
-    meaningless ^= util::Test<Immediate<Table> >(rn, i / multiplier, queries_begin, queries_begin + lookups, false, multiplier);
-    meaningless ^= util::Test<PrefetchQueue<Table, 2> >(rn, i / multiplier, queries_begin, queries_begin + lookups, false, multiplier);
-    meaningless ^= util::Test<PrefetchQueue<Table, 4> >(rn, i / multiplier, queries_begin, queries_begin + lookups, false, multiplier);
-    meaningless ^= util::Test<PrefetchQueue<Table, 8> >(rn, i / multiplier, queries_begin, queries_begin + lookups, false, multiplier);
-    meaningless ^= util::Test<PrefetchQueue<Table, 16> >(rn, i / multiplier, queries_begin, queries_begin + lookups, false, multiplier);
-    std::cout << std::endl;
+template <class Table> bool DispatchPrefetch(Table &table, unsigned int prefetch, const std::vector<uint64_t> &queries, std::size_t threads, std::ostream &out) {
+  switch (prefetch) {
+    case 0:
+      return Lookups<Immediate<Table> >(table, queries, threads, out);
+    case 2:
+      return Lookups<PrefetchQueue<Table, 2> >(table, queries, threads, out);
+    case 4:
+      return Lookups<PrefetchQueue<Table, 4> >(table, queries, threads, out);
+    case 8:
+      return Lookups<PrefetchQueue<Table, 8> >(table, queries, threads, out);
+    case 16:
+      return Lookups<PrefetchQueue<Table, 16> >(table, queries, threads, out);
+    default:
+      UTIL_THROW(Exception, "Prefetch depth " << prefetch << " is not one of 0, 2, 4, 8, or 16.");
   }
-  return meaningless;
 }
 
-template<class Table>
-struct ParallelTestRequest{
-  ParallelTestRequest() : queries_begin_(NULL), queries_end_(NULL), table_(NULL) {}
-  ParallelTestRequest(const uint64_t *queries_begin, const uint64_t *queries_end, Table *table) :
-      queries_begin_(queries_begin),
-      queries_end_(queries_end),
-      table_(table) {}
-  bool operator==(const ParallelTestRequest &rhs) const {
-    return this->queries_begin_ == rhs.queries_begin_ && this->queries_end_ == rhs.queries_end_;
-  }
-  const uint64_t *queries_begin_;
-  const uint64_t *queries_end_;
-  Table * table_;
-};
+uint64_t NonZero(uint64_t key) {
+  // 0 marks empty buckets.
+  return key ? key : 1;
+}
 
-template <class TableT>
-struct ParallelTestConstruct{
-  ParallelTestConstruct(boost::mutex& lock, const uint64_t* const burn_begin, const uint64_t* const burn_end, TableT* table) : lock_(lock), burn_begin_(burn_begin), burn_end_(burn_end), table_(table){}
-  boost::mutex& lock_;
-  const uint64_t* const burn_begin_;
-  const uint64_t* const burn_end_;
-  TableT* table_;
-};
+template <class Entry, class Mod> bool RunTable(URandom &rn, const char *mod_name, uint64_t entries, float multiplier, const Options &options) {
+  typedef ProbingHashTable<Entry, IdentityHash, std::equal_to<typename Entry::Key>, Mod> Table;
+  std::size_t size = Table::Size(entries, multiplier);
+  scoped_memory backing;
+  HugeMalloc(size, true, backing);
+  Table table(backing.get(), size);
 
-template<class Queue>
-struct ParallelTestHandler{
-  typedef ParallelTestRequest<typename Queue::Table> Request;
-  explicit ParallelTestHandler(const ParallelTestConstruct<typename Queue::Table>& construct) : lock_(construct.lock_), totalTime_(0.0), nRequests_(0), nQueries_(0), error_(false), twiddle_(false){
-    //perform initial burn
-    for(const uint64_t* i = construct.burn_begin_; i < construct.burn_end_; i++){
-      typename Queue::Table::ConstIterator it;
-      twiddle_ ^= construct.table_->Find(*i, it);
-    }
-  }
-  void operator()(Request request){
-    if (error_) return;
-    Queue queue(*request.table_);
-    double start = ThreadTime();
-    if(start < 0.0){
-      error_ = true;
-      return;
-    }
-    for(const uint64_t *i = request.queries_begin_; i != request.queries_end_; ++i){
-      queue.Add(*i);
-    }
-    twiddle_ ^= queue.Drain();
-    double end = ThreadTime();
-    if(end < 0.0){
-      error_ = true;
-      return;
-    }
-    totalTime_ += end - start;
-    nQueries_ += request.queries_end_ - request.queries_begin_;
-    ++nRequests_;
+  std::vector<uint64_t> keys(entries);
+  double start = CPUTime();
+  for (uint64_t i = 0; i < entries; ++i) {
+    Entry entry;
+    entry.key = keys[i] = NonZero(rn.Get());
+    table.Insert(entry);
   }
-  virtual ~ParallelTestHandler() {
-    boost::unique_lock<boost::mutex> produce_lock(lock_);
-    if (error_){
-      std::cout << "Error ";
+  double insert_ns = (CPUTime() - start) * 1e9 / static_cast<double>(entries);
+
+  bool meaningless = false;
+  std::vector<uint64_t> queries(options.lookups);
+  for (std::vector<double>::const_iterator hit = options.hit_rates.begin(); hit != options.hit_rates.end(); ++hit) {
+    for (uint64_t i = 0; i < options.lookups; ++i) {
+      // Uniform in [0, 1) from the top 53 bits.
+      bool is_hit = static_cast<double>(rn.Get() >> 11) * (1.0 / 9007199254740992.0) < *hit;
+      queries[i] = is_hit ? keys[rn.Get() % entries] : NonZero(rn.Get());
     }
-    else {
-      std::cout << nRequests_ << ' ' << ' ' << nQueries_ << ' ' << totalTime_ << std::endl;
+    for (std::vector<unsigned int>::const_iterator prefetch = options.prefetch.begin(); prefetch != options.prefetch.end(); ++prefetch) {
+      for (std::vector<std::size_t>::const_iterator threads = options.threads.begin(); threads != options.threads.end(); ++threads) {
+        std::cout << entries << '\t' << sizeof(Entry) << '\t' << mod_name << '\t' << multiplier << '\t'
+          << (static_cast<double>(entries) / static_cast<double>(size / sizeof(Entry))) << '\t' << size << '\t'
+          << *hit << '\t' << *prefetch << '\t' << *threads << '\t' << insert_ns;
+        meaningless ^= DispatchPrefetch(table, *prefetch, queries, *threads, std::cout);
+        std::cout << std::flush;
+      }
     }
-    std::cerr << "Meaningless " << twiddle_ << std::endl;
   }
-  private:
-    boost::mutex &lock_;
-    double totalTime_;
-    std::size_t nRequests_;
-    std::size_t nQueries_;
-    bool error_;
-    bool twiddle_;
-};
+  return meaningless;
+}
 
-template<class Queue>
-void ParallelTest(typename Queue::Table* table, const uint64_t *const queries_begin,
-                  const uint64_t *const queries_end, std::size_t num_threads,
-                  std::size_t tasks_per_thread, std::size_t burn){
-    boost::mutex lock;
-    ParallelTestConstruct<typename Queue::Table> construct(lock, queries_begin, queries_begin + burn, table);
-    ParallelTestRequest<typename Queue::Table> poison(NULL, NULL, NULL);
-    {
-      util::ThreadPool<ParallelTestHandler<Queue> > pool(num_threads, num_threads, construct, poison);
-      const uint64_t queries_per_thread =(static_cast<uint64_t>(queries_end-queries_begin-burn)/num_threads)/tasks_per_thread;
-      for (const uint64_t *i = queries_begin+burn; i + queries_per_thread <= queries_end; i += queries_per_thread){
-        ParallelTestRequest<typename Queue::Table> request(i, i+queries_per_thread, table);
-        pool.Produce(request);
+template <class Entry> bool RunEntry(URandom &rn, const Options &options) {
+  bool meaningless = false;
+  for (std::vector<uint64_t>::const_iterator entries = options.entries.begin(); entries != options.entries.end(); ++entries) {
+    for (std::vector<float>::const_iterator multiplier = options.multipliers.begin(); multiplier != options.multipliers.end(); ++multiplier) {
+      for (std::vector<std::string>::const_iterator mod = options.mods.begin(); mod != options.mods.end(); ++mod) {
+        if (*mod == "div") {
+          meaningless ^= RunTable<Entry, DivMod>(rn, "div", *entries, *multiplier, options);
+        } else if (*mod == "power2") {
+          meaningless ^= RunTable<Entry, Power2Mod>(rn, "power2", *entries, *multiplier, options);
+        } else {
+          UTIL_THROW(Exception, "Unknown mod " << *mod << ".  Use div or power2.");
+        }
       }
-    } // pool gets deallocated and all jobs finish
-    std::cout << std::endl;
+    }
+  }
+  return meaningless;
 }
 
-void ParallelTestRun(std::size_t tasks_per_thread = 1, std::size_t burn = 4000, uint64_t lookups = 20000000, float multiplier = 1.5) {
+bool Run(const Options &options) {
   URandom rn;
-  util::scoped_memory queries;
-  HugeMalloc((lookups + burn)* sizeof(uint64_t), true, queries);
-  rn.Batch(static_cast<uint64_t*>(queries.get()), static_cast<uint64_t*>(queries.get()) + lookups + burn);
-  const uint64_t *const queries_begin = static_cast<const uint64_t*>(queries.get());
-  const uint64_t *const queries_end = queries_begin + lookups + burn;
-  typedef util::ProbingHashTable<Entry, util::IdentityHash, std::equal_to<Entry::Key>, Power2Mod> Table;
-  uint64_t physical_mem_limit = util::GuessPhysicalMemory() / 2;
-  for (uint64_t i = 4; Size(i / multiplier, multiplier) < physical_mem_limit; i *= 4) {
-    std::size_t entries = static_cast<std::size_t>(i / multiplier);
-    std::size_t size = Size(i/multiplier, multiplier);
-    scoped_memory backing;
-    util::HugeMalloc(size, true, backing);
-    Table table(backing.get(), size);
-    for (uint64_t j = 0; j < entries; ++j) {
-      Entry entry;
-      entry.key = rn.Get();
-      table.Insert(entry);
-    }
-    for(std::size_t num_threads = 1; num_threads <= 16; num_threads*=2){
-      std::cout << entries << ' ' << size << ' ' << num_threads << ' ' << std::endl;
-      util::ParallelTest<Immediate<Table> >(&table, queries_begin, queries_end, num_threads, tasks_per_thread, burn);
-      util::ParallelTest<PrefetchQueue<Table, 2> >(&table, queries_begin, queries_end, num_threads, tasks_per_thread, burn);
-      util::ParallelTest<PrefetchQueue<Table, 4> >(&table, queries_begin, queries_end, num_threads, tasks_per_thread, burn);
-      util::ParallelTest<PrefetchQueue<Table, 8> >(&table, queries_begin, queries_end, num_threads, tasks_per_thread, burn);
-      util::ParallelTest<PrefetchQueue<Table, 16> >(&table, queries_begin, queries_end, num_threads, tasks_per_thread, burn);
+  bool meaningless = false;
+  std::cout << "entries\tentry_bytes\tmod\tmultiplier\tload_factor\ttable_bytes\thit_rate\tprefetch\tthreads\tinsert_ns\tcpu_ns_per_lookup\twall_ns_per_lookup\tllc_misses_per_lookup\tdtlb_misses_per_lookup\n";
+  for (std::vector<unsigned int>::const_iterator bytes = options.entry_bytes.begin(); bytes != options.entry_bytes.end(); ++bytes) {
+    switch (*bytes) {
+      // Key only.
+      case 8:
+        meaningless ^= RunEntry<SizedEntry<0> >(rn, options);
+        break;
+      // lm::ngram::detail::ProbEntry.
+      case 12:
+        meaningless ^= RunEntry<SizedEntry<1> >(rn, options);
+        break;
+      // BackoffValue::ProbingEntry.
+      case 16:
+        meaningless ^= RunEntry<SizedEntry<2> >(rn, options);
+        break;
+      // RestValue::ProbingEntry.
+      case 20:
+        meaningless ^= RunEntry<SizedEntry<3> >(rn, options);
+        break;
+      default:
+        UTIL_THROW(Exception, "Entry size " << *bytes << " is not one of 8, 12, 16, or 20.");
     }
   }
+  return meaningless;
+}
+
+template <class T> std::vector<T> Defaults(const T *begin, std::size_t size) {
+  return std::vector<T>(begin, begin + size);
 }
 
 } // namespace
 } // namespace util
 
-int main() {
-  //bool meaningless = false;
-  std::cout << "#CPU time\n";
-  //meaningless ^= util::TestRun();
-  util::ParallelTestRun(10, 4000);
-  //std::cerr << "Meaningless: " << meaningless << '\n';
+int main(int argc, char *argv[]) {
+  try {
+    util::Options options;
+    namespace po = boost::program_options;
+    po::options_description description("Probing hash table benchmark options.  Lists take several values");
+    const uint64_t kEntries[] = {1 << 16, 1 << 22};
+    const unsigned int kBytes[] = {8, 12, 16, 20};
+    const std::string kMods[] = {"div", "power2"};
+    const float kMultipliers[] = {1.2, 1.5, 2.0};
+    const double kHits[] = {1.0, 0.5};
+    const unsigned int kPrefetch[] = {0, 4, 16};
+    const std::size_t kThreads[] = {1};
+    description.add_options()
+      ("help,h", po::bool_switch(), "Show help message")
+      ("entries,e", po::value<std::vector<uint64_t> >(&options.entries)->multitoken()->default_value(util::Defaults(kEntries, 2), "65536 4194304"), "Entries in the table")
+      ("bytes,b", po::value<std::vector<unsigned int> >(&options.entry_bytes)->multitoken()->default_value(util::Defaults(kBytes, 4), "8 12 16 20"), "Entry sizes: 8 (key), 12 (ProbEntry), 16 (backoff ProbingEntry), 20 (rest ProbingEntry)")
+      ("mod,m", po::value<std::vector<std::string> >(&options.mods)->multitoken()->default_value(util::Defaults(kMods, 2), "div power2"), "Bucket mapping: div or power2")
+      ("multiplier,p", po::value<std::vector<float> >(&options.multipliers)->multitoken()->default_value(util::Defaults(kMultipliers, 3), "1.2 1.5 2.0"), "Buckets per entry, as in Config::probing_multiplier")
+      ("hit,H", po::value<std::vector<double> >(&options.hit_rates)->multitoken()->default_value(util::Defaults(kHits, 2), "1.0 0.5"), "Fraction of lookups for keys in the table")
+      ("prefetch,f", po::value<std::vector<unsigned int> >(&options.prefetch)->multitoken()->default_value(util::Defaults(kPrefetch, 3), "0 4 16"), "Lookups in flight with prefetching: 0, 2, 4, 8, or 16")
+      ("threads,t", po::value<std::vector<std::size_t> >(&options.threads)->multitoken()->default_value(util::Defaults(kThreads, 1), "1"), "Threads sharing the table")
+      ("lookups,l", po::value<uint64_t>(&options.lookups)->default_value(1 << 22), "Lookups per run, divided among threads");
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, description), vm);
+    if (vm["help"].as<bool>()) {
+      std::cerr << description << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+    bool meaningless = util::Run(options);
+    std::cerr << "Meaningless: " << meaningless << '\n';
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
 }
@@ -4,8 +4,18 @@
 #include "have.hh"
 #include "scoped.hh"
 
+#ifdef WITH_THREADS
+#include "pcqueue.hh"
+#include "thread_pool.hh"
+
+#include <boost/thread/thread.hpp>
+#endif // WITH_THREADS
+
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <cassert>
 #include <climits>
@@ -24,6 +34,15 @@
 #include <lzma.h>
 #endif
 
+#ifdef HAVE_ZSTDLIB
+#include <zstd.h>
+#include <zstd_errors.h>
+#endif
+
+#ifdef HAVE_LZ4LIB
+#include <lz4frame.h>
+#endif
+
 namespace util {
 
 CompressedException::CompressedException() throw() {}
@@ -38,6 +57,12 @@ BZException::~BZException() throw() {}
 XZException::XZException() throw() {}
 XZException::~XZException() throw() {}
 
+ZStdException::ZStdException() throw() {}
+ZStdException::~ZStdException() throw() {}
+
+LZ4Exception::LZ4Exception() throw() {}
+LZ4Exception::~LZ4Exception() throw() {}
+
 void ReadBase::ReplaceThis(ReadBase *with, ReadCompressed &thunk) {
   thunk.internal_.reset(with);
 }
@@ -50,7 +75,7 @@ uint64_t &ReadBase::ReadCount(ReadCompressed &thunk) {
 
 namespace {
 
-ReadBase *ReadFactory(int fd, uint64_t &raw_amount, const void *already_data, std::size_t already_size, bool require_compressed);
+ReadBase *ReadFactory(int fd, uint64_t &raw_amount, const void *already_data, std::size_t already_size, bool require_compressed, std::size_t threads = 1);
 
 // Completed file that other classes can thunk to.
 class Complete : public ReadBase {
@@ -111,7 +136,7 @@ template <class Compression> class StreamCompressed : public ReadBase {
   public:
     StreamCompressed(int fd, const void *already_data, std::size_t already_size)
       : file_(fd),
-        in_buffer_(MallocOrThrow(kInputBuffer)),
+        in_buffer_(MallocOrThrow(std::max(kInputBuffer, already_size))),
         back_(memcpy(in_buffer_.get(), already_data, already_size), already_size) {}
 
     std::size_t Read(void *to, std::size_t amount, ReadCompressed &thunk) {
@@ -318,6 +343,411 @@ class XZip {
 };
 #endif // HAVE_XZLIB
 
+#if defined(HAVE_ZSTDLIB) || defined(HAVE_LZ4LIB)
+// The zstd and lz4 decoders take buffers per call, so they keep the pointers
+// StreamCompressed wants from a zlib-style stream here.
+struct DecodeBuffers {
+  const uint8_t *next_in;
+  std::size_t avail_in;
+  uint8_t *next_out;
+  std::size_t avail_out;
+};
+
+uint32_t ReadLittle32(const uint8_t *from) {
+  return static_cast<uint32_t>(from[0]) | (static_cast<uint32_t>(from[1]) << 8) | (static_cast<uint32_t>(from[2]) << 16) | (static_cast<uint32_t>(from[3]) << 24);
+}
+
+// zstd and lz4 share the magic numbers of skippable frames: a 4-byte magic
+// then a 4-byte length.
+bool SkippableMagic(const uint8_t *from) {
+  return (ReadLittle32(from) & 0xFFFFFFF0) == 0x184D2A50;
+}
+#endif
+
+#ifdef HAVE_ZSTDLIB
+class ZStd {
+  public:
+    ZStd(const void *base, std::size_t amount) : stream_(ZSTD_createDStream()) {
+      if (!stream_) throw std::bad_alloc();
+      SetInput(base, amount);
+      SetOutput(NULL, 0);
+    }
+
+    ~ZStd() {
+      ZSTD_freeDStream(stream_);
+    }
+
+    void SetOutput(void *to, std::size_t amount) {
+      buffers_.next_out = static_cast<uint8_t*>(to);
+      buffers_.avail_out = amount;
+    }
+
+    void SetInput(const void *base, std::size_t amount) {
+      buffers_.next_in = static_cast<const uint8_t*>(base);
+      buffers_.avail_in = amount;
+      finish_ = !amount;
+    }
+
+    const DecodeBuffers &Stream() const { return buffers_; }
+
+    // Returns false at the end of each frame.
+    bool Process() {
+      ZSTD_inBuffer in = {buffers_.next_in, buffers_.avail_in, 0};
+      ZSTD_outBuffer out = {buffers_.next_out, buffers_.avail_out, 0};
+      std::size_t ret = ZSTD_decompressStream(stream_, &out, &in);
+      UTIL_THROW_IF(ZSTD_isError(ret), ZStdException, "zstd says " << ZSTD_getErrorName(ret));
+      buffers_.next_in += in.pos;
+      buffers_.avail_in -= in.pos;
+      buffers_.next_out += out.pos;
+      buffers_.avail_out -= out.pos;
+      if (!ret) return false;
+      UTIL_THROW_IF(finish_ && !in.pos && !out.pos, ZStdException, "zstd says unexpected end of input");
+      return true;
+    }
+
+    // Needs 4 bytes.
+    static bool Magic(const uint8_t *from) {
+      return ReadLittle32(from) == 0xFD2FB528 || SkippableMagic(from);
+    }
+
+    // Compressed size of the frame that begins at from or 0 if size bytes are
+    // not enough to contain it.
+    static std::size_t FrameSize(const uint8_t *from, std::size_t size) {
+      std::size_t ret = ZSTD_findFrameCompressedSize(from, size);
+      if (!ZSTD_isError(ret)) return ret;
+      UTIL_THROW_IF(ZSTD_getErrorCode(ret) != ZSTD_error_srcSize_wrong, ZStdException, "zstd says " << ZSTD_getErrorName(ret));
+      return 0;
+    }
+
+  private:
+    ZSTD_DStream *stream_;
+
+    DecodeBuffers buffers_;
+
+    bool finish_;
+};
+#endif // HAVE_ZSTDLIB
+
+#ifdef HAVE_LZ4LIB
+class LZ4 {
+  public:
+    LZ4(const void *base, std::size_t amount) {
+      HandleError(LZ4F_createDecompressionContext(&context_, LZ4F_VERSION));
+      SetInput(base, amount);
+      SetOutput(NULL, 0);
+    }
+
+    ~LZ4() {
+      LZ4F_freeDecompressionContext(context_);
+    }
+
+    void SetOutput(void *to, std::size_t amount) {
+      buffers_.next_out = static_cast<uint8_t*>(to);
+      buffers_.avail_out = amount;
+    }
+
+    void SetInput(const void *base, std::size_t amount) {
+      buffers_.next_in = static_cast<const uint8_t*>(base);
+      buffers_.avail_in = amount;
+      finish_ = !amount;
+    }
+
+    const DecodeBuffers &Stream() const { return buffers_; }
+
+    // Returns false at the end of each frame.
+    bool Process() {
+      std::size_t in = buffers_.avail_in, out = buffers_.avail_out;
+      std::size_t ret = LZ4F_decompress(context_, buffers_.next_out, &out, buffers_.next_in, &in, NULL);
+      HandleError(ret);
+      buffers_.next_in += in;
+      buffers_.avail_in -= in;
+      buffers_.next_out += out;
+      buffers_.avail_out -= out;
+      if (!ret) return false;
+      UTIL_THROW_IF(finish_ && !in && !out, LZ4Exception, "lz4 says unexpected end of input");
+      return true;
+    }
+
+    // Needs 4 bytes.
+    static bool Magic(const uint8_t *from) {
+      return ReadLittle32(from) == 0x184D2204 || SkippableMagic(from);
+    }
+
+    // Compressed size of the frame that begins at from or 0 if size bytes are
+    // not enough to contain it.  liblz4 has no function for this, so walk the
+    // block headers.
+    static std::size_t FrameSize(const uint8_t *from, std::size_t size) {
+      if (size < 8) return 0;
+      if (SkippableMagic(from)) {
+        std::size_t ret = 8 + static_cast<std::size_t>(ReadLittle32(from + 4));
+        return ret <= size ? ret : 0;
+      }
+      const uint8_t flags = from[4];
+      UTIL_THROW_IF((flags >> 6) != 1, LZ4Exception, "lz4 frame has unsupported version " << static_cast<unsigned>(flags >> 6));
+      // Magic, flags, block descriptor, optional content size and dictionary id, header checksum.
+      std::size_t position = 7 + ((flags & 0x08) ? 8 : 0) + ((flags & 0x01) ? 4 : 0);
+      const std::size_t block_checksum = (flags & 0x10) ? 4 : 0;
+      while (true) {
+        if (position + 4 > size) return 0;
+        uint32_t block = ReadLittle32(from + position);
+        position += 4;
+        // End mark.
+        if (!block) break;
+        // The high bit marks an uncompressed block.
+        position += (block & 0x7FFFFFFF) + block_checksum;
+      }
+      if (flags & 0x04) position += 4;
+      return position <= size ? position : 0;
+    }
+
+  private:
+    void HandleError(std::size_t code) {
+      UTIL_THROW_IF(LZ4F_isError(code), LZ4Exception, "lz4 says " << LZ4F_getErrorName(code));
+    }
+
+    LZ4F_dctx *context_;
+
+    DecodeBuffers buffers_;
+
+    bool finish_;
+};
+#endif // HAVE_LZ4LIB
+
+#if (defined(HAVE_ZSTDLIB) || defined(HAVE_LZ4LIB)) && defined(WITH_THREADS)
+// Amount to decode into at a time.
+const std::size_t kFrameChunk = 1 << 20;
+
+// A frame buffered by ParallelFrames.  Frames bigger than this are decoded as
+// a stream by the reading thread instead, keeping memory bounded.
+const std::size_t kMaxFrameBuffer = 64 << 20;
+
+// Slot in the ring of buffers used by ParallelFrames.
+struct FrameSlot {
+  FrameSlot() : done(0) {}
+
+  // Compressed frame for a worker to decode.
+  std::vector<uint8_t> input;
+
+  // output[0, size) is decoded.
+  std::vector<uint8_t> output;
+  std::size_t size;
+
+  // Bytes read from the file to produce this slot.
+  uint64_t raw;
+
+  // Non-empty if decoding failed.
+  std::string error;
+
+  // Posted when output or error is ready.
+  Semaphore done;
+};
+
+template <class Decoder> class FrameWorker {
+  public:
+    typedef FrameSlot *Request;
+
+    void operator()(FrameSlot *slot) {
+      try {
+        Decode(*slot);
+      } catch (const std::exception &e) {
+        slot->error = e.what();
+      }
+      slot->done.post();
+    }
+
+  private:
+    static void Decode(FrameSlot &slot) {
+      Decoder decoder(&slot.input[0], slot.input.size());
+      if (slot.output.size() < kFrameChunk) slot.output.resize(kFrameChunk);
+      std::size_t used = 0;
+      bool more = true;
+      while (more) {
+        if (used == slot.output.size()) slot.output.resize(slot.output.size() * 2);
+        decoder.SetOutput(&slot.output[used], slot.output.size() - used);
+        // Let the decoder know there is no more input so a bad frame throws.
+        if (!decoder.Stream().avail_in) decoder.SetInput(NULL, 0);
+        more = decoder.Process();
+        used = decoder.Stream().next_out - &slot.output[0];
+      }
+      UTIL_THROW_IF(decoder.Stream().avail_in, CompressedException, "Frame has " << decoder.Stream().avail_in << " bytes after its end.");
+      slot.size = used;
+    }
+};
+
+/* Decode independent zstd or lz4 frames ahead of the reader.  A thread reads
+ * the file and splits it into frames, handing each to a pool of workers.
+ * Frames come back through a ring of slots in file order, so memory is bounded
+ * by the ring.  When the next bytes are not a frame of this format, the rest
+ * of the file goes to ReadFactory, as StreamCompressed does.
+ */
+template <class Decoder> class ParallelFrames : public ReadBase {
+  public:
+    ParallelFrames(int fd, const void *already_data, std::size_t already_size, std::size_t threads)
+      : file_(fd),
+        pending_(std::max(kFrameChunk, already_size)),
+        pending_begin_(0),
+        pending_end_(already_size),
+        unreported_(0),
+        slots_(2 * threads + 2),
+        free_(slots_.size()),
+        ordered_(slots_.size() + 1),
+        pool_(slots_.size(), threads, FrameWorker<Decoder>(), NULL),
+        stop_(false),
+        finished_(false),
+        current_(NULL) {
+      memcpy(&pending_[0], already_data, already_size);
+      for (std::size_t i = 0; i < slots_.size(); ++i) {
+        free_.Produce(&slots_[i]);
+      }
+      reader_ = boost::thread(&ParallelFrames::ReadLoop, this);
+    }
+
+    ~ParallelFrames() {
+      if (finished_) return;
+      // Unblock the reading thread and wait for outstanding frames.
+      stop_ = true;
+      if (current_) free_.Produce(current_);
+      for (FrameSlot *slot; (slot = ordered_.Consume()); ) {
+        WaitSemaphore(slot->done);
+        free_.Produce(slot);
+      }
+      reader_.join();
+    }
+
+    std::size_t Read(void *to, std::size_t amount, ReadCompressed &thunk) {
+      if (amount == 0) return 0;
+      while (!current_ || current_offset_ == current_->size) {
+        if (current_) {
+          free_.Produce(current_);
+          current_ = NULL;
+        }
+        FrameSlot *next = ordered_.Consume();
+        if (!next) return Finish(to, amount, thunk);
+        WaitSemaphore(next->done);
+        current_ = next;
+        current_offset_ = 0;
+        ReadCount(thunk) += next->raw;
+        UTIL_THROW_IF(!next->error.empty(), CompressedException, next->error);
+      }
+      std::size_t sending = std::min<std::size_t>(amount, current_->size - current_offset_);
+      memcpy(to, &current_->output[current_offset_], sending);
+      current_offset_ += sending;
+      return sending;
+    }
+
+  private:
+    std::size_t Finish(void *to, std::size_t amount, ReadCompressed &thunk) {
+      reader_.join();
+      finished_ = true;
+      ReadCount(thunk) += unreported_;
+      ReplaceThis(ReadFactory(file_.release(), ReadCount(thunk), &pending_[pending_begin_], pending_end_ - pending_begin_, true), thunk);
+      // this is gone.
+      return Current(thunk)->Read(to, amount, thunk);
+    }
+
+    // Runs in reader_.
+    void ReadLoop() {
+      try {
+        while (!stop_) {
+          while (Pending() < 4 && Fill()) {}
+          if (Pending() < 4 || !Decoder::Magic(&pending_[pending_begin_])) break;
+          std::size_t size;
+          while (!(size = Decoder::FrameSize(&pending_[pending_begin_], Pending())) && Pending() < kMaxFrameBuffer) {
+            UTIL_THROW_IF(!Fill(), CompressedException, "Compressed file ends in the middle of a frame.");
+          }
+          if (!size) {
+            StreamFrame();
+            continue;
+          }
+          FrameSlot *slot = free_.Consume();
+          slot->input.assign(&pending_[pending_begin_], &pending_[pending_begin_] + size);
+          pending_begin_ += size;
+          slot->raw = unreported_;
+          unreported_ = 0;
+          slot->error.clear();
+          ordered_.Produce(slot);
+          pool_.Produce(slot);
+        }
+      } catch (const std::exception &e) {
+        FrameSlot *slot = free_.Consume();
+        slot->size = 0;
+        slot->raw = 0;
+        slot->error = e.what();
+        slot->done.post();
+        ordered_.Produce(slot);
+      }
+      ordered_.Produce(NULL);
+    }
+
+    // Decode a frame too big to buffer on this thread, passing output through
+    // the ring as it is produced.
+    void StreamFrame() {
+      Decoder decoder(&pending_[pending_begin_], Pending());
+      bool more = true;
+      while (more && !stop_) {
+        FrameSlot *slot = free_.Consume();
+        slot->error.clear();
+        if (slot->output.size() < kFrameChunk) slot->output.resize(kFrameChunk);
+        decoder.SetOutput(&slot->output[0], slot->output.size());
+        while (more && decoder.Stream().avail_out && !stop_) {
+          if (!decoder.Stream().avail_in) {
+            pending_begin_ = pending_end_ = 0;
+            decoder.SetInput(&pending_[0], Fill());
+          }
+          more = decoder.Process();
+        }
+        slot->size = decoder.Stream().next_out - &slot->output[0];
+        slot->raw = unreported_;
+        unreported_ = 0;
+        slot->done.post();
+        ordered_.Produce(slot);
+      }
+      pending_begin_ = decoder.Stream().next_in - &pending_[0];
+    }
+
+    std::size_t Pending() const { return pending_end_ - pending_begin_; }
+
+    // Read more of the file into pending_, returning the amount read.
+    std::size_t Fill() {
+      if (pending_begin_) {
+        std::copy(pending_.begin() + pending_begin_, pending_.begin() + pending_end_, pending_.begin());
+        pending_end_ -= pending_begin_;
+        pending_begin_ = 0;
+      }
+      if (pending_end_ == pending_.size()) pending_.resize(pending_.size() * 2);
+      std::size_t got = PartialRead(file_.get(), &pending_[pending_end_], pending_.size() - pending_end_);
+      pending_end_ += got;
+      unreported_ += got;
+      return got;
+    }
+
+    scoped_fd file_;
+
+    // Read but not yet claimed by a frame: pending_[pending_begin_, pending_end_).
+    std::vector<uint8_t> pending_;
+    std::size_t pending_begin_, pending_end_;
+
+    uint64_t unreported_;
+
+    std::vector<FrameSlot> slots_;
+
+    PCQueue<FrameSlot*> free_;
+    // File order.  NULL at the end.
+    PCQueue<FrameSlot*> ordered_;
+
+    ThreadPool<FrameWorker<Decoder> > pool_;
+
+    std::atomic<bool> stop_;
+
+    bool finished_;
+
+    FrameSlot *current_;
+    std::size_t current_offset_;
+
+    boost::thread reader_;
+};
+#endif // (HAVE_ZSTDLIB || HAVE_LZ4LIB) && WITH_THREADS
+
 class IStreamReader : public ReadBase {
   public:
     explicit IStreamReader(std::istream &stream) : stream_(stream) {}
@@ -336,7 +766,7 @@ class IStreamReader : public ReadBase {
 };
 
 enum MagicResult {
-  UTIL_UNKNOWN, UTIL_GZIP, UTIL_BZIP, UTIL_XZIP
+  UTIL_UNKNOWN, UTIL_GZIP, UTIL_BZIP, UTIL_XZIP, UTIL_ZSTD, UTIL_LZ4
 };
 
 MagicResult DetectMagic(const void *from_void, std::size_t length) {
@@ -352,10 +782,22 @@ MagicResult DetectMagic(const void *from_void, std::size_t length) {
   if (length >= sizeof(kXZMagic) && !memcmp(header, kXZMagic, sizeof(kXZMagic))) {
     return UTIL_XZIP;
   }
+  const uint8_t kZStdMagic[4] = { 0x28, 0xB5, 0x2F, 0xFD };
+  if (length >= sizeof(kZStdMagic) && !memcmp(header, kZStdMagic, sizeof(kZStdMagic))) {
+    return UTIL_ZSTD;
+  }
+  const uint8_t kLZ4Magic[4] = { 0x04, 0x22, 0x4D, 0x18 };
+  if (length >= sizeof(kLZ4Magic) && !memcmp(header, kLZ4Magic, sizeof(kLZ4Magic))) {
+    return UTIL_LZ4;
+  }
+  // Skippable frames, which zstd and lz4 share.  pzstd begins each frame with one.
+  if (length >= 4 && (header[0] & 0xF0) == 0x50 && header[1] == 0x2A && header[2] == 0x4D && header[3] == 0x18) {
+    return UTIL_ZSTD;
+  }
   return UTIL_UNKNOWN;
 }
 
-ReadBase *ReadFactory(int fd, uint64_t &raw_amount, const void *already_data, const std::size_t already_size, bool require_compressed) {
+ReadBase *ReadFactory(int fd, uint64_t &raw_amount, const void *already_data, const std::size_t already_size, bool require_compressed, std::size_t threads) {
   scoped_fd hold(fd);
   std::string header(reinterpret_cast<const char*>(already_data), already_size);
   if (header.size() < ReadCompressed::kMagicSize) {
@@ -386,6 +828,24 @@ ReadBase *ReadFactory(int fd, uint64_t &raw_amount, const void *already_data, co
       return new StreamCompressed<XZip>(hold.release(), header.data(), header.size());
 #else
       UTIL_THROW(CompressedException, "This looks like an xz file, but xz support was not compiled in.");
+#endif
+    case UTIL_ZSTD:
+#ifdef HAVE_ZSTDLIB
+#ifdef WITH_THREADS
+      if (threads > 1) return new ParallelFrames<ZStd>(hold.release(), header.data(), header.size(), threads);
+#endif // WITH_THREADS
+      return new StreamCompressed<ZStd>(hold.release(), header.data(), header.size());
+#else
+      UTIL_THROW(CompressedException, "This looks like a zstd file, but zstd support was not compiled in.");
+#endif
+    case UTIL_LZ4:
+#ifdef HAVE_LZ4LIB
+#ifdef WITH_THREADS
+      if (threads > 1) return new ParallelFrames<LZ4>(hold.release(), header.data(), header.size(), threads);
+#endif // WITH_THREADS
+      return new StreamCompressed<LZ4>(hold.release(), header.data(), header.size());
+#else
+      UTIL_THROW(CompressedException, "This looks like an lz4 file, but lz4 support was not compiled in.");
 #endif
     default:
       UTIL_THROW_IF(require_compressed, CompressedException, "Uncompressed data detected after a compresssed file.  This could be supported but usually indicates an error.");
@@ -399,8 +859,8 @@ bool ReadCompressed::DetectCompressedMagic(const void *from_void) {
   return DetectMagic(from_void, kMagicSize) != UTIL_UNKNOWN;
 }
 
-ReadCompressed::ReadCompressed(int fd) {
-  Reset(fd);
+ReadCompressed::ReadCompressed(int fd, std::size_t threads) {
+  Reset(fd, threads);
 }
 
 ReadCompressed::ReadCompressed(std::istream &in) {
@@ -409,10 +869,10 @@ ReadCompressed::ReadCompressed(std::istream &in) {
 
 ReadCompressed::ReadCompressed() {}
 
-void ReadCompressed::Reset(int fd) {
+void ReadCompressed::Reset(int fd, std::size_t threads) {
   raw_amount_ = 0;
   internal_.reset();
-  internal_.reset(ReadFactory(fd, raw_amount_, NULL, 0, false));
+  internal_.reset(ReadFactory(fd, raw_amount_, NULL, 0, false, threads));
 }
 
 void ReadCompressed::Reset(std::istream &in) {
@@ -33,6 +33,18 @@ class XZException : public CompressedException {
     ~XZException() throw();
 };
 
+class ZStdException : public CompressedException {
+  public:
+    ZStdException() throw();
+    ~ZStdException() throw();
+};
+
+class LZ4Exception : public CompressedException {
+  public:
+    LZ4Exception() throw();
+    ~LZ4Exception() throw();
+};
+
 class ReadCompressed;
 
 class ReadBase {
@@ -55,8 +67,11 @@ class ReadCompressed {
     // Must have at least kMagicSize bytes.
     static bool DetectCompressedMagic(const void *from);
 
-    // Takes ownership of fd.
-    explicit ReadCompressed(int fd);
+    /* Takes ownership of fd.  zstd and lz4 files consist of independent
+     * frames, so with threads > 1 the frames are decoded ahead on that many
+     * threads.  Other formats, and builds without WITH_THREADS, ignore threads.
+     */
+    explicit ReadCompressed(int fd, std::size_t threads = 1);
 
     // Try to avoid using this.  Use the fd instead.
     // There is no decompression support for istreams.
@@ -66,7 +81,7 @@ class ReadCompressed {
     ReadCompressed();
 
     // Takes ownership of fd.
-    void Reset(int fd);
+    void Reset(int fd, std::size_t threads = 1);
 
     // Same advice as the constructor.
     void Reset(std::istream &in);
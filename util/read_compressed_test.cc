@@ -9,6 +9,7 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 #include <cstdlib>
 
 #if defined __MINGW32__
@@ -90,6 +91,51 @@ void TestRandom(const char *compressor) {
   VerifyRead(reader);
 }
 
+// Compress successive pieces of the data with each compressor in turn and
+// concatenate the results, so the file has at least one frame per piece.
+// Returns the file, already unlinked and rewound.
+int WritePieces(const std::vector<std::string> &compressors) {
+  char name[] = "tempXXXXXX";
+  scoped_fd out(mkstemp(name));
+  BOOST_REQUIRE(out.get() > 0);
+  BOOST_CHECK_EQUAL(0, unlink(name));
+  for (std::size_t piece = 0; piece < compressors.size(); ++piece) {
+    char piece_name[] = "tempXXXXXX";
+    {
+      scoped_fd piece_file(mkstemp(piece_name));
+      BOOST_REQUIRE(piece_file.get() > 0);
+      for (uint32_t i = kSize4 * piece / compressors.size(); i < kSize4 * (piece + 1) / compressors.size(); ++i) {
+        WriteOrThrow(piece_file.get(), &i, sizeof(uint32_t));
+      }
+    }
+    char compressed_name[] = "tempXXXXXX";
+    scoped_fd compressed(mkstemp(compressed_name));
+    BOOST_REQUIRE(compressed.get() > 0);
+    std::string command(compressors[piece] + " <\"" + piece_name + "\" >\"" + compressed_name + "\"");
+    BOOST_REQUIRE_EQUAL(0, system(command.c_str()));
+    BOOST_CHECK_EQUAL(0, unlink(piece_name));
+    BOOST_CHECK_EQUAL(0, unlink(compressed_name));
+    char buffer[4096];
+    for (std::size_t got; (got = ReadOrEOF(compressed.get(), buffer, sizeof(buffer))); ) {
+      WriteOrThrow(out.get(), buffer, got);
+    }
+  }
+  SeekOrThrow(out.get(), 0);
+  return out.release();
+}
+
+void TestPieces(const std::vector<std::string> &compressors, std::size_t threads) {
+  ReadCompressed reader(WritePieces(compressors), threads);
+  VerifyRead(reader);
+}
+
+void TestFrames(const char *compressor) {
+  std::vector<std::string> compressors(7, compressor);
+  TestPieces(compressors, 1);
+  TestPieces(compressors, 2);
+  TestPieces(compressors, 4);
+}
+
 BOOST_AUTO_TEST_CASE(Uncompressed) {
   TestRandom("cat");
 }
@@ -112,6 +158,95 @@ BOOST_AUTO_TEST_CASE(ReadXZ) {
 }
 #endif
 
+#ifdef HAVE_ZSTDLIB
+BOOST_AUTO_TEST_CASE(ReadZStd) {
+  TestRandom("zstd");
+}
+
+BOOST_AUTO_TEST_CASE(ZStdFrames) {
+  TestFrames("zstd");
+}
+
+BOOST_AUTO_TEST_CASE(ZStdTruncated) {
+  scoped_fd in(WritePieces(std::vector<std::string>(3, "zstd")));
+  ResizeOrThrow(in.get(), SizeOrThrow(in.get()) - 5);
+  ReadCompressed reader(in.release(), 2);
+  std::vector<uint32_t> buffer(kSize4);
+  BOOST_CHECK_THROW(reader.ReadOrEOF(&buffer[0], kSize4 * sizeof(uint32_t)), CompressedException);
+}
+
+// A single frame too big to buffer, so the reading thread decodes it in
+// pieces.  Random bytes keep the compressed frame large.
+const std::size_t kBigFrame = 72 << 20;
+
+uint64_t NextRandom(uint64_t &state) {
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+  return state;
+}
+
+int WriteBigFrame() {
+  char name[] = "tempXXXXXX";
+  {
+    scoped_fd original(mkstemp(name));
+    BOOST_REQUIRE(original.get() > 0);
+    std::vector<uint64_t> data(kBigFrame / sizeof(uint64_t));
+    uint64_t state = 1;
+    for (std::size_t i = 0; i < data.size(); ++i) data[i] = NextRandom(state);
+    WriteOrThrow(original.get(), &data[0], kBigFrame);
+  }
+  char compressed_name[] = "tempXXXXXX";
+  scoped_fd compressed(mkstemp(compressed_name));
+  BOOST_REQUIRE(compressed.get() > 0);
+  std::string command(std::string("zstd -1 -q -c <\"") + name + "\" >\"" + compressed_name + "\"");
+  BOOST_REQUIRE_EQUAL(0, system(command.c_str()));
+  BOOST_CHECK_EQUAL(0, unlink(name));
+  BOOST_CHECK_EQUAL(0, unlink(compressed_name));
+  return compressed.release();
+}
+
+BOOST_AUTO_TEST_CASE(ZStdBigFrame) {
+  scoped_fd file(WriteBigFrame());
+  {
+    // Destroying the reader part way through the frame should not hang.
+    ReadCompressed reader(DupOrThrow(file.get()), 2);
+    uint64_t got[512];
+    ReadLoop(reader, got, sizeof(got));
+    uint64_t state = 1;
+    for (std::size_t i = 0; i < 512; ++i) BOOST_REQUIRE_EQUAL(NextRandom(state), got[i]);
+  }
+  SeekOrThrow(file.get(), 0);
+  ReadCompressed reader(file.release(), 2);
+  std::vector<uint64_t> got(kBigFrame / sizeof(uint64_t) + 1);
+  BOOST_REQUIRE_EQUAL(kBigFrame, reader.ReadOrEOF(&got[0], got.size() * sizeof(uint64_t)));
+  uint64_t state = 1;
+  for (std::size_t i = 0; i < kBigFrame / sizeof(uint64_t); ++i) {
+    if (NextRandom(state) != got[i]) BOOST_REQUIRE_EQUAL(state, got[i]);
+  }
+}
+
+// Parallel decoding hands off to the usual readers when the format changes.
+#ifdef HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(ZStdThenGZ) {
+  std::vector<std::string> compressors(3, "zstd");
+  compressors.push_back("gzip");
+  TestPieces(compressors, 1);
+  TestPieces(compressors, 3);
+}
+#endif // HAVE_ZLIB
+#endif // HAVE_ZSTDLIB
+
+#ifdef HAVE_LZ4LIB
+BOOST_AUTO_TEST_CASE(ReadLZ4) {
+  TestRandom("lz4");
+}
+
+BOOST_AUTO_TEST_CASE(LZ4Frames) {
+  TestFrames("lz4");
+}
+#endif // HAVE_LZ4LIB
+
 #ifdef HAVE_ZLIB
 BOOST_AUTO_TEST_CASE(AppendGZ) {
 }
@@ -0,0 +1,170 @@
+#include "shared_segment.hh"
+
+#include "exception.hh"
+#include "file.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+namespace {
+
+const char kMagic[16] = "kenlm shared v2";
+
+// The data starts at a huge page boundary of the segment, since shmem can only
+// back a mapping with huge pages where the file offset is aligned.  The rest of
+// the first huge page after the control page is never touched, so it costs no
+// memory.
+const std::size_t kHugePage = 1 << 21;
+
+// Lives in the first page of the segment.
+struct Control {
+  char magic[16];
+  uint64_t size;
+  uint64_t references;
+  // Set last by the creator so a crash while copying is detected.
+  uint64_t ready;
+};
+
+#if !defined(_WIN32) && !defined(_WIN64)
+void LockOrThrow(int fd) {
+  int ret;
+  while ((ret = flock(fd, LOCK_EX)) == -1 && errno == EINTR) {}
+  UTIL_THROW_IF(ret, ErrnoException, "Failed to lock shared memory segment");
+}
+
+class Unlocker {
+  public:
+    explicit Unlocker(int fd) : fd_(fd) {}
+    ~Unlocker() { flock(fd_, LOCK_UN); }
+  private:
+    int fd_;
+};
+
+// Has the segment been unlinked since it was opened?
+bool Unlinked(int fd) {
+  struct stat info;
+  UTIL_THROW_IF_ARG(fstat(fd, &info), FDException, (fd), "Could not stat");
+  return !info.st_nlink;
+}
+
+void AdviseHuge(void *data, std::size_t size) {
+#ifdef MADV_HUGEPAGE
+  // Huge pages are nice to have; ignore failure.
+  madvise(data, size, MADV_HUGEPAGE);
+#endif
+}
+#endif
+
+} // namespace
+
+SharedSegment::~SharedSegment() {
+  try {
+    Detach();
+  } catch (const util::Exception &e) {
+    std::cerr << e.what() << std::endl;
+    abort();
+  }
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+
+std::string SharedSegment::NameFor(int, const char *) {
+  UTIL_THROW(Exception, "Shared memory segments are not implemented on Windows.");
+}
+
+void SharedSegment::Attach(const std::string &, int, uint64_t) {
+  UTIL_THROW(Exception, "Shared memory segments are not implemented on Windows.");
+}
+
+uint64_t SharedSegment::References() const { return 0; }
+
+void SharedSegment::Detach() {}
+
+#else
+
+std::string SharedSegment::NameFor(int fd, const char *prefix) {
+  struct stat info;
+  UTIL_THROW_IF_ARG(fstat(fd, &info), FDException, (fd), "Could not stat");
+  std::ostringstream name;
+  name << prefix << std::hex << static_cast<uint64_t>(info.st_dev) << '-' << static_cast<uint64_t>(info.st_ino) << '-' << static_cast<uint64_t>(info.st_size) << '-' << static_cast<uint64_t>(info.st_mtime);
+  return name.str();
+}
+
+void SharedSegment::Attach(const std::string &name, int fd, uint64_t size) {
+  Detach();
+  const std::size_t page = SizePage();
+  const std::size_t offset = std::max(page, kHugePage);
+  scoped_fd shm;
+  while (true) {
+    shm.reset(shm_open(name.c_str(), O_RDWR | O_CREAT, 0600));
+    UTIL_THROW_IF(shm.get() == -1, ErrnoException, "Could not open shared memory segment " << name);
+    LockOrThrow(shm.get());
+    // Retry if the last process detached and unlinked it between our open and
+    // lock.  Closing releases the lock.
+    if (!Unlinked(shm.get())) break;
+  }
+  Unlocker unlock(shm.get());
+
+  // Map the control page first to see whether somebody already copied the file.
+  scoped_mmap control;
+  if (SizeOrThrow(shm.get()) < page) ResizeOrThrow(shm.get(), page);
+  control.reset(MapOrThrow(page, true, kFileFlags, false, shm.get(), 0), page);
+  Control *header = reinterpret_cast<Control*>(control.get());
+  bool created = false;
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) || !header->ready) {
+    // New, or the previous creator died while copying.
+    ResizeOrThrow(shm.get(), offset + size);
+    scoped_mmap writable(MapOrThrow(size, true, kFileFlags, false, shm.get(), offset), size);
+    // Advise before copying: shmem picks the page size when the copy faults.
+    AdviseHuge(writable.get(), size);
+    ErsatzPRead(fd, writable.get(), size, 0);
+    memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->size = size;
+    header->references = 0;
+    header->ready = 1;
+    created = true;
+  }
+  UTIL_THROW_IF(header->size != size, Exception, "Shared memory segment " << name << " has " << header->size << " bytes but the file has " << size << ".  Remove it from /dev/shm if it is stale.");
+  data_.reset(MapOrThrow(size, false, kFileFlags, false, shm.get(), offset), size);
+  AdviseHuge(data_.get(), size);
+  ++header->references;
+
+  name_ = name;
+  created_ = created;
+  control_.reset(control.steal(), page);
+  file_.reset(shm.release());
+}
+
+uint64_t SharedSegment::References() const {
+  return reinterpret_cast<const Control*>(control_.get())->references;
+}
+
+void SharedSegment::Detach() {
+  if (file_.get() == -1) return;
+  data_.reset();
+  {
+    LockOrThrow(file_.get());
+    Unlocker unlock(file_.get());
+    if (!--reinterpret_cast<Control*>(control_.get())->references && !Unlinked(file_.get())) {
+      UTIL_THROW_IF(shm_unlink(name_.c_str()), ErrnoException, "Could not unlink shared memory segment " << name_);
+    }
+  }
+  control_.reset();
+  file_.reset();
+}
+
+#endif
+
+} // namespace util
@@ -0,0 +1,72 @@
+#ifndef UTIL_SHARED_SEGMENT_H
+#define UTIL_SHARED_SEGMENT_H
+
+/* Share one in-memory copy of a file between processes using a named POSIX
+ * shared memory segment.  The first process to attach copies the file into
+ * the segment; later processes map the same pages read-only.  A control page
+ * at the beginning of the segment counts references under flock and the last
+ * process to detach unlinks the name.  The data begins 2 MB into the segment
+ * and is advised MADV_HUGEPAGE, which shmem honors when transparent huge pages
+ * are enabled for it (shmem_enabled set to advise or always).
+ *
+ * A process that dies without detaching leaks its reference, so the segment
+ * outlives everybody until removed from /dev/shm by hand.
+ */
+
+#include "mmap.hh"
+#include "file.hh"
+#include "scoped.hh"
+
+#include <string>
+
+#include <stdint.h>
+
+namespace util {
+
+class SharedSegment {
+  public:
+    SharedSegment() : created_(false) {}
+
+    // Detach if attached.
+    ~SharedSegment();
+
+    /* Segment name for the contents of fd, derived from its device, inode,
+     * size, and modification time so that a rebuilt file gets a new segment.
+     * prefix should start with /.
+     */
+    static std::string NameFor(int fd, const char *prefix);
+
+    /* Attach to the segment called name, creating it by reading size bytes
+     * from the beginning of fd if it does not exist.  Throws if an existing
+     * segment has a different size.
+     */
+    void Attach(const std::string &name, int fd, uint64_t size);
+
+    const std::string &Name() const { return name_; }
+
+    // Read-only contents.
+    const char *begin() const { return data_.begin(); }
+    std::size_t size() const { return data_.size(); }
+
+    // Did Attach copy the file?
+    bool Created() const { return created_; }
+
+    // Processes currently attached, including this one.
+    uint64_t References() const;
+
+  private:
+    void Detach();
+
+    std::string name_;
+    scoped_fd file_;
+    scoped_mmap control_;
+    scoped_mmap data_;
+    bool created_;
+
+    SharedSegment(const SharedSegment &);
+    SharedSegment &operator=(const SharedSegment &);
+};
+
+} // namespace util
+
+#endif // UTIL_SHARED_SEGMENT_H
@@ -0,0 +1,46 @@
+#include "shared_segment.hh"
+
+#include "file.hh"
+
+#define BOOST_TEST_MODULE SharedSegmentTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstring>
+#include <string>
+
+namespace util {
+namespace {
+
+BOOST_AUTO_TEST_CASE(AttachTwice) {
+  const std::string kContents("Shared between processes.");
+  scoped_fd file(MakeTemp("shared_segment_test"));
+  WriteOrThrow(file.get(), kContents.data(), kContents.size());
+  const std::string name(SharedSegment::NameFor(file.get(), "/kenlm_shared_segment_test-"));
+  scoped_fd other(MakeTemp("shared_segment_test"));
+  BOOST_CHECK(name != SharedSegment::NameFor(other.get(), "/kenlm_shared_segment_test-"));
+
+  {
+    SharedSegment first, second;
+    first.Attach(name, file.get(), kContents.size());
+    BOOST_CHECK(first.Created());
+    BOOST_CHECK_EQUAL(1U, first.References());
+    second.Attach(name, file.get(), kContents.size());
+    BOOST_CHECK(!second.Created());
+    BOOST_CHECK_EQUAL(2U, second.References());
+    BOOST_REQUIRE_EQUAL(kContents.size(), second.size());
+    BOOST_CHECK(!memcmp(kContents.data(), second.begin(), kContents.size()));
+
+    SharedSegment wrong_size;
+    BOOST_CHECK_THROW(wrong_size.Attach(name, file.get(), kContents.size() - 1), util::Exception);
+    BOOST_CHECK_EQUAL(2U, first.References());
+  }
+
+  // The last detach removed the segment, so it is created again.
+  SharedSegment again;
+  again.Attach(name, file.get(), kContents.size());
+  BOOST_CHECK(again.Created());
+  BOOST_CHECK_EQUAL(1U, again.References());
+}
+
+} // namespace
+} // namespace util
@@ -1,8 +1,80 @@
 #include "spaces.hh"
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define UTIL_SPACES_SIMD
+#include <immintrin.h>
+#endif
+
 namespace util {
 
 // Sigh this is the only way I could come up with to do a _const_ bool.  It has ' ', '\f', '\n', '\r', '\t', and '\v' (same as isspace on C locale).
 const bool kSpaces[256] = {0,0,0,0,0,0,0,0,0,1,1,1,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
+const char *FindSpaceScalar(const char *begin, const char *end) {
+  for (; begin != end; ++begin) {
+    if (kSpaces[static_cast<unsigned char>(*begin)]) return begin;
+  }
+  return end;
+}
+
+#ifdef UTIL_SPACES_SIMD
+namespace {
+// kSpaces is '\t' through '\r' (9 to 13) and ' '.
+__m128i SpaceBytes(__m128i c) {
+  __m128i control = _mm_sub_epi8(c, _mm_set1_epi8(9));
+  control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8(4)), control);
+  return _mm_or_si128(control, _mm_cmpeq_epi8(c, _mm_set1_epi8(' ')));
+}
+
+const char *ScanSSE2(const char *begin, const char *end) {
+  for (; end - begin >= 16; begin += 16) {
+    int mask = _mm_movemask_epi8(SpaceBytes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin))));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return FindSpaceScalar(begin, end);
+}
+
+__attribute__((target("avx2"))) const char *ScanAVX2(const char *begin, const char *end) {
+  const __m256i nine = _mm256_set1_epi8(9), four = _mm256_set1_epi8(4), space = _mm256_set1_epi8(' ');
+  for (; end - begin >= 32; begin += 32) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i control = _mm256_sub_epi8(c, nine);
+    control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control);
+    unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(control, _mm256_cmpeq_epi8(c, space)));
+    if (mask) return begin + __builtin_ctz(mask);
+  }
+  return ScanSSE2(begin, end);
+}
+} // namespace
+#endif
+
+FindSpaceFunction FindSpaceSSE2() {
+#ifdef UTIL_SPACES_SIMD
+  return &ScanSSE2;
+#else
+  return NULL;
+#endif
+}
+
+FindSpaceFunction FindSpaceAVX2() {
+#ifdef UTIL_SPACES_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return &ScanAVX2;
+#endif
+  return NULL;
+}
+
+namespace {
+FindSpaceFunction BestFindSpace() {
+  FindSpaceFunction ret = FindSpaceAVX2();
+  if (!ret) ret = FindSpaceSSE2();
+  return ret ? ret : &FindSpaceScalar;
+}
+} // namespace
+
+const char *FindSpace(const char *begin, const char *end) {
+  static const FindSpaceFunction best = BestFindSpace();
+  return best(begin, end);
+}
+
 } // namespace util
@@ -7,6 +7,30 @@ namespace util {
 
 extern const bool kSpaces[256];
 
+/* Find the first byte in [begin, end) that is in kSpaces, or end.  FilePiece
+ * and TokenIter spend much of their time here, so there are SSE2 and AVX2
+ * versions, chosen at run time.
+ */
+typedef const char *(*FindSpaceFunction)(const char *begin, const char *end);
+
+const char *FindSpaceScalar(const char *begin, const char *end);
+
+// NULL unless compiled for x86-64 with GCC or clang and the CPU supports it.
+FindSpaceFunction FindSpaceSSE2();
+FindSpaceFunction FindSpaceAVX2();
+
+// The fastest of the above.
+const char *FindSpace(const char *begin, const char *end);
+
+// First byte in [begin, end) for which delim is true, or end.
+inline const char *FindDelimiter(const char *begin, const char *end, const bool *delim = kSpaces) {
+  if (delim == kSpaces) return FindSpace(begin, end);
+  for (; begin != end; ++begin) {
+    if (delim[static_cast<unsigned char>(*begin)]) return begin;
+  }
+  return end;
+}
+
 } // namespace util
 
 #endif // UTIL_SPACES_H
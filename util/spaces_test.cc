@@ -0,0 +1,66 @@
+#include "spaces.hh"
+
+#define BOOST_TEST_MODULE SpacesTest
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace util {
+namespace {
+
+void CheckAgrees(FindSpaceFunction find) {
+  // Every byte value at every position relative to the vector width, with
+  // lengths that exercise the tails.
+  std::string text(100, 'a');
+  for (unsigned int c = 0; c < 256; ++c) {
+    for (std::size_t at = 0; at < 70; ++at) {
+      for (std::size_t length = at; length < at + 35; ++length) {
+        text[at] = static_cast<char>(c);
+        const char *begin = text.data(), *end = text.data() + length;
+        BOOST_REQUIRE_EQUAL(FindSpaceScalar(begin, end) - begin, find(begin, end) - begin);
+        text[at] = 'a';
+      }
+    }
+  }
+  // Random text with spaces and high bytes.
+  std::srand(3);
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    text[i] = static_cast<char>(std::rand() % 50 ? std::rand() % 256 : ' ');
+  }
+  for (std::size_t begin = 0; begin < text.size(); ++begin) {
+    BOOST_REQUIRE_EQUAL(FindSpaceScalar(text.data() + begin, text.data() + text.size()), find(text.data() + begin, text.data() + text.size()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Scalar) {
+  const char text[] = "foo bar\tbaz";
+  BOOST_CHECK_EQUAL(text + 3, FindSpaceScalar(text, text + sizeof(text) - 1));
+  BOOST_CHECK_EQUAL(text + 7, FindSpaceScalar(text + 4, text + sizeof(text) - 1));
+  BOOST_CHECK_EQUAL(text + sizeof(text) - 1, FindSpaceScalar(text + 8, text + sizeof(text) - 1));
+}
+
+BOOST_AUTO_TEST_CASE(SSE2) {
+  if (FindSpaceSSE2()) CheckAgrees(FindSpaceSSE2());
+}
+
+BOOST_AUTO_TEST_CASE(AVX2) {
+  if (FindSpaceAVX2()) CheckAgrees(FindSpaceAVX2());
+}
+
+BOOST_AUTO_TEST_CASE(Best) {
+  CheckAgrees(&FindSpace);
+}
+
+BOOST_AUTO_TEST_CASE(OtherDelimiters) {
+  bool comma[256] = {false};
+  comma[static_cast<unsigned char>(',')] = true;
+  const char text[] = "a b,c";
+  BOOST_CHECK_EQUAL(text + 3, FindDelimiter(text, text + 5, comma));
+  BOOST_CHECK_EQUAL(text + 1, FindDelimiter(text, text + 5));
+  BOOST_CHECK_EQUAL(text + 3, FindDelimiter(text + 2, text + 3, kSpaces));
+}
+
+} // namespace
+} // namespace util
@@ -24,7 +24,9 @@ class SingleCharacter {
     explicit SingleCharacter(char delim) : delim_(delim) {}
 
     StringPiece Find(const StringPiece &in) const {
-      return StringPiece(std::find(in.data(), in.data() + in.size(), delim_), 1);
+      // memchr may not be passed NULL, which TokenIter uses for the end.
+      const void *found = in.empty() ? NULL : memchr(in.data(), delim_, in.size());
+      return StringPiece(found ? static_cast<const char*>(found) : in.data() + in.size(), 1);
     }
 
   private:
@@ -65,10 +67,8 @@ class BoolCharacter {
     explicit BoolCharacter(const bool *delimiter = kSpaces) { delimiter_ = delimiter; }
 
     StringPiece Find(const StringPiece &in) const {
-      for (const char *i = in.data(); i != in.data() + in.size(); ++i) {
-        if (delimiter_[static_cast<unsigned char>(*i)]) return StringPiece(i, 1);
-      }
-      return StringPiece(in.data() + in.size(), 0);
+      const char *i = FindDelimiter(in.data(), in.data() + in.size(), delimiter_);
+      return StringPiece(i, i == in.data() + in.size() ? 0 : 1);
     }
 
     template <unsigned Length> static void Build(const char (&characters)[Length], bool (&out)[256]) {
@@ -44,5 +44,31 @@ BOOST_AUTO_TEST_CASE(remove_empty_keep) {
   BOOST_CHECK(!it);
 }
 
+BOOST_AUTO_TEST_CASE(single_character_skip_empty) {
+  const char str[] = "a  b ";
+  TokenIter<SingleCharacter, true> it(str, ' ');
+  BOOST_REQUIRE(it);
+  BOOST_CHECK_EQUAL(StringPiece("a"), *it);
+  ++it;
+  BOOST_REQUIRE(it);
+  BOOST_CHECK_EQUAL(StringPiece("b"), *it);
+  ++it;
+  BOOST_CHECK(!it);
+}
+
+BOOST_AUTO_TEST_CASE(bool_character) {
+  const char str[] = "a\tbb  ccccccccccccccccccccccccccccccccccccccc\nd";
+  TokenIter<BoolCharacter, true> it(str, kSpaces);
+  BOOST_REQUIRE(it);
+  BOOST_CHECK_EQUAL(StringPiece("a"), *it);
+  BOOST_REQUIRE(++it);
+  BOOST_CHECK_EQUAL(StringPiece("bb"), *it);
+  BOOST_REQUIRE(++it);
+  BOOST_CHECK_EQUAL(StringPiece("ccccccccccccccccccccccccccccccccccccccc"), *it);
+  BOOST_REQUIRE(++it);
+  BOOST_CHECK_EQUAL(StringPiece("d"), *it);
+  BOOST_CHECK(!++it);
+}
+
 } // namespace
 } // namespace util
@@ -0,0 +1,369 @@
+#include "write_compressed.hh"
+
+#include "exception.hh"
+#include "file.hh"
+#include "read_compressed.hh"
+
+#ifdef WITH_THREADS
+#include "pcqueue.hh"
+#include "thread_pool.hh"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/utility/in_place_factory.hpp>
+#endif // WITH_THREADS
+
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTDLIB
+#include <zstd.h>
+#endif
+
+namespace util {
+
+class CompressBackend {
+  public:
+    virtual ~CompressBackend() {}
+
+    virtual void write(const void *data, std::size_t length) = 0;
+
+    virtual void Flush() = 0;
+};
+
+namespace {
+
+// Uncompressed bytes per block.  Big enough that splitting costs little
+// compression, small enough to spread over threads.
+const std::size_t kCompressBlock = 4 << 20;
+
+class Compressor {
+  public:
+    virtual ~Compressor() {}
+
+    // Replaces out with a complete gzip member or zstd frame.
+    virtual void Compress(const std::string &in, std::string &out) = 0;
+};
+
+#ifdef HAVE_ZLIB
+class GZipCompressor : public Compressor {
+  public:
+    GZipCompressor() {
+      memset(&stream_, 0, sizeof(stream_));
+      // 16 for a gzip header rather than zlib's.
+      UTIL_THROW_IF(Z_OK != deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + 15, 8, Z_DEFAULT_STRATEGY), GZException, "Failed to initialize zlib.");
+    }
+
+    ~GZipCompressor() {
+      deflateEnd(&stream_);
+    }
+
+    void Compress(const std::string &in, std::string &out) {
+      UTIL_THROW_IF(Z_OK != deflateReset(&stream_), GZException, "Failed to reset zlib.");
+      out.resize(deflateBound(&stream_, in.size()));
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+      stream_.avail_in = in.size();
+      stream_.next_out = reinterpret_cast<Bytef*>(&out[0]);
+      stream_.avail_out = out.size();
+      int result = deflate(&stream_, Z_FINISH);
+      UTIL_THROW_IF(result != Z_STREAM_END, GZException, "zlib encountered " << (stream_.msg ? stream_.msg : "an error ") << " code " << result);
+      out.resize(stream_.total_out);
+    }
+
+  private:
+    z_stream stream_;
+};
+#endif // HAVE_ZLIB
+
+#ifdef HAVE_ZSTDLIB
+class ZStdCompressor : public Compressor {
+  public:
+    ZStdCompressor() : context_(ZSTD_createCCtx()) {
+      if (!context_) throw std::bad_alloc();
+    }
+
+    ~ZStdCompressor() {
+      ZSTD_freeCCtx(context_);
+    }
+
+    void Compress(const std::string &in, std::string &out) {
+      // zstd's default level.
+      const int kLevel = 3;
+      out.resize(ZSTD_compressBound(in.size()));
+      std::size_t ret = ZSTD_compressCCtx(context_, &out[0], out.size(), in.data(), in.size(), kLevel);
+      UTIL_THROW_IF(ZSTD_isError(ret), ZStdException, "zstd says " << ZSTD_getErrorName(ret));
+      out.resize(ret);
+    }
+
+  private:
+    ZSTD_CCtx *context_;
+};
+#endif // HAVE_ZSTDLIB
+
+Compressor *MakeCompressor(WriteCompressed::Format format) {
+  switch (format) {
+#ifdef HAVE_ZLIB
+    case WriteCompressed::GZIP:
+      return new GZipCompressor();
+#endif
+#ifdef HAVE_ZSTDLIB
+    case WriteCompressed::ZSTD:
+      return new ZStdCompressor();
+#endif
+    default:
+      UTIL_THROW(CompressedException, "Compression format " << format << " was not compiled in.");
+  }
+}
+
+// Compress and write on the calling thread.
+class InlineBackend : public CompressBackend {
+  public:
+    InlineBackend(int fd, WriteCompressed::Format format) : fd_(fd), compressor_(MakeCompressor(format)) {
+      block_.reserve(kCompressBlock);
+    }
+
+    void write(const void *data_void, std::size_t length) {
+      const char *data = static_cast<const char*>(data_void);
+      while (length) {
+        std::size_t amount = std::min(length, kCompressBlock - block_.size());
+        block_.append(data, amount);
+        data += amount;
+        length -= amount;
+        if (block_.size() == kCompressBlock) Flush();
+      }
+    }
+
+    void Flush() {
+      if (block_.empty()) return;
+      compressor_->Compress(block_, compressed_);
+      block_.clear();
+      WriteOrThrow(fd_, compressed_.data(), compressed_.size());
+    }
+
+  private:
+    int fd_;
+    scoped_ptr<Compressor> compressor_;
+    std::string block_, compressed_;
+};
+
+#ifdef WITH_THREADS
+struct CompressBlock {
+  uint64_t sequence;
+  std::string input, output;
+  // The writer posts flushed when it has written this block.
+  bool flush;
+};
+
+// The first error from a background thread, reported to the writing thread.
+class CompressErrors {
+  public:
+    void Set(const char *message) {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (message_.empty()) message_ = message;
+    }
+
+    void Check() {
+      boost::mutex::scoped_lock lock(mutex_);
+      UTIL_THROW_IF(!message_.empty(), CompressedException, message_);
+    }
+
+  private:
+    boost::mutex mutex_;
+    std::string message_;
+};
+
+class CompressWorker {
+  public:
+    typedef CompressBlock *Request;
+
+    CompressWorker(WriteCompressed::Format format, PCQueue<CompressBlock*> &done, CompressErrors &errors)
+      : compressor_(MakeCompressor(format)), done_(done), errors_(errors) {}
+
+    void operator()(CompressBlock *block) {
+      try {
+        block->output.clear();
+        if (!block->input.empty()) compressor_->Compress(block->input, block->output);
+      } catch (const std::exception &e) {
+        errors_.Set(e.what());
+        block->output.clear();
+      }
+      done_.Produce(block);
+    }
+
+  private:
+    scoped_ptr<Compressor> compressor_;
+    PCQueue<CompressBlock*> &done_;
+    CompressErrors &errors_;
+};
+
+// Write compressed blocks in sequence order, then recycle them.
+class CompressOutput {
+  public:
+    typedef CompressBlock *Request;
+
+    CompressOutput(int fd, PCQueue<CompressBlock*> &recycle, Semaphore &flushed, CompressErrors &errors)
+      : fd_(fd), recycle_(recycle), flushed_(flushed), errors_(errors), base_sequence_(0) {}
+
+    void operator()(CompressBlock *block) {
+      std::size_t index = block->sequence - base_sequence_;
+      if (index >= ordering_.size()) ordering_.resize(index + 1, NULL);
+      ordering_[index] = block;
+      while (!ordering_.empty() && ordering_.front()) {
+        CompressBlock *front = ordering_.front();
+        try {
+          WriteOrThrow(fd_, front->output.data(), front->output.size());
+        } catch (const std::exception &e) {
+          errors_.Set(e.what());
+        }
+        bool flush = front->flush;
+        recycle_.Produce(front);
+        if (flush) flushed_.post();
+        ordering_.pop_front();
+        ++base_sequence_;
+      }
+    }
+
+  private:
+    int fd_;
+    PCQueue<CompressBlock*> &recycle_;
+    Semaphore &flushed_;
+    CompressErrors &errors_;
+    std::deque<CompressBlock*> ordering_;
+    uint64_t base_sequence_;
+};
+
+// Compress on worker threads while an output thread writes blocks in order.
+class ThreadedBackend : public CompressBackend {
+  public:
+    ThreadedBackend(int fd, WriteCompressed::Format format, std::size_t threads)
+      : blocks_(2 * threads + 2),
+        recycle_(blocks_.size()),
+        flushed_(0),
+        output_(blocks_.size(), 1, boost::in_place(fd, boost::ref(recycle_), boost::ref(flushed_), boost::ref(errors_)), NULL),
+        workers_(blocks_.size(), threads, boost::in_place(format, boost::ref(output_.In()), boost::ref(errors_)), NULL),
+        current_(NULL),
+        sequence_(0) {
+      for (std::size_t i = 0; i < blocks_.size(); ++i) {
+        recycle_.Produce(&blocks_[i]);
+      }
+    }
+
+    void write(const void *data_void, std::size_t length) {
+      const char *data = static_cast<const char*>(data_void);
+      while (length) {
+        if (!current_) {
+          current_ = recycle_.Consume();
+          current_->input.clear();
+        }
+        std::size_t amount = std::min(length, kCompressBlock - current_->input.size());
+        current_->input.append(data, amount);
+        data += amount;
+        length -= amount;
+        if (current_->input.size() == kCompressBlock) Submit(false);
+      }
+      errors_.Check();
+    }
+
+    void Flush() {
+      if (!current_) {
+        current_ = recycle_.Consume();
+        current_->input.clear();
+      }
+      Submit(true);
+      WaitSemaphore(flushed_);
+      errors_.Check();
+    }
+
+  private:
+    void Submit(bool flush) {
+      current_->sequence = sequence_++;
+      current_->flush = flush;
+      workers_.Produce(current_);
+      current_ = NULL;
+    }
+
+    std::vector<CompressBlock> blocks_;
+    PCQueue<CompressBlock*> recycle_;
+    Semaphore flushed_;
+    CompressErrors errors_;
+
+    ThreadPool<CompressOutput> output_;
+    // Destroyed first, so workers finish before the output thread does.
+    ThreadPool<CompressWorker> workers_;
+
+    CompressBlock *current_;
+    uint64_t sequence_;
+};
+#endif // WITH_THREADS
+
+} // namespace
+
+WriteCompressed::Format WriteCompressed::ParseFormat(const StringPiece &name) {
+  if (name == "none") return NONE;
+  if (name == "gzip") {
+#ifdef HAVE_ZLIB
+    return GZIP;
+#else
+    UTIL_THROW(CompressedException, "gzip support was not compiled in.");
+#endif
+  }
+  if (name == "zstd") {
+#ifdef HAVE_ZSTDLIB
+    return ZSTD;
+#else
+    UTIL_THROW(CompressedException, "zstd support was not compiled in.");
+#endif
+  }
+  UTIL_THROW(CompressedException, "Unknown compression format " << name << ".  Try none, gzip, or zstd.");
+}
+
+WriteCompressed::Format WriteCompressed::FormatFromName(const StringPiece &file) {
+  if (file.ends_with(".gz")) return GZIP;
+  if (file.ends_with(".zst")) return ZSTD;
+  return NONE;
+}
+
+WriteCompressed::WriteCompressed(int fd, Format format, std::size_t threads) : file_(fd) {
+  if (format == NONE) return;
+#ifdef WITH_THREADS
+  if (threads > 1) {
+    backend_.reset(new ThreadedBackend(file_.get(), format, threads));
+    return;
+  }
+#endif // WITH_THREADS
+  backend_.reset(new InlineBackend(file_.get(), format));
+}
+
+WriteCompressed::~WriteCompressed() {
+  try {
+    Flush();
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    abort();
+  }
+  // Join threads before closing the file.
+  backend_.reset();
+}
+
+void WriteCompressed::write(const void *data, std::size_t length) {
+  if (backend_.get()) {
+    backend_->write(data, length);
+  } else {
+    WriteOrThrow(file_.get(), data, length);
+  }
+}
+
+void WriteCompressed::Flush() {
+  if (backend_.get()) backend_->Flush();
+}
+
+} // namespace util
@@ -0,0 +1,54 @@
+#ifndef UTIL_WRITE_COMPRESSED_H
+#define UTIL_WRITE_COMPRESSED_H
+
+#include "file.hh"
+#include "scoped.hh"
+#include "string_piece.hh"
+
+#include <cstddef>
+
+namespace util {
+
+class CompressBackend;
+
+/* Write a file, optionally compressed.  Data is cut into blocks that are
+ * compressed independently, as gzip members or zstd frames, so several threads
+ * can compress at once and the file is the same for any number of threads.
+ * ReadCompressed reads the result, decoding zstd frames in parallel if asked.
+ * Not thread safe: one thread writes at a time.
+ */
+class WriteCompressed {
+  public:
+    enum Format { NONE, GZIP, ZSTD };
+
+    // "none", "gzip", or "zstd".  Throws if the name is unknown or support was
+    // not compiled in.
+    static Format ParseFormat(const StringPiece &name);
+
+    // By file extension: .gz is GZIP, .zst is ZSTD, and anything else is NONE.
+    static Format FormatFromName(const StringPiece &file);
+
+    // Takes ownership of fd.  threads compress blocks in the background; with
+    // one thread, or without WITH_THREADS, blocks are compressed by write and
+    // Flush.
+    WriteCompressed(int fd, Format format, std::size_t threads = 1);
+
+    // Flushes, aborting on failure.  Call Flush first to get exceptions.
+    ~WriteCompressed();
+
+    void write(const void *data, std::size_t length);
+
+    // Compress and write everything so far.  Writing may continue afterwards,
+    // starting a new block.
+    void Flush();
+
+  private:
+    scoped_fd file_;
+
+    // NULL for uncompressed.
+    scoped_ptr<CompressBackend> backend_;
+};
+
+} // namespace util
+
+#endif // UTIL_WRITE_COMPRESSED_H
@@ -0,0 +1,98 @@
+#include "write_compressed.hh"
+
+#include "file.hh"
+#include "file_stream.hh"
+#include "integer_to_string.hh"
+#include "read_compressed.hh"
+
+#define BOOST_TEST_MODULE WriteCompressedTest
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+namespace util {
+namespace {
+
+// Several blocks worth of text.
+std::string MakeText() {
+  std::string ret;
+  for (uint64_t i = 0; ret.size() < 10 << 20; ++i) {
+    char buf[ToStringBuf<uint64_t>::kBytes];
+    ret.append(buf, ToString(static_cast<uint64_t>(i * 2654435761ULL % 1000003), buf));
+    ret += (i % 17) ? ' ' : '\n';
+  }
+  return ret;
+}
+
+const std::string &Text() {
+  static const std::string text(MakeText());
+  return text;
+}
+
+// Write Text() in uneven pieces with a flush halfway and return the file.
+std::string Write(WriteCompressed::Format format, std::size_t threads) {
+  scoped_fd file(MakeTemp("write_compressed_test_temp"));
+  {
+    WriteCompressed out(DupOrThrow(file.get()), format, threads);
+    FileStream stream(out, 100);
+    const std::string &text = Text();
+    std::size_t half = text.size() / 2;
+    for (std::size_t i = 0; i < half; i += 9999) {
+      stream << StringPiece(text.data() + i, std::min<std::size_t>(9999, half - i));
+    }
+    stream.flush();
+    out.Flush();
+    stream.write(text.data() + half, text.size() - half);
+  }
+  std::string ret(SizeOrThrow(file.get()), 0);
+  ErsatzPRead(file.get(), &ret[0], ret.size(), 0);
+  return ret;
+}
+
+void CheckRead(const std::string &written, std::size_t threads) {
+  scoped_fd file(MakeTemp("write_compressed_test_temp"));
+  WriteOrThrow(file.get(), written.data(), written.size());
+  SeekOrThrow(file.get(), 0);
+  ReadCompressed reader(file.release(), threads);
+  std::string got(Text().size() + 1, 0);
+  BOOST_REQUIRE_EQUAL(Text().size(), reader.ReadOrEOF(&got[0], got.size()));
+  got.resize(Text().size());
+  BOOST_CHECK(got == Text());
+}
+
+void RoundTrip(WriteCompressed::Format format) {
+  std::string sequential(Write(format, 1));
+  BOOST_CHECK(sequential.size() < Text().size());
+  CheckRead(sequential, 1);
+  CheckRead(sequential, 3);
+  // Blocks do not depend on the number of threads.
+  BOOST_CHECK(sequential == Write(format, 3));
+}
+
+BOOST_AUTO_TEST_CASE(None) {
+  BOOST_CHECK(Write(WriteCompressed::NONE, 1) == Text());
+}
+
+#ifdef HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(GZip) {
+  RoundTrip(WriteCompressed::GZIP);
+}
+#endif
+
+#ifdef HAVE_ZSTDLIB
+BOOST_AUTO_TEST_CASE(ZStd) {
+  RoundTrip(WriteCompressed::ZSTD);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(Names) {
+  BOOST_CHECK_EQUAL(WriteCompressed::NONE, WriteCompressed::ParseFormat("none"));
+  BOOST_CHECK_THROW(WriteCompressed::ParseFormat("lzw"), CompressedException);
+  BOOST_CHECK_EQUAL(WriteCompressed::GZIP, WriteCompressed::FormatFromName("lm.arpa.gz"));
+  BOOST_CHECK_EQUAL(WriteCompressed::ZSTD, WriteCompressed::FormatFromName("lm.arpa.zst"));
+  BOOST_CHECK_EQUAL(WriteCompressed::NONE, WriteCompressed::FormatFromName("lm.arpa"));
+  BOOST_CHECK_EQUAL(WriteCompressed::NONE, WriteCompressed::FormatFromName(""));
+}
+
+} // namespace
+} // namespace util